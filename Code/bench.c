@@ -0,0 +1,272 @@
+/*
+Benchmark for the cluster labelling engines.
+
+Compile with exactly one of
+    -DBENCH_CLUSTERS            iterate() from clusters.h
+    -DBENCH_CLUSTERS_MODIFIED   iterate() from clusters_modified.h (default)
+    -DBENCH_MATRIX              matrix_generate() from matrix.h
+plus whatever engine flags (DJS_BY_SIZE, CLUSTER_BITPACK, ...) are to be
+measured; see the bench target in the Makefile.
+*/
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#if defined(BENCH_MATRIX)
+#include "matrix.h"
+#define  BENCH_ENGINE  "matrix"
+#elif defined(BENCH_CLUSTERS)
+#include "clusters.h"
+#define  BENCH_ENGINE  "clusters"
+#else
+#include "clusters_modified.h"
+#define  BENCH_ENGINE  "clusters_modified"
+#endif
+
+#define  BENCH_MAX_VALUES  16
+#define  DEFAULT_SITES     20000000.0
+#define  DEFAULT_DIAGONAL  0.5
+
+static const int     default_sizes[] = { 125, 250, 500, 1000, 2000 };
+static const double  default_probabilities[] = { 0.5927, 0.3 };
+
+int usage(const char *argv0)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
+    fprintf(stderr, "       %s [ OPTIONS ] [ > output.txt ]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "       L=SIZE       Benchmark SIZE x SIZE matrices. Can be repeated.\n");
+    fprintf(stderr, "                    Default is 125, 250, 500, 1000, and 2000.\n");
+    fprintf(stderr, "       black=P      Benchmark at probability P of a cell to be black.\n");
+    fprintf(stderr, "                    Can be repeated. Default is %g (near the percolation\n", default_probabilities[0]);
+    fprintf(stderr, "                    threshold) and %g (away from it).\n", default_probabilities[1]);
+    fprintf(stderr, "       diag=P       Benchmark at probability P of diagonal connections.\n");
+    fprintf(stderr, "                    Can be repeated. Default is 0 (off) and %g (on).\n", DEFAULT_DIAGONAL);
+    fprintf(stderr, "       sites=COUNT  Generate at least COUNT cells per measurement.\n");
+    fprintf(stderr, "                    Default is %.0f.\n", DEFAULT_SITES);
+    fprintf(stderr, "       seed=U64     Set the Xorshift64* pseudorandom number generator seed; nonzero.\n");
+    fprintf(stderr, "                    Default is to pick one randomly (based on time).\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "This binary measures the %s engine. One untimed matrix is generated\n", BENCH_ENGINE);
+    fprintf(stderr, "before each measurement. The output has one line per measurement,\n");
+    fprintf(stderr, "   ENGINE L BLACK DIAG MATRICES SITES SECONDS NS_PER_SITE SITES_PER_SECOND PEAK_RSS_KB\n");
+    fprintf(stderr, "where PEAK_RSS_KB is the peak resident set size of the process so far.\n");
+    fprintf(stderr, "Sizes the engine cannot handle are reported on comment lines.\n");
+    fprintf(stderr, "\n");
+    return EXIT_SUCCESS;
+}
+
+/* Engine adapter: bench_setup() returns NULL or an error message. */
+#if defined(BENCH_MATRIX)
+
+static matrix  engine;
+
+static const char *bench_setup(const int size, const double p_black, const double diagonal, const uint64_t seed)
+{
+    const int  result = matrix_init(&engine, (size_t)size, STATS_ALL);
+
+    if (result)
+        return matrix_strerror(result);
+
+    engine.rng.state = seed;
+    engine.nonzero = p_black;
+    engine.diagonal = diagonal;
+    engine.diagonal_nonzero = 0.5;
+    return NULL;
+}
+
+static void bench_step(void)
+{
+    matrix_generate(&engine);
+}
+
+static void bench_release(void)
+{
+    matrix_free(&engine);
+}
+
+#else
+
+static cluster  engine = CLUSTER_INITIALIZER;
+
+static const char *bench_setup(const int size, const double p_black, const double diagonal, const uint64_t seed)
+{
+#if defined(BENCH_CLUSTERS)
+    const int  result = init_cluster(&engine, size, size, p_black, diagonal, 0.5);
+#else
+    const int  result = init_cluster(&engine, size, size, p_black, diagonal, diagonal);
+#endif
+
+    switch (result) {
+    case 0: break; /* OK */
+    case ERR_INVALID:  return "Invalid size";
+    case ERR_TOOLARGE: return "Size is too large";
+    case ERR_NOMEM:    return "Not enough memory";
+    default:           return "Unknown error";
+    }
+
+    engine.rng.state = seed;
+    return NULL;
+}
+
+static void bench_step(void)
+{
+    iterate(&engine);
+}
+
+static void bench_release(void)
+{
+    free_cluster(&engine);
+}
+
+#endif
+
+static double  wall_seconds(void)
+{
+    struct timespec  now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0;
+}
+
+static long  peak_rss_kb(void)
+{
+    struct rusage  usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return -1L;
+    return (long)usage.ru_maxrss;
+}
+
+/* Add a value to a list given on the command line. */
+static int  add_value(double *const list, int *const count, const double value)
+{
+    if (*count >= BENCH_MAX_VALUES)
+        return -1;
+    list[(*count)++] = value;
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    double   size[BENCH_MAX_VALUES], p_black[BENCH_MAX_VALUES], diagonal[BENCH_MAX_VALUES];
+    int      sizes = 0, p_blacks = 0, diagonals = 0;
+    double   sites = DEFAULT_SITES;
+    uint64_t seed = 0;
+
+    int      arg, itemp;
+    uint64_t u64temp;
+    double   dtemp;
+    char     dummy;
+
+    int      i, j, k;
+
+    for (arg = 1; arg < argc; arg++)
+        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
+            return usage(argv[0]);
+        else
+        if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "l=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
+            if (itemp < 1 || add_value(size, &sizes, itemp)) {
+                fprintf(stderr, "%s: Invalid size, or too many sizes.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+        } else
+        if (sscanf(argv[arg], "black=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "b=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "p=%lf %c", &dtemp, &dummy) == 1) {
+            if (add_value(p_black, &p_blacks, dtemp)) {
+                fprintf(stderr, "%s: Too many probabilities.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+        } else
+        if (sscanf(argv[arg], "diag=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "d=%lf %c", &dtemp, &dummy) == 1) {
+            if (add_value(diagonal, &diagonals, dtemp)) {
+                fprintf(stderr, "%s: Too many probabilities.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+        } else
+        if (sscanf(argv[arg], "sites=%lf %c", &dtemp, &dummy) == 1) {
+            if (dtemp < 1.0) {
+                fprintf(stderr, "%s: Invalid number of sites.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            sites = dtemp;
+        } else
+        if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "s=%" SCNu64 " %c", &u64temp, &dummy) == 1) {
+            seed = u64temp;
+        } else {
+            fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
+            return EXIT_FAILURE;
+        }
+
+    if (!sizes)
+        for (i = 0; i < (int)(sizeof default_sizes / sizeof default_sizes[0]); i++)
+            add_value(size, &sizes, default_sizes[i]);
+    if (!p_blacks)
+        for (i = 0; i < (int)(sizeof default_probabilities / sizeof default_probabilities[0]); i++)
+            add_value(p_black, &p_blacks, default_probabilities[i]);
+    if (!diagonals) {
+        add_value(diagonal, &diagonals, 0.0);
+        add_value(diagonal, &diagonals, DEFAULT_DIAGONAL);
+    }
+
+    if (!seed) {
+        seed = (uint64_t)time(NULL) * UINT64_C(3069887672279) ^ (uint64_t)clock() * UINT64_C(60498839);
+        if (!seed)
+            seed = 1;
+    }
+
+    printf("# seed: %" PRIu64 " (Xorshift 64*)\n", seed);
+    printf("# engine L black diag matrices sites seconds ns_per_site sites_per_second peak_rss_kb\n");
+    fflush(stdout);
+
+    for (i = 0; i < sizes; i++)
+        for (j = 0; j < p_blacks; j++)
+            for (k = 0; k < diagonals; k++) {
+                const int      L = (int)size[i];
+                const double   cells = (double)L * (double)L;
+                const char    *error = bench_setup(L, p_black[j], diagonal[k], seed);
+                unsigned long  matrices = 0;
+                double         started, seconds;
+
+                if (error) {
+                    printf("# %s L=%d: %s\n", BENCH_ENGINE, L, error);
+                    fflush(stdout);
+                    bench_release();
+                    continue;
+                }
+
+                /* Warm up the caches and the allocations. */
+                bench_step();
+
+                started = wall_seconds();
+                do {
+                    bench_step();
+                    matrices++;
+                } while ((double)matrices * cells < sites);
+                seconds = wall_seconds() - started;
+
+                printf("%s %d %.6f %.6f %lu %.0f %.6f %.3f %.0f %ld\n",
+                       BENCH_ENGINE, L, p_black[j], diagonal[k], matrices,
+                       (double)matrices * cells, seconds,
+                       1000000000.0 * seconds / ((double)matrices * cells),
+                       ((double)matrices * cells) / seconds,
+                       peak_rss_kb());
+#if defined(CLUSTER_PROFILE) && !defined(BENCH_MATRIX) && !defined(BENCH_CLUSTERS)
+                print_cluster_profile(stdout, &engine);
+#endif
+                fflush(stdout);
+
+                bench_release();
+            }
+
+    return EXIT_SUCCESS;
+}
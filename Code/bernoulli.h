@@ -0,0 +1,114 @@
+#ifndef   BERNOULLI_H
+#define   BERNOULLI_H
+/*
+Bulk Bernoulli bits from a Xorshift64* generator state.
+
+Shared by prng_fill_bernoulli() in prng.h and probability_fill() in
+clusters_modified.h. The two engines have their own generator types, and
+cannot be included in the same translation unit, so this works on the
+bare 64-bit state.
+*/
+#include <stddef.h>
+#include <inttypes.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/* Number of independent Xorshift64* lanes used by bernoulli_fill(). */
+#define  BERNOULLI_LANES  4
+
+/* Fill 'n' bits, packed 64 per word starting from the least significant bit,
+   with ones where a Xorshift64* value is at most 'limit'; unused bits in the
+   final word are cleared.  The generator state is advanced by a single step,
+   and BERNOULLI_LANES independent Xorshift64* streams are derived from it
+   using the SplitMix64 mixing function; bit i comes from lane
+   i % BERNOULLI_LANES. The results are thus fully determined by the
+   generator state, and are the same with and without AVX2. */
+static inline void  bernoulli_fill(uint64_t *const  rng_state,
+                                   const uint64_t   limit,
+                                   uint64_t *const  out,
+                                   const size_t     n)
+{
+    const size_t  words = (n + 63) / 64;
+    uint64_t      state = *rng_state;
+    uint64_t      lane[BERNOULLI_LANES];
+    size_t        w;
+    int           i, k;
+
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    *rng_state = state;
+
+    /* Note: Xorshift64* never yields a zero, because the state is nonzero
+             and the multiplier is odd, so the comparison alone suffices. */
+    if (!limit || limit == UINT64_C(18446744073709551615)) {
+        for (w = 0; w < words; w++)
+            out[w] = (limit) ? ~UINT64_C(0) : UINT64_C(0);
+    } else {
+        for (k = 0; k < BERNOULLI_LANES; k++) {
+            uint64_t  z = state + (uint64_t)(k + 1) * UINT64_C(11400714819323198485);
+            z = (z ^ (z >> 30)) * UINT64_C(13787848793156543929);
+            z = (z ^ (z >> 27)) * UINT64_C(10723151780598845931);
+            z =  z ^ (z >> 31);
+            lane[k] = (z) ? z : UINT64_C(1);
+        }
+
+        w = 0;
+
+#if defined(__AVX2__) && BERNOULLI_LANES == 4
+        {
+            const __m256i  mul_lo = _mm256_set1_epi64x((long long)(UINT64_C(2685821657736338717) & UINT64_C(4294967295)));
+            const __m256i  mul_hi = _mm256_set1_epi64x((long long)(UINT64_C(2685821657736338717) >> 32));
+            const __m256i  bias = _mm256_set1_epi64x((long long)(UINT64_C(1) << 63));
+            const __m256i  limit_biased = _mm256_set1_epi64x((long long)(limit ^ (UINT64_C(1) << 63)));
+            __m256i        s = _mm256_loadu_si256((const __m256i *)lane);
+
+            for (; w < words; w++) {
+                uint64_t  word = 0;
+
+                for (i = 0; i < 64; i += 4) {
+                    __m256i  value;
+
+                    s = _mm256_xor_si256(s, _mm256_srli_epi64(s, 12));
+                    s = _mm256_xor_si256(s, _mm256_slli_epi64(s, 25));
+                    s = _mm256_xor_si256(s, _mm256_srli_epi64(s, 27));
+
+                    /* 64-bit multiply from 32-bit halves. */
+                    value = _mm256_add_epi64(_mm256_mul_epu32(s, mul_lo),
+                                             _mm256_slli_epi64(_mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(s, 32), mul_lo),
+                                                                                _mm256_mul_epu32(s, mul_hi)), 32));
+
+                    /* Unsigned value > limit, as a signed comparison. */
+                    value = _mm256_cmpgt_epi64(_mm256_xor_si256(value, bias), limit_biased);
+
+                    word |= (uint64_t)(~_mm256_movemask_pd(_mm256_castsi256_pd(value)) & 15) << i;
+                }
+
+                out[w] = word;
+            }
+        }
+#endif
+
+        for (; w < words; w++) {
+            uint64_t  word = 0;
+
+            for (i = 0; i < 64; i += BERNOULLI_LANES)
+                for (k = 0; k < BERNOULLI_LANES; k++) {
+                    uint64_t  s = lane[k];
+                    s ^= s >> 12;
+                    s ^= s << 25;
+                    s ^= s >> 27;
+                    lane[k] = s;
+                    word |= (uint64_t)(s * UINT64_C(2685821657736338717) <= limit) << (i + k);
+                }
+
+            out[w] = word;
+        }
+    }
+
+    if (n & 63)
+        out[words - 1] &= (UINT64_C(1) << (n & 63)) - 1;
+}
+
+#endif /* BERNOULLI_H */
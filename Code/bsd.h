@@ -0,0 +1,363 @@
+#ifndef   BSD_H
+#define   BSD_H
+/*
+Binary cluster size distributions.
+
+A file contains any number of records, one per distribution, each appended
+as a whole. A record is a fixed header of 8-byte little-endian fields,
+
+    "PERCBSD1"
+    seed rows cols threads
+    p_black p_diag p_diag_black         as IEEE-754 double bit patterns
+    limit_black limit_diag limit_diag_black
+    iterations entries bytes
+
+followed by 'bytes' bytes of payload, padded with zeros to a multiple of
+eight bytes, so every header is aligned when the file is memory-mapped.
+The payload has 'entries' (size, white, black) triples for the sizes with
+any clusters, in increasing size order. Each value is an unsigned LEB128
+varint (seven bits per byte, least significant group first, high bit set on
+all but the last byte); size is the difference to the previous size in the
+record, the first one to zero.
+
+Readers map the whole file with bsd_open(), and walk the records with
+bsd_record_at() and the triples of each record with bsd_entry().
+*/
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifndef  STATIC_INLINE
+#define  STATIC_INLINE  static inline
+#endif
+
+#define  BSD_MAGIC        "PERCBSD1"
+#define  BSD_FIELDS       13
+#define  BSD_HEADER_SIZE  (8 + 8 * BSD_FIELDS)
+
+/* Error codes; positive values are errno codes from file operations. */
+#define  BSD_ERR_INVALID  -1   /* Invalid function parameter */
+#define  BSD_ERR_NOMEM    -3   /* Out of memory */
+#define  BSD_ERR_FORMAT   -4   /* Not a distribution file, or corrupted */
+
+typedef struct {
+    uint64_t  seed;
+    uint64_t  rows;
+    uint64_t  cols;
+    uint64_t  threads;
+    double    p_black;
+    double    p_diag;
+    double    p_diag_black;
+    uint64_t  limit_black;
+    uint64_t  limit_diag;
+    uint64_t  limit_diag_black;
+    uint64_t  iterations;
+    uint64_t  entries;
+    uint64_t  bytes;
+} bsd_header;
+
+/* A memory-mapped distribution file. */
+typedef struct {
+    const unsigned char  *data;
+    size_t                size;
+} bsd_file;
+#define  BSD_FILE_INITIALIZER  { NULL, 0 }
+
+/* One record in a mapped file, and the position of the next triple in it. */
+typedef struct {
+    bsd_header            header;
+    const unsigned char  *next;
+    const unsigned char  *end;
+    uint64_t              size;
+    uint64_t              left;
+} bsd_record;
+
+/* Describe an error code returned by the bsd_ functions. */
+STATIC_INLINE const char *bsd_strerror(const int retval)
+{
+    switch (retval) {
+    case 0:               return "OK";
+    case BSD_ERR_INVALID: return "Invalid parameters";
+    case BSD_ERR_NOMEM:   return "Not enough memory";
+    case BSD_ERR_FORMAT:  return "Not a distribution file, or it is corrupted";
+    default:
+        if (retval > 0)
+            return strerror(retval);
+        return "(Unknown error)";
+    }
+}
+
+STATIC_INLINE unsigned char *bsd_put_u64(unsigned char *ptr, uint64_t value)
+{
+    int  i;
+    for (i = 0; i < 8; i++) {
+        *(ptr++) = (unsigned char)value;
+        value >>= 8;
+    }
+    return ptr;
+}
+
+STATIC_INLINE uint64_t  bsd_get_u64(const unsigned char *const ptr)
+{
+    uint64_t  value = 0;
+    int       i;
+    for (i = 7; i >= 0; i--)
+        value = (value << 8) | ptr[i];
+    return value;
+}
+
+STATIC_INLINE uint64_t  bsd_double_bits(const double value)
+{
+    uint64_t  bits;
+    memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+STATIC_INLINE double  bsd_bits_double(const uint64_t bits)
+{
+    double  value;
+    memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+STATIC_INLINE unsigned char *bsd_put_varint(unsigned char *ptr, uint64_t value)
+{
+    while (value >= 128) {
+        *(ptr++) = (unsigned char)(value & 127) | 128;
+        value >>= 7;
+    }
+    *(ptr++) = (unsigned char)value;
+    return ptr;
+}
+
+/* Returns NULL if the varint is truncated or too long. */
+STATIC_INLINE const unsigned char *bsd_get_varint(const unsigned char *ptr, const unsigned char *const end,
+                                                  uint64_t *const value)
+{
+    uint64_t  result = 0;
+    int       shift = 0;
+
+    while (ptr < end && shift < 64) {
+        const unsigned char  byte = *(ptr++);
+        result |= (uint64_t)(byte & 127) << shift;
+        if (!(byte & 128)) {
+            *value = result;
+            return ptr;
+        }
+        shift += 7;
+    }
+
+    return NULL;
+}
+
+/* Append a record for histograms with sizes 1..n to 'out'.
+   The 'entries' and 'bytes' header fields are filled in here. */
+STATIC_INLINE int bsd_write(FILE *const out, bsd_header *const header,
+                            const uint64_t *const white, const uint64_t *const black,
+                            const size_t n)
+{
+    unsigned char  *buffer, *ptr;
+    uint64_t        prev = 0;
+    size_t          entries = 0, bytes, i;
+
+    if (!out || !header || !white || !black)
+        return BSD_ERR_INVALID;
+
+    for (i = 1; i <= n; i++)
+        entries += (white[i] || black[i]);
+
+    /* Each triple takes at most three ten-byte varints. */
+    buffer = malloc(BSD_HEADER_SIZE + 30 * entries + 8);
+    if (!buffer)
+        return BSD_ERR_NOMEM;
+
+    ptr = buffer + BSD_HEADER_SIZE;
+    for (i = 1; i <= n; i++)
+        if (white[i] || black[i]) {
+            ptr = bsd_put_varint(ptr, (uint64_t)i - prev);
+            ptr = bsd_put_varint(ptr, white[i]);
+            ptr = bsd_put_varint(ptr, black[i]);
+            prev = i;
+        }
+    bytes = (size_t)(ptr - buffer) - BSD_HEADER_SIZE;
+    while ((size_t)(ptr - buffer) & 7)
+        *(ptr++) = 0;
+
+    header->entries = entries;
+    header->bytes = bytes;
+
+    memcpy(buffer, BSD_MAGIC, 8);
+    {
+        unsigned char *h = buffer + 8;
+        h = bsd_put_u64(h, header->seed);
+        h = bsd_put_u64(h, header->rows);
+        h = bsd_put_u64(h, header->cols);
+        h = bsd_put_u64(h, header->threads);
+        h = bsd_put_u64(h, bsd_double_bits(header->p_black));
+        h = bsd_put_u64(h, bsd_double_bits(header->p_diag));
+        h = bsd_put_u64(h, bsd_double_bits(header->p_diag_black));
+        h = bsd_put_u64(h, header->limit_black);
+        h = bsd_put_u64(h, header->limit_diag);
+        h = bsd_put_u64(h, header->limit_diag_black);
+        h = bsd_put_u64(h, header->iterations);
+        h = bsd_put_u64(h, header->entries);
+        h = bsd_put_u64(h, header->bytes);
+    }
+
+    if (fwrite(buffer, (size_t)(ptr - buffer), 1, out) != 1) {
+        const int  result = (errno) ? errno : EIO;
+        free(buffer);
+        return result;
+    }
+
+    free(buffer);
+    return 0;
+}
+
+/* Unmap a distribution file. */
+STATIC_INLINE void bsd_close(bsd_file *const f)
+{
+    if (f) {
+        if (f->data && f->size)
+            munmap((void *)f->data, f->size);
+        f->data = NULL;
+        f->size = 0;
+    }
+}
+
+/* Map a distribution file into memory. */
+STATIC_INLINE int bsd_open(bsd_file *const f, const char *const path)
+{
+    struct stat  info;
+    void        *data;
+    int          fd, result;
+
+    if (!f || !path || !*path)
+        return BSD_ERR_INVALID;
+
+    f->data = NULL;
+    f->size = 0;
+
+    do {
+        fd = open(path, O_RDONLY);
+    } while (fd == -1 && errno == EINTR);
+    if (fd == -1)
+        return errno;
+
+    if (fstat(fd, &info) == -1) {
+        result = errno;
+        close(fd);
+        return result;
+    }
+
+    if ((off_t)(size_t)info.st_size != info.st_size) {
+        close(fd);
+        return BSD_ERR_NOMEM;
+    }
+
+    /* An empty file has no records. */
+    if (info.st_size < 1) {
+        close(fd);
+        return 0;
+    }
+
+    data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        result = errno;
+        close(fd);
+        return result;
+    }
+    close(fd);
+
+    f->data = data;
+    f->size = (size_t)info.st_size;
+    return 0;
+}
+
+/* Read the record at '*offset' in a mapped file, advancing the offset to the
+   next record. Returns 0 if successful, 1 at the end of the file. */
+STATIC_INLINE int bsd_record_at(const bsd_file *const f, size_t *const offset, bsd_record *const r)
+{
+    const unsigned char  *h;
+    uint64_t              field[BSD_FIELDS];
+    size_t                padded;
+    int                   i;
+
+    if (!f || !offset || !r)
+        return BSD_ERR_INVALID;
+
+    if (*offset >= f->size)
+        return 1;
+
+    if (f->size - *offset < BSD_HEADER_SIZE ||
+        memcmp(f->data + *offset, BSD_MAGIC, 8))
+        return BSD_ERR_FORMAT;
+
+    h = f->data + *offset + 8;
+    for (i = 0; i < BSD_FIELDS; i++)
+        field[i] = bsd_get_u64(h + 8*i);
+
+    r->header.seed = field[0];
+    r->header.rows = field[1];
+    r->header.cols = field[2];
+    r->header.threads = field[3];
+    r->header.p_black = bsd_bits_double(field[4]);
+    r->header.p_diag = bsd_bits_double(field[5]);
+    r->header.p_diag_black = bsd_bits_double(field[6]);
+    r->header.limit_black = field[7];
+    r->header.limit_diag = field[8];
+    r->header.limit_diag_black = field[9];
+    r->header.iterations = field[10];
+    r->header.entries = field[11];
+    r->header.bytes = field[12];
+
+    if (r->header.bytes > (uint64_t)(f->size - *offset - BSD_HEADER_SIZE))
+        return BSD_ERR_FORMAT;
+
+    r->next = f->data + *offset + BSD_HEADER_SIZE;
+    r->end = r->next + r->header.bytes;
+    r->size = 0;
+    r->left = r->header.entries;
+
+    padded = ((size_t)r->header.bytes + 7) & ~(size_t)7;
+    if (padded > f->size - *offset - BSD_HEADER_SIZE)
+        padded = f->size - *offset - BSD_HEADER_SIZE;
+    *offset += BSD_HEADER_SIZE + padded;
+
+    return 0;
+}
+
+/* Read the next triple of a record. Returns 0 if successful,
+   1 after the last triple. */
+STATIC_INLINE int bsd_entry(bsd_record *const r, uint64_t *const size,
+                            uint64_t *const white, uint64_t *const black)
+{
+    uint64_t             delta;
+    const unsigned char *ptr;
+
+    if (!r->left)
+        return 1;
+
+    ptr = bsd_get_varint(r->next, r->end, &delta);
+    if (ptr)
+        ptr = bsd_get_varint(ptr, r->end, white);
+    if (ptr)
+        ptr = bsd_get_varint(ptr, r->end, black);
+    if (!ptr || !delta)
+        return BSD_ERR_FORMAT;
+
+    r->next = ptr;
+    r->size += delta;
+    r->left--;
+    *size = r->size;
+    return 0;
+}
+
+#endif /* BSD_H */
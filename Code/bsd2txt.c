@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "bsd.h"
+
+int usage(const char *argv0)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
+    fprintf(stderr, "       %s [ record=K ] FILE... [ > output.txt ]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Converts binary cluster size distributions, written by distribution\n");
+    fprintf(stderr, "with binary=FILE, to the text layout distribution prints otherwise.\n");
+    fprintf(stderr, "All records in each FILE are converted, one after another, unless\n");
+    fprintf(stderr, "record=K is given; the first record in each file is 1.\n");
+    fprintf(stderr, "\n");
+    return EXIT_SUCCESS;
+}
+
+/* Print one size line. */
+static void  print_size(const uint64_t size, const uint64_t white, const uint64_t black)
+{
+    printf("%lu %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+           (unsigned long)size, white, black, white + black);
+}
+
+/* Print a record in the layout of distribution. */
+static int  print_record(bsd_record *const r)
+{
+    const uint64_t  n = r->header.rows * r->header.cols;
+    uint64_t        size, white, black;
+    uint64_t        last = 0;
+    int             result;
+
+    printf("# seed: %" PRIu64 " (Xorshift 64*)\n", r->header.seed);
+    printf("# size: %d rows, %d columns\n", (int)r->header.rows, (int)r->header.cols);
+    printf("# P(black): %.6f (%" PRIu64 "/18446744073709551615)\n", r->header.p_black, r->header.limit_black);
+    printf("# P(connecting diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", r->header.p_diag, r->header.limit_diag);
+    printf("# P(black connecting diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", r->header.p_diag_black, r->header.limit_diag_black);
+    if (r->header.threads > 1)
+        printf("# threads: %d (replica seeds split from seed)\n", (int)r->header.threads);
+    printf("# Iterations: %" PRIu64 "\n", r->header.iterations);
+    printf("#\n");
+    printf("# size  white_clusters(size) black_clusters(size) clusters(size)\n");
+
+    /* The text layout also has the zero lines next to nonzero ones. */
+    while (!(result = bsd_entry(r, &size, &white, &black))) {
+        if (size > n)
+            return BSD_ERR_FORMAT;
+        if (last > 0 && last + 1 < size)
+            print_size(++last, 0, 0);
+        if (size > 1 && size - 1 > last)
+            print_size(size - 1, 0, 0);
+        print_size(size, white, black);
+        last = size;
+    }
+    if (result < 0)
+        return result;
+
+    if (last > 0 && last < n)
+        print_size(last + 1, 0, 0);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long      record = 0;
+    int       files = 0;
+
+    int       arg, result;
+    long      ltemp;
+    char      dummy;
+
+    if (argc < 2)
+        return usage(argv[0]);
+
+    for (arg = 1; arg < argc; arg++)
+        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
+            return usage(argv[0]);
+        else
+        if (sscanf(argv[arg], "record=%ld %c", &ltemp, &dummy) == 1) {
+            if (ltemp < 1) {
+                fprintf(stderr, "%s: Invalid record number.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            record = ltemp;
+        } else {
+            bsd_file    f = BSD_FILE_INITIALIZER;
+            bsd_record  r;
+            size_t      offset = 0;
+            long        k = 0;
+
+            files++;
+
+            result = bsd_open(&f, argv[arg]);
+            if (result) {
+                fprintf(stderr, "%s: %s.\n", argv[arg], bsd_strerror(result));
+                return EXIT_FAILURE;
+            }
+
+            while (!(result = bsd_record_at(&f, &offset, &r)))
+                if (!record || ++k == record) {
+                    result = print_record(&r);
+                    if (result)
+                        break;
+                }
+
+            bsd_close(&f);
+
+            if (result < 0) {
+                fprintf(stderr, "%s: %s.\n", argv[arg], bsd_strerror(result));
+                return EXIT_FAILURE;
+            }
+        }
+
+    if (!files) {
+        fprintf(stderr, "No files specified.\n");
+        return EXIT_FAILURE;
+    }
+
+    /* All done. */
+    return EXIT_SUCCESS;
+}
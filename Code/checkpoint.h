@@ -0,0 +1,482 @@
+#ifndef   CHECKPOINT_H
+#define   CHECKPOINT_H
+/*
+Checkpoints of histogram accumulation runs.
+
+A checkpoint holds everything needed to continue a run bit-exactly: the
+matrix size, the probability limits, the generator state and the number of
+iterations done by each generator stream, and the accumulated histograms
+and spanning counts. It does not depend on the cluster engine; the caller
+copies the fields in and out.
+
+The file is a sequence of unsigned LEB128 varints (seven bits per byte, least
+significant group first, high bit set on all but the last byte), after an
+eight-byte magic:
+
+    "PERCKPT1"
+    rows cols
+    params param[0] .. param[params-1]
+    seed iterations white_spans black_spans
+    streams state[0] iterations[0] .. state[streams-1] iterations[streams-1]
+    nonzero (index-delta count) * nonzero      white histogram
+    nonzero (index-delta count) * nonzero      black histogram
+
+followed by the 64-bit FNV-1a hash of all preceding bytes, as eight bytes,
+least significant first. The histograms are sparse: only nonzero entries are
+stored, each as the difference to the previous stored index (the first one
+to zero) and the count.
+
+Checkpoints are written to a temporary file next to the target, which is
+flushed to disk and then renamed over the target, so an interrupted write
+never leaves a partial checkpoint behind.
+
+A checkpoint with zero streams (for example, a merge of independent runs)
+contains statistics only, and cannot be continued.
+*/
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#ifndef  STATIC_INLINE
+#define  STATIC_INLINE  static inline
+#endif
+
+#define  CHECKPOINT_MAGIC      "PERCKPT1"
+#define  CHECKPOINT_PARAMS     3
+
+/* Error codes; positive values are errno codes from file operations. */
+#define  CHECKPOINT_ERR_INVALID   -1   /* Invalid function parameter */
+#define  CHECKPOINT_ERR_TOOLARGE  -2   /* Matrix size is too large */
+#define  CHECKPOINT_ERR_NOMEM     -3   /* Out of memory */
+#define  CHECKPOINT_ERR_FORMAT    -4   /* Not a checkpoint, or corrupted */
+#define  CHECKPOINT_ERR_MISMATCH  -5   /* Different size or probabilities */
+
+typedef struct {
+    /* Size of the matrix */
+    uint64_t   rows;
+    uint64_t   cols;
+
+    /* Probability limits, as stored in the cluster structure */
+    uint64_t   param[CHECKPOINT_PARAMS];
+
+    /* Base seed, for reference */
+    uint64_t   seed;
+
+    /* Number of matrices the statistics have been collected from */
+    uint64_t   iterations;
+
+    /* Number of times when at least one cluster spanned the matrix */
+    uint64_t   white_spans;
+    uint64_t   black_spans;
+
+    /* Generator state and iterations done, per stream */
+    size_t     streams;
+    uint64_t  *state;
+    uint64_t  *done;
+
+    /* Histograms of white and black clusters, rows*cols+2 entries */
+    size_t     size;
+    uint64_t  *white_histogram;
+    uint64_t  *black_histogram;
+} checkpoint;
+#define  CHECKPOINT_INITIALIZER  { 0, 0, {0}, 0, 0, 0, 0, 0, NULL, NULL, 0, NULL, NULL }
+
+/* Describe an error code returned by the checkpoint functions. */
+STATIC_INLINE const char *checkpoint_strerror(const int retval)
+{
+    switch (retval) {
+    case 0:                       return "OK";
+    case CHECKPOINT_ERR_INVALID:  return "Invalid parameters";
+    case CHECKPOINT_ERR_TOOLARGE: return "Matrix size is too large";
+    case CHECKPOINT_ERR_NOMEM:    return "Not enough memory";
+    case CHECKPOINT_ERR_FORMAT:   return "Not a checkpoint file, or it is corrupted";
+    case CHECKPOINT_ERR_MISMATCH: return "Checkpoints have different sizes or probabilities";
+    default:
+        if (retval > 0)
+            return strerror(retval);
+        return "(Unknown error)";
+    }
+}
+
+/* Free all resources related to a checkpoint. */
+STATIC_INLINE void free_checkpoint(checkpoint *cp)
+{
+    if (cp) {
+        free(cp->state);
+        free(cp->done);
+        free(cp->white_histogram);
+        free(cp->black_histogram);
+        memset(cp, 0, sizeof *cp);
+    }
+}
+
+/* Initialize an empty checkpoint for a matrix of the specified size,
+   with 'streams' generator streams. */
+static int init_checkpoint(checkpoint *cp, const uint64_t rows, const uint64_t cols,
+                           const size_t streams)
+{
+    size_t  size;
+
+    if (!cp)
+        return CHECKPOINT_ERR_INVALID;
+
+    memset(cp, 0, sizeof *cp);
+
+    if (rows < 1 || cols < 1)
+        return CHECKPOINT_ERR_INVALID;
+
+    size = (size_t)rows * (size_t)cols + 2;
+    if ((uint64_t)(size_t)rows != rows || (uint64_t)(size_t)cols != cols ||
+        (size - 2) / (size_t)rows != (size_t)cols || size < 2 ||
+        size > (~(size_t)0) / sizeof (uint64_t) ||
+        streams > (~(size_t)0) / sizeof (uint64_t))
+        return CHECKPOINT_ERR_TOOLARGE;
+
+    cp->white_histogram = calloc(size, sizeof (uint64_t));
+    cp->black_histogram = calloc(size, sizeof (uint64_t));
+    if (streams > 0) {
+        cp->state = calloc(streams, sizeof (uint64_t));
+        cp->done = calloc(streams, sizeof (uint64_t));
+    }
+    if (!cp->white_histogram || !cp->black_histogram ||
+        (streams > 0 && (!cp->state || !cp->done))) {
+        free_checkpoint(cp);
+        return CHECKPOINT_ERR_NOMEM;
+    }
+
+    cp->rows = rows;
+    cp->cols = cols;
+    cp->streams = streams;
+    cp->size = size;
+
+    return 0;
+}
+
+/* Buffered checkpoint file, with a running FNV-1a hash. */
+typedef struct {
+    FILE      *stream;
+    uint64_t   hash;
+} checkpoint_file;
+
+STATIC_INLINE void  checkpoint_put(checkpoint_file *const f, const unsigned char byte)
+{
+    f->hash = (f->hash ^ byte) * UINT64_C(1099511628211);
+    putc(byte, f->stream);
+}
+
+STATIC_INLINE void  checkpoint_put_varint(checkpoint_file *const f, uint64_t value)
+{
+    while (value >= 128) {
+        checkpoint_put(f, (unsigned char)(value & 127) | 128);
+        value >>= 7;
+    }
+    checkpoint_put(f, (unsigned char)value);
+}
+
+/* Returns 0 if successful, CHECKPOINT_ERR_FORMAT at end of file. */
+STATIC_INLINE int  checkpoint_get(checkpoint_file *const f, unsigned char *const byte)
+{
+    const int  c = getc(f->stream);
+    if (c == EOF)
+        return CHECKPOINT_ERR_FORMAT;
+    f->hash = (f->hash ^ (unsigned char)c) * UINT64_C(1099511628211);
+    *byte = (unsigned char)c;
+    return 0;
+}
+
+STATIC_INLINE int  checkpoint_get_varint(checkpoint_file *const f, uint64_t *const value)
+{
+    uint64_t       result = 0;
+    int            shift = 0;
+    unsigned char  byte;
+
+    do {
+        if (shift > 63 || checkpoint_get(f, &byte))
+            return CHECKPOINT_ERR_FORMAT;
+        if (shift == 63 && (byte & 126))
+            return CHECKPOINT_ERR_FORMAT;
+        result |= (uint64_t)(byte & 127) << shift;
+        shift += 7;
+    } while (byte & 128);
+
+    *value = result;
+    return 0;
+}
+
+STATIC_INLINE void  checkpoint_put_histogram(checkpoint_file *const f, const uint64_t *const histogram,
+                                             const size_t size)
+{
+    size_t  nonzero = 0, prev = 0, i;
+
+    for (i = 0; i < size; i++)
+        nonzero += (histogram[i] != 0);
+
+    checkpoint_put_varint(f, nonzero);
+    for (i = 0; i < size; i++)
+        if (histogram[i]) {
+            checkpoint_put_varint(f, i - prev);
+            checkpoint_put_varint(f, histogram[i]);
+            prev = i;
+        }
+}
+
+STATIC_INLINE int  checkpoint_get_histogram(checkpoint_file *const f, uint64_t *const histogram,
+                                            const size_t size)
+{
+    uint64_t  nonzero, delta, value;
+    uint64_t  index = 0;
+
+    if (checkpoint_get_varint(f, &nonzero) || nonzero > size)
+        return CHECKPOINT_ERR_FORMAT;
+
+    while (nonzero-->0) {
+        if (checkpoint_get_varint(f, &delta) || checkpoint_get_varint(f, &value))
+            return CHECKPOINT_ERR_FORMAT;
+        index += delta;
+        if (index >= size || delta > size)
+            return CHECKPOINT_ERR_FORMAT;
+        histogram[index] = value;
+    }
+
+    return 0;
+}
+
+/* Write a checkpoint to 'path', atomically replacing any existing file. */
+static int checkpoint_save(const checkpoint *const cp, const char *const path)
+{
+    const size_t     pathlen = (path) ? strlen(path) : 0;
+    checkpoint_file  f;
+    char            *temp;
+    size_t           i;
+    int              result = 0;
+
+    if (!cp || !pathlen || !cp->white_histogram || !cp->black_histogram)
+        return CHECKPOINT_ERR_INVALID;
+
+    temp = malloc(pathlen + 5);
+    if (!temp)
+        return CHECKPOINT_ERR_NOMEM;
+    memcpy(temp, path, pathlen);
+    memcpy(temp + pathlen, ".tmp", 5);
+
+    f.stream = fopen(temp, "wb");
+    if (!f.stream) {
+        result = errno;
+        free(temp);
+        return result;
+    }
+    f.hash = UINT64_C(14695981039346656037);
+
+    for (i = 0; i < 8; i++)
+        checkpoint_put(&f, (unsigned char)CHECKPOINT_MAGIC[i]);
+
+    checkpoint_put_varint(&f, cp->rows);
+    checkpoint_put_varint(&f, cp->cols);
+    checkpoint_put_varint(&f, CHECKPOINT_PARAMS);
+    for (i = 0; i < CHECKPOINT_PARAMS; i++)
+        checkpoint_put_varint(&f, cp->param[i]);
+    checkpoint_put_varint(&f, cp->seed);
+    checkpoint_put_varint(&f, cp->iterations);
+    checkpoint_put_varint(&f, cp->white_spans);
+    checkpoint_put_varint(&f, cp->black_spans);
+    checkpoint_put_varint(&f, cp->streams);
+    for (i = 0; i < cp->streams; i++) {
+        checkpoint_put_varint(&f, cp->state[i]);
+        checkpoint_put_varint(&f, cp->done[i]);
+    }
+    checkpoint_put_histogram(&f, cp->white_histogram, cp->size);
+    checkpoint_put_histogram(&f, cp->black_histogram, cp->size);
+
+    {
+        const uint64_t  hash = f.hash;
+        for (i = 0; i < 8; i++)
+            putc((unsigned char)(hash >> (8*i)), f.stream);
+    }
+
+    /* Make sure the data is on disk before the rename. */
+    if (fflush(f.stream) || ferror(f.stream) || fsync(fileno(f.stream)))
+        result = (errno) ? errno : EIO;
+    if (fclose(f.stream) && !result)
+        result = (errno) ? errno : EIO;
+    if (!result && rename(temp, path))
+        result = (errno) ? errno : EIO;
+    if (result)
+        remove(temp);
+
+    free(temp);
+    return result;
+}
+
+/* Read a checkpoint from 'path'. The checkpoint is initialized here. */
+static int checkpoint_load(checkpoint *const cp, const char *const path)
+{
+    checkpoint_file  f;
+    uint64_t         rows, cols, params, streams, temp;
+    uint64_t         head[CHECKPOINT_PARAMS + 4];
+    unsigned char    byte;
+    size_t           i;
+    int              result;
+
+    if (!cp || !path || !*path)
+        return CHECKPOINT_ERR_INVALID;
+
+    memset(cp, 0, sizeof *cp);
+
+    f.stream = fopen(path, "rb");
+    if (!f.stream)
+        return errno;
+    f.hash = UINT64_C(14695981039346656037);
+
+    for (i = 0; i < 8; i++)
+        if (checkpoint_get(&f, &byte) || byte != (unsigned char)CHECKPOINT_MAGIC[i]) {
+            fclose(f.stream);
+            return CHECKPOINT_ERR_FORMAT;
+        }
+
+    if (checkpoint_get_varint(&f, &rows) || checkpoint_get_varint(&f, &cols) ||
+        checkpoint_get_varint(&f, &params) || params != CHECKPOINT_PARAMS) {
+        fclose(f.stream);
+        return CHECKPOINT_ERR_FORMAT;
+    }
+
+    for (i = 0; i < CHECKPOINT_PARAMS + 4; i++)
+        if (checkpoint_get_varint(&f, head + i)) {
+            fclose(f.stream);
+            return CHECKPOINT_ERR_FORMAT;
+        }
+
+    /* Each stream takes at least two bytes. */
+    if (checkpoint_get_varint(&f, &streams) || streams > (uint64_t)1 << 24) {
+        fclose(f.stream);
+        return CHECKPOINT_ERR_FORMAT;
+    }
+
+    result = init_checkpoint(cp, rows, cols, (size_t)streams);
+    if (result) {
+        fclose(f.stream);
+        return (result == CHECKPOINT_ERR_INVALID) ? CHECKPOINT_ERR_FORMAT : result;
+    }
+
+    for (i = 0; i < CHECKPOINT_PARAMS; i++)
+        cp->param[i] = head[i];
+    cp->seed = head[CHECKPOINT_PARAMS + 0];
+    cp->iterations = head[CHECKPOINT_PARAMS + 1];
+    cp->white_spans = head[CHECKPOINT_PARAMS + 2];
+    cp->black_spans = head[CHECKPOINT_PARAMS + 3];
+
+    for (i = 0; i < cp->streams; i++)
+        if (checkpoint_get_varint(&f, cp->state + i) || checkpoint_get_varint(&f, cp->done + i)) {
+            fclose(f.stream);
+            free_checkpoint(cp);
+            return CHECKPOINT_ERR_FORMAT;
+        }
+
+    if (checkpoint_get_histogram(&f, cp->white_histogram, cp->size) ||
+        checkpoint_get_histogram(&f, cp->black_histogram, cp->size)) {
+        fclose(f.stream);
+        free_checkpoint(cp);
+        return CHECKPOINT_ERR_FORMAT;
+    }
+
+    /* The hash of the preceding bytes, and nothing after it. */
+    {
+        const uint64_t  hash = f.hash;
+        temp = 0;
+        for (i = 0; i < 8; i++) {
+            if (checkpoint_get(&f, &byte)) {
+                fclose(f.stream);
+                free_checkpoint(cp);
+                return CHECKPOINT_ERR_FORMAT;
+            }
+            temp |= (uint64_t)byte << (8*i);
+        }
+        if (temp != hash || getc(f.stream) != EOF) {
+            fclose(f.stream);
+            free_checkpoint(cp);
+            return CHECKPOINT_ERR_FORMAT;
+        }
+    }
+
+    fclose(f.stream);
+    return 0;
+}
+
+/* Add the statistics of checkpoint 'from' to checkpoint 'to'.
+   The result has no generator streams, and cannot be continued. */
+STATIC_INLINE int checkpoint_merge(checkpoint *const to, const checkpoint *const from)
+{
+    size_t  i;
+
+    if (!to || !from || !to->white_histogram || !from->white_histogram)
+        return CHECKPOINT_ERR_INVALID;
+
+    if (to->rows != from->rows || to->cols != from->cols)
+        return CHECKPOINT_ERR_MISMATCH;
+    for (i = 0; i < CHECKPOINT_PARAMS; i++)
+        if (to->param[i] != from->param[i])
+            return CHECKPOINT_ERR_MISMATCH;
+
+    for (i = 0; i < to->size; i++) {
+        to->white_histogram[i] += from->white_histogram[i];
+        to->black_histogram[i] += from->black_histogram[i];
+    }
+    to->iterations += from->iterations;
+    to->white_spans += from->white_spans;
+    to->black_spans += from->black_spans;
+
+    free(to->state);
+    free(to->done);
+    to->state = NULL;
+    to->done = NULL;
+    to->streams = 0;
+    to->seed = 0;
+
+    return 0;
+}
+
+/* Print the white and black histograms of cluster sizes 1 to n to 'out',
+   one data line per size, or per base-2 logarithmic bin of sizes if
+   'log_bins' is nonzero. Both histograms must have n+2 entries, with
+   the first and the last zero. */
+STATIC_INLINE void checkpoint_print_histogram(FILE *const out, const uint64_t *const white_histogram,
+                                              const uint64_t *const black_histogram,
+                                              const size_t n, const int log_bins)
+{
+    size_t  i;
+
+    if (log_bins) {
+        fprintf(out, "# min_size max_size  white_clusters black_clusters clusters\n");
+        for (i = 1; i <= n; i *= 2) {
+            const size_t  max = (i <= n / 2) ? 2*i - 1 : n;
+            uint64_t      white = 0, black = 0;
+            size_t        j;
+
+            for (j = i; j <= max; j++) {
+                white += white_histogram[j];
+                black += black_histogram[j];
+            }
+
+            if (white || black)
+                fprintf(out, "%lu %lu %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+                        (unsigned long)i, (unsigned long)max,
+                        white, black, white + black);
+        }
+    } else {
+        fprintf(out, "# size  white_clusters(size) black_clusters(size) clusters(size)\n");
+
+        /* Note: histogram[0] == histogram[n+1] == 0, for ease of scanning. */
+        for (i = 1; i <= n; i++)
+            if (white_histogram[i-1] || white_histogram[i] || white_histogram[i+1] ||
+                black_histogram[i-1] || black_histogram[i] || black_histogram[i+1])
+                fprintf(out, "%lu %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+                        (unsigned long)i,
+                        white_histogram[i],
+                        black_histogram[i],
+                        white_histogram[i] + black_histogram[i]);
+    }
+}
+
+#endif /* CHECKPOINT_H */
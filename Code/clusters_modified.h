@@ -1,627 +1,1882 @@
-#ifndef   CLUSTERS_H
-#define   CLUSTERS_H
-#include <stdlib.h>
-#include <inttypes.h>
-#include <limits.h>
-#include <time.h>
-#include <string.h>
-#ifndef  STATIC_INLINE
-#define  STATIC_INLINE  static inline
-#endif
-
-#define  ERR_INVALID   -1   /* Invalid function parameter */
-#define  ERR_TOOLARGE  -2   /* Matrix size is too large */
-#define  ERR_NOMEM     -3   /* Out of memory */
-
-typedef  unsigned char  cluster_color;
-
-typedef  uint32_t  cluster_label;
-typedef  uint64_t  cluster_count;
-
-#define  CLUSTER_WHITE  0
-#define  CLUSTER_BLACK  1
-#define  CLUSTER_NONE   UCHAR_MAX   /* Reserved */
-
-#define  FMT_COLOR  "u"
-#define  FMT_LABEL  PRIu32
-#define  FMT_COUNT  PRIu64
-
-
-typedef struct {
-	uint64_t        state;
-} prng;
-
-typedef struct {
-	/* Pseudo-random number generator used */
-	prng            rng;
-
-	/* Actual size of the matrix */
-	cluster_label   rows;
-	cluster_label   cols;
-
-	/* Number of matrices the histograms have been collected from */
-	cluster_count   iterations;
-
-	/* Number of times when at least one cluster spanned the matrix */
-	cluster_count   white_spans;
-	cluster_count   black_spans;
-
-	/* Probability of each cell being black */
-	uint64_t        p_black;
-
-	/* Probability of diagonal connections */
-	uint64_t        d_black;
-	uint64_t        d_white;
-
-	/* Cluster colormap contains (rows+2) rows and (cols+1) columns */
-	cluster_color  *map;
-
-	/* Disjoint set of (rows) rows and (cols) columns */
-	cluster_label  *djs;
-
-	/* Number of occurrences per disjoint set root */
-	cluster_label  *white_roots;
-	cluster_label  *black_roots;
-
-	/* Histograms of white and black clusters */
-	cluster_count  *white_histogram;
-	cluster_count  *black_histogram;
-} cluster;
-#define  CLUSTER_INITIALIZER  { {0}, 0, 0, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL }
-
-/* Calculate uint64_t limit corresponding to probability p. */
-STATIC_INLINE uint64_t  probability_limit(const double p)
-{
-	if (p <= 0.0)
-		return UINT64_C(0);
-	else
-		if (p <= 0.5)
-			return (uint64_t)(p * 18446744073709551615.0);
-		else
-			if (p >= 1.0)
-				return UINT64_C(18446744073709551615);
-			else
-				return UINT64_C(18446744073709551615) - (uint64_t)((double)(1.0 - p) * 18446744073709551615.0);
-}
-
-/* Return true at probability corresponding to limit 'limit'.
-This implements a Xorshift64* pseudo-random number generator. */
-STATIC_INLINE int  probability(prng *const rng, const uint64_t limit)
-{
-	uint64_t  state = rng->state;
-	uint64_t  value;
-
-	/* To correctly cover the entire range, we ensure we never generate a zero. */
-	do {
-		state ^= state >> 12;
-		state ^= state << 25;
-		state ^= state >> 27;
-		value = state * UINT64_C(2685821657736338717);
-	} while (!value);
-
-	rng->state = state;
-
-	return (value <= limit) ? CLUSTER_BLACK : CLUSTER_WHITE;
-}
-
-/* Generate a random seed for the Xorshift64* pseudo-random number generator. */
-static uint64_t  randomize(prng *const rng)
-{
-	unsigned int  rounds = 127;
-	uint64_t      state = UINT64_C(3069887672279) * (uint64_t)time(NULL)
-		^ UINT64_C(60498839) * (uint64_t)clock();
-	if (!state)
-		state = 1;
-
-	/* Churn the state a bit. */
-	while (rounds-->0) {
-		state ^= state >> 12;
-		state ^= state << 25;
-		state ^= state >> 27;
-	}
-
-	if (rng)
-		rng->state = state;
-
-	return state;
-}
-
-/* Free all resources related to a cluster. */
-STATIC_INLINE void free_cluster(cluster *c)
-{
-	if (c) {
-		/* Free dynamically allocated pointers. Note: free(NULL) is safe. */
-		free(c->map);
-		free(c->djs);
-		free(c->white_roots);
-		free(c->black_roots);
-		free(c->white_histogram);
-		free(c->black_histogram);
-		c->rng.state = 0;
-		c->rows = 0;
-		c->cols = 0;
-		c->iterations = 0;
-		c->white_spans = 0;
-		c->black_spans = 0;
-		c->p_black = 0;
-		c->d_white = 0;
-		c->d_black = 0;
-		c->map = NULL;
-		c->djs = NULL;
-		c->white_roots = 0;
-		c->black_roots = 0;
-		c->white_histogram = NULL;
-		c->black_histogram = NULL;
-	}
-}
-
-/* Initialize cluster structure, for a matrix of specified size. */
-static int init_cluster(cluster *c, const int rows, const int cols,
-	const double p_black,
-	const double d_white, const double d_black)
-{
-	const cluster_label  label_cols = cols;
-	const cluster_label  label_rows = rows;
-	const cluster_label  color_rows = rows + 2;
-	const cluster_label  color_cols = cols + 1;
-	const cluster_label  color_cells = color_rows * color_cols;
-	const cluster_label  label_cells = label_rows * label_cols;
-	const cluster_label  labels = label_cells + 2; /* One extra! */
-
-	if (!c)
-		return ERR_INVALID;
-
-	c->rng.state = 0; /* Invalid seed for Xorshift64*. */
-	c->rows = 0;
-	c->cols = 0;
-	c->iterations = 0;
-	c->white_spans = 0;
-	c->black_spans = 0;
-	c->p_black = 0;
-	c->d_white = 0;
-	c->d_black = 0;
-	c->map = NULL;
-	c->djs = NULL;
-	c->white_roots = NULL;
-	c->black_roots = NULL;
-	c->white_histogram = NULL;
-	c->black_histogram = NULL;
-
-	if (rows < 1 || cols < 1)
-		return ERR_INVALID;
-
-	if ((unsigned int)color_rows <= (unsigned int)rows ||
-		(unsigned int)color_cols <= (unsigned int)cols ||
-		(cluster_label)(color_cells / color_rows) != color_cols ||
-		(cluster_label)(color_cells / color_cols) != color_rows ||
-		(cluster_label)(label_cells / label_rows) != label_cols ||
-		(cluster_label)(label_cells / label_cols) != label_rows)
-		return ERR_TOOLARGE;
-
-	c->black_histogram = (cluster_count*)calloc(labels, sizeof(cluster_count));
-	c->white_histogram = (cluster_count*)calloc(labels, sizeof(cluster_count));
-	c->black_roots = (cluster_label*)calloc(labels, sizeof(cluster_label));
-	c->white_roots = (cluster_label*)calloc(labels, sizeof(cluster_label));
-	c->djs = (cluster_label*)calloc(label_cells, sizeof(cluster_label));
-	c->map = (cluster_color*)calloc(color_cells, sizeof(cluster_color));
-	if (!c->map || !c->djs ||
-		!c->white_roots || !c->black_roots ||
-		!c->white_histogram || !c->black_histogram) {
-		free(c->map);
-		free(c->djs);
-		free(c->white_roots);
-		free(c->black_roots);
-		free(c->white_histogram);
-		free(c->black_histogram);
-		return ERR_NOMEM;
-	}
-
-	c->rows = rows;
-	c->cols = cols;
-
-	c->p_black = probability_limit(p_black);
-	c->d_white = probability_limit(d_white);
-	c->d_black = probability_limit(d_black);
-
-	/* Initialize the color map to NONE. */
-	{
-		cluster_color        *ptr = c->map;
-		cluster_color *const  end = c->map + color_cells;
-		while (ptr < end)
-			*(ptr++) = CLUSTER_NONE;
-	}
-
-	/* calloc() initialized the other arrays to zeros already. */
-	return 0;
-}
-
-/* Disjoint set: find root. */
-STATIC_INLINE cluster_label  djs_root(const cluster_label *const  djs, cluster_label  from)
-{
-	while (from != djs[from])
-		from = djs[from];
-	return from;
-}
-
-/* Disjoint set: path compression. */
-STATIC_INLINE void  djs_path(cluster_label *const  djs, cluster_label  from, const cluster_label  root)
-{
-	while (from != root) {
-		const cluster_label  temp = djs[from];
-		djs[from] = root;
-		from = temp;
-	}
-}
-
-/* Disjoint set: Flatten. Returns the root, and flattens the path to it. */
-STATIC_INLINE cluster_label  djs_flatten(cluster_label *const  djs, cluster_label  from)
-{
-	const cluster_label  root = djs_root(djs, from);
-	djs_path(djs, from, root);
-	return root;
-}
-
-/* Disjoint set: Join two subsets. */
-STATIC_INLINE void  djs_join2(cluster_label *const  djs,
-	cluster_label  from1, cluster_label  from2)
-{
-	cluster_label  root, temp;
-
-	root = djs_root(djs, from1);
-
-	temp = djs_root(djs, from2);
-	if (root > temp)
-		temp = root;
-
-	djs_path(djs, from1, root);
-	djs_path(djs, from2, root);
-}
-
-/* Disjoint set: Join three subsets. */
-STATIC_INLINE void  djs_join3(cluster_label *const  djs,
-	cluster_label  from1, cluster_label  from2,
-	cluster_label  from3)
-{
-	cluster_label  root, temp;
-
-	root = djs_root(djs, from1);
-
-	temp = djs_root(djs, from2);
-	if (root > temp)
-		root = temp;
-
-	temp = djs_root(djs, from3);
-	if (root > temp)
-		root = temp;
-
-	djs_path(djs, from1, root);
-	djs_path(djs, from2, root);
-	djs_path(djs, from3, root);
-}
-
-/* Disjoint set: Join four subsets. */
-STATIC_INLINE void  djs_join4(cluster_label *const  djs,
-	cluster_label  from1, cluster_label  from2,
-	cluster_label  from3, cluster_label  from4)
-{
-	cluster_label  root, temp;
-
-	root = djs_root(djs, from1);
-
-	temp = djs_root(djs, from2);
-	if (root > temp)
-		root = temp;
-
-	temp = djs_root(djs, from3);
-	if (root > temp)
-		root = temp;
-
-	temp = djs_root(djs, from4);
-	if (root > temp)
-		root = temp;
-
-	djs_path(djs, from1, root);
-	djs_path(djs, from2, root);
-	djs_path(djs, from3, root);
-	djs_path(djs, from4, root);
-}
-
-/* Disjoint set: Join five subsets. */
-STATIC_INLINE void  djs_join5(cluster_label *const  djs,
-	cluster_label  from1, cluster_label  from2,
-	cluster_label  from3, cluster_label  from4,
-	cluster_label  from5)
-{
-	cluster_label  root, temp;
-
-	root = djs_root(djs, from1);
-
-	temp = djs_root(djs, from2);
-	if (root > temp)
-		root = temp;
-
-	temp = djs_root(djs, from3);
-	if (root > temp)
-		root = temp;
-
-	temp = djs_root(djs, from4);
-	if (root > temp)
-		root = temp;
-
-	temp = djs_root(djs, from5);
-	if (root > temp)
-		root = temp;
-
-	djs_path(djs, from1, root);
-	djs_path(djs, from2, root);
-	djs_path(djs, from3, root);
-	djs_path(djs, from4, root);
-	djs_path(djs, from5, root);
-}
-
-static int compare_cluster_label(const void *ptr1, const void *ptr2)
-{
-	const cluster_label  val1 = *(const cluster_label *)ptr1;
-	const cluster_label  val2 = *(const cluster_label *)ptr2;
-	return (val1 < val2) ? -1 :
-		(val1 > val2) ? +1 : 0;
-}
-
-/* Return nonzero if the two arrays contain any same elements. */
-static int have_same_labels(cluster_label *set1, cluster_label *const end1,
-	cluster_label *set2, cluster_label *const end2)
-{
-	if (end1 <= set1 || end2 <= set2)
-		return 0;
-
-	/* Sort the arrays. */
-	if (set1 + 1 < end1)
-		qsort(set1, (size_t)(end1 - set1), sizeof set1[0], compare_cluster_label);
-	if (set2 + 1 < end2)
-		qsort(set2, (size_t)(end2 - set2), sizeof set2[0], compare_cluster_label);
-
-	while (set1 < end1 && set2 < end2)
-		if (*set1 < *set2) {
-			while (set1 < end1 && *set1 < *set2)
-				set1++;
-		}
-		else
-			if (*set2 < *set1) {
-				while (set2 < end2 && *set2 < *set1)
-					set2++;
-			}
-			else
-				return 1;
-
-	return 0;
-}
-
-
-static void iterate(cluster *const cl)
-{
-	prng          *const  rng = &(cl->rng);
-	uint64_t       const  p_black = cl->p_black;
-	uint64_t              d_color[2];
-
-	cluster_color *const  map = cl->map + cl->cols + 2;
-	cluster_label  const  map_stride = cl->cols + 1;
-
-	cluster_label *const  djs = cl->djs;
-
-	cluster_label        *roots[2];
-
-	cluster_label  const  rows = cl->rows;
-	cluster_label  const  cols = cl->cols;
-
-	int                   r, c;
-
-	d_color[CLUSTER_WHITE] = cl->d_white;
-	d_color[CLUSTER_BLACK] = cl->d_black;
-	roots[CLUSTER_WHITE] = cl->white_roots;
-	roots[CLUSTER_BLACK] = cl->black_roots;
-
-	for (r = 0; r < rows; r++) {
-		cluster_label  const  curr_i = r * cols;
-		cluster_color *const  curr_row = map + r * map_stride;
-		cluster_color *const  prev_row = curr_row - map_stride;
-
-		for (c = 0; c < cols; c++) {
-			cluster_color  color = probability(rng, p_black);
-			cluster_label  label = curr_i + c;
-			uint64_t       diag = d_color[color];
-			unsigned int   joins = 0;
-
-			/* Assign the label and color of the current cell, */
-			djs[label] = label;
-			curr_row[c] = color;
-
-			/* Because we join left, up-left, up, and up-right, and
-			all those have been assigned to already, we can do
-			the necessary joins right now. */
-
-			/* Join left? */
-			joins |= (curr_row[c - 1] == color) << 0;
-
-			/* Join up? */
-			joins |= (prev_row[c] == color) << 1;
-
-			/* Join up left? */
-			joins |= (prev_row[c - 1] == color && probability(rng, diag)) << 2;
-
-			/* Join up right? */
-			joins |= (prev_row[c + 1] == color && probability(rng, diag)) << 3;
-
-			/* Do the corresponding joins. */
-			switch (joins) {
-			case 1: /* Left */
-				djs_join2(djs, label, label - 1);
-				break;
-			case 2: /* Up */
-				djs_join2(djs, label, label - cols);
-				break;
-			case 3: /* Left and up */
-				djs_join3(djs, label, label - 1, label - cols);
-				break;
-			case 4: /* Up-left */
-				djs_join2(djs, label, label - cols - 1);
-				break;
-			case 5: /* Left and up-left */
-				djs_join3(djs, label, label - 1, label - cols - 1);
-				break;
-			case 6: /* Up and up-left */
-				djs_join3(djs, label, label - cols, label - cols - 1);
-				break;
-			case 7: /* Left, up, and up-left */
-				djs_join4(djs, label, label - 1, label - cols, label - cols - 1);
-				break;
-			case 8: /* Up-right */
-				djs_join2(djs, label, label - cols + 1);
-				break;
-			case 9: /* Left and up-right */
-				djs_join3(djs, label, label - 1, label - cols + 1);
-				break;
-			case 10: /* Up and up-right */
-				djs_join3(djs, label, label - cols, label - cols + 1);
-				break;
-			case 11: /* Left, up, and up-right */
-				djs_join4(djs, label, label - 1, label - cols, label - cols + 1);
-				break;
-			case 12: /* Up-left and up-right */
-				djs_join3(djs, label, label - cols - 1, label - cols + 1);
-				break;
-			case 13: /* Left, up-left, and up-right */
-				djs_join4(djs, label, label - 1, label - cols - 1, label - cols + 1);
-				break;
-			case 14: /* Up, up-left, and up-right */
-				djs_join4(djs, label, label - cols, label - cols - 1, label - cols + 1);
-				break;
-			case 15: /* Left, up, up-left, and up-right */
-				djs_join5(djs, label, label - 1, label - cols, label - cols - 1, label - cols + 1);
-				break;
-			}
-		}
-	}
-
-	/* Count the occurrences of each disjoint-set root label. */
-	if (roots[0] && roots[1]) {
-		const size_t  labels = rows * cols + 2;
-
-		/* Clear the counts. */
-		memset(roots[0], 0, labels * sizeof(cluster_label));
-		memset(roots[1], 0, labels * sizeof(cluster_label));
-
-		for (r = 0; r < rows; r++) {
-			const cluster_color *const  curr_row = map + r * map_stride;
-			const cluster_label         curr_i = r * cols;
-			for (c = 0; c < cols; c++)
-				roots[curr_row[c]][djs_flatten(djs, curr_i + c)]++;
-		}
-	}
-	else {
-		size_t  i = rows * cols;
-		while (i-->0)
-			djs_flatten(djs, i);
-	}
-
-	/* Collect the statistics. */
-	if (cl->white_histogram && roots[0]) {
-		const cluster_label *const  root_count = roots[0];
-		cluster_count *const        histogram = cl->white_histogram;
-		size_t                      i = rows * cols + 1;
-		while (i-->0)
-			histogram[root_count[i]]++;
-	}
-	if (cl->black_histogram && roots[1]) {
-		const cluster_label *const  root_count = roots[1];
-		cluster_count *const        histogram = cl->black_histogram;
-		size_t                      i = rows * cols + 1;
-		while (i-->0)
-			histogram[root_count[i]]++;
-	}
-
-	/* Note: index zero and (rows*cols+1) are zero in the histogram, for ease of scanning. */
-	if (cl->white_histogram || cl->black_histogram) {
-		const size_t  n = rows * cols + 1;
-		if (cl->white_histogram) {
-			cl->white_histogram[0] = 0;
-			cl->white_histogram[n] = 0;
-		}
-		if (cl->black_histogram) {
-			cl->black_histogram[0] = 0;
-			cl->black_histogram[n] = 0;
-		}
-	}
-
-	/* Check if a white cluster spans the matrix. */
-	{
-		cluster_label *const  set1 = roots[0];
-		cluster_label        *end1 = set1;
-		cluster_label *const  set2 = roots[1];
-		cluster_label        *end2 = set2;
-		cluster_color *const  map_lastrow = map + (rows - 1)*map_stride;
-		cluster_label *const  djs_lastrow = djs + (rows - 1)*cols;
-
-		for (r = 0; r < rows; r++) {
-			if (map[r*map_stride] == CLUSTER_WHITE)
-				*(end1++) = djs[r*cols];
-			if (map[r*map_stride + cols - 1] == CLUSTER_WHITE)
-				*(end2++) = djs[r*cols + cols - 1];
-		}
-
-		if (have_same_labels(set1, end1, set2, end2))
-			cl->white_spans++;
-		else {
-			end1 = set1;
-			end2 = set2;
-
-			for (c = 0; c < cols; c++) {
-				if (map[c] == CLUSTER_WHITE)
-					*(end1++) = djs[c];
-				if (map_lastrow[c] == CLUSTER_WHITE)
-					*(end2++) = djs_lastrow[c];
-			}
-
-			if (have_same_labels(set1, end1, set2, end2))
-				cl->white_spans++;
-		}
-	}
-
-	/* Check if a black cluster spans the matrix. */
-	{
-		cluster_label *const  set1 = roots[0];
-		cluster_label        *end1 = set1;
-		cluster_label *const  set2 = roots[1];
-		cluster_label        *end2 = set2;
-		cluster_color *const  map_lastrow = map + (rows - 1)*map_stride;
-		cluster_label *const  djs_lastrow = djs + (rows - 1)*cols;
-
-		for (r = 0; r < rows; r++) {
-			if (map[r*map_stride] == CLUSTER_BLACK)
-				*(end1++) = djs[r*cols];
-			if (map[r*map_stride + cols - 1] == CLUSTER_BLACK)
-				*(end2++) = djs[r*cols + cols - 1];
-		}
-
-		if (have_same_labels(set1, end1, set2, end2))
-			cl->black_spans++;
-		else {
-			end1 = set1;
-			end2 = set2;
-
-			for (c = 0; c < cols; c++) {
-				if (map[c] == CLUSTER_BLACK)
-					*(end1++) = djs[c];
-				if (map_lastrow[c] == CLUSTER_BLACK)
-					*(end2++) = djs_lastrow[c];
-			}
-
-			if (have_same_labels(set1, end1, set2, end2))
-				cl->black_spans++;
-		}
-	}
-
-	/* One more iteration performed. */
-	cl->iterations++;
-}
-
-#endif /* CLUSTERS_H */
+#ifndef   CLUSTERS_H
+#define   CLUSTERS_H
+#include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <time.h>
+#include <string.h>
+#include "bernoulli.h"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#ifndef  STATIC_INLINE
+#define  STATIC_INLINE  static inline
+#endif
+
+#define  ERR_INVALID   -1   /* Invalid function parameter */
+#define  ERR_TOOLARGE  -2   /* Matrix size is too large */
+#define  ERR_NOMEM     -3   /* Out of memory */
+
+typedef  unsigned char  cluster_color;
+
+typedef  uint32_t  cluster_label;
+typedef  uint64_t  cluster_count;
+
+#define  CLUSTER_WHITE  0
+#define  CLUSTER_BLACK  1
+#define  CLUSTER_NONE   UCHAR_MAX   /* Reserved */
+
+/* Spanning criteria */
+#define  CLUSTER_SPAN_HORIZONTAL  1   /* Left to right */
+#define  CLUSTER_SPAN_VERTICAL    2   /* Top to bottom */
+#define  CLUSTER_SPAN_EITHER      3   /* Left to right, or top to bottom */
+#define  CLUSTER_SPAN_BOTH        4   /* Left to right and top to bottom */
+
+/* Boundary conditions */
+#define  CLUSTER_BOUNDARY_OPEN      0   /* Cells outside the matrix are empty */
+#define  CLUSTER_BOUNDARY_PERIODIC  1   /* The matrix wraps around (a torus) */
+
+/* Wrapping directions of a cluster on a periodic matrix */
+#define  CLUSTER_WRAPS_X  1u
+#define  CLUSTER_WRAPS_Y  2u
+
+/* Defined by this engine only, and not by clusters.h */
+#define  CLUSTER_ENGINE_MODIFIED  1
+
+/* Random number generators */
+#define  CLUSTER_RNG_SEQUENTIAL  0   /* One Xorshift64* stream */
+#define  CLUSTER_RNG_COUNTER     1   /* Counter-based; see counter_key() */
+
+/* Purposes of the counter-based random numbers of each cell */
+#define  CLUSTER_DRAW_COLOR    0   /* Color of the cell */
+#define  CLUSTER_DRAW_UPLEFT   1   /* Diagonal join up and left */
+#define  CLUSTER_DRAW_UPRIGHT  2   /* Diagonal join up and right */
+#define  CLUSTER_DRAWS         3
+
+#define  FMT_COLOR  "u"
+#define  FMT_LABEL  PRIu32
+#define  FMT_COUNT  PRIu64
+
+#ifdef CLUSTER_PROFILE
+#include <stdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Phases of iterate(), timed separately in an instrumented build. */
+#define  CLUSTER_PHASE_LABEL      0   /* Generation and joins */
+#define  CLUSTER_PHASE_ROOTS      1   /* Counting the roots */
+#define  CLUSTER_PHASE_HISTOGRAM  2   /* Updating the histograms */
+#define  CLUSTER_PHASE_SPANNING   3   /* Checking for spanning clusters */
+#define  CLUSTER_PHASES           4
+
+/* Per-phase cycle counts and operation counters. */
+typedef struct {
+	uint64_t        cycles[CLUSTER_PHASES];   /* Time stamp counter ticks */
+	uint64_t        bytes[CLUSTER_PHASES];    /* Estimated bytes touched */
+	uint64_t        walks[CLUSTER_PHASES];    /* Disjoint set root walks */
+	uint64_t        steps[CLUSTER_PHASES];    /* Steps taken in root walks */
+	uint64_t        longest;                  /* Longest root walk */
+	uint64_t        joins[16];                /* Cells per joins case */
+} cluster_profile;
+
+/* Root walk counters of the current thread. iterate() moves them to
+   the cluster after each phase, so replicas in different threads do
+   not disturb each other. */
+static _Thread_local struct {
+	uint64_t        walks;
+	uint64_t        steps;
+	uint64_t        longest;
+	uint64_t        current;
+} djs_profile;
+
+#define  DJS_PROFILE_STEP()  (djs_profile.current++)
+#define  DJS_PROFILE_WALK()  do { \
+		djs_profile.walks++; \
+		djs_profile.steps += djs_profile.current; \
+		if (djs_profile.longest < djs_profile.current) \
+			djs_profile.longest = djs_profile.current; \
+		djs_profile.current = 0; \
+	} while (0)
+
+#else  /* !CLUSTER_PROFILE */
+
+#define  DJS_PROFILE_STEP()  ((void)0)
+#define  DJS_PROFILE_WALK()  ((void)0)
+
+#endif /* CLUSTER_PROFILE */
+
+
+typedef struct {
+	uint64_t        state;
+} prng;
+
+/* Periodic boundaries: union-find of the roots of the open-boundary
+   clusters, with the displacement (dx, dy) from each root to its parent
+   when the clusters are unwrapped onto the plane. */
+typedef struct {
+	cluster_label   parent;
+	int32_t         dx;
+	int32_t         dy;
+	unsigned int    wraps;          /* CLUSTER_WRAPS_, valid for roots */
+} cluster_wrap;
+
+typedef struct {
+	/* Pseudo-random number generator used */
+	prng            rng;
+
+	/* Actual size of the matrix */
+	cluster_label   rows;
+	cluster_label   cols;
+
+	/* Number of matrices the histograms have been collected from */
+	cluster_count   iterations;
+
+	/* Number of times when at least one cluster spanned the matrix */
+	cluster_count   white_spans;
+	cluster_count   black_spans;
+
+	/* Sums of the Euler numbers of the white and black cells, and of their
+	   squares, over the iterations; see euler_block() */
+	int64_t         white_euler;
+	int64_t         black_euler;
+	double          white_euler2;
+	double          black_euler2;
+
+	/* Probability of each cell being black */
+	uint64_t        p_black;
+
+	/* Probability of diagonal connections */
+	uint64_t        d_black;
+	uint64_t        d_white;
+
+	/* Cluster colormap contains (rows+2) rows and (cols+1) columns */
+	cluster_color  *map;
+
+	/* Disjoint set of (rows) rows and (cols) columns */
+	cluster_label  *djs;
+
+	/* Number of occurrences per disjoint set root; all zero between iterations.
+	   Not allocated with DJS_BY_SIZE */
+	cluster_label  *white_roots;
+	cluster_label  *black_roots;
+
+	/* Histograms of white and black clusters */
+	cluster_count  *white_histogram;
+	cluster_count  *black_histogram;
+
+	/* Bit-packed colors of two rows, and the neighbour equality masks and
+	   diagonal connection bits of the current row; only used if compiled
+	   with CLUSTER_BITPACK, in addition to the byte map */
+	uint64_t       *bits;
+
+	/* Roots seen in the current iteration, (rows*cols); white ones from the
+	   start, black ones from the end. Not allocated with DJS_BY_SIZE */
+	cluster_label  *root_list;
+
+	/* Spanning criterion, CLUSTER_SPAN_EITHER by default */
+	int             span_mode;
+
+	/* Spanning marks per root, (rows*cols), and the last stamp used;
+	   a root is marked when its mark equals a stamp of this iteration */
+	cluster_label  *span_mark;
+	cluster_label   span_stamp;
+
+	/* Boundary conditions, CLUSTER_BOUNDARY_OPEN by default; see
+	   set_cluster_boundary() */
+	int             boundary;
+
+	/* Wrapping union-find, (rows*cols), and the cell pairs joined across
+	   the edges, 6*(rows+cols); only used with periodic boundaries */
+	cluster_wrap   *wrap;
+	cluster_label  *seam;
+
+	/* Random number generator, CLUSTER_RNG_SEQUENTIAL by default; with
+	   CLUSTER_RNG_COUNTER, the seed and the number of the next matrix */
+	int             rng_mode;
+	uint64_t        rng_seed;
+	cluster_count   realization;
+
+#ifdef CLUSTER_PROFILE
+	/* Instrumentation, collected by iterate() */
+	cluster_profile profile;
+#endif
+} cluster;
+#define  CLUSTER_INITIALIZER  { {0}, 0, 0, 0, 0, 0, 0, 0, 0.0, 0.0, 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, \
+                               CLUSTER_SPAN_EITHER, NULL, 0, CLUSTER_BOUNDARY_OPEN, NULL, NULL, \
+                               CLUSTER_RNG_SEQUENTIAL, 0, 0 }
+
+/* Calculate uint64_t limit corresponding to probability p. */
+STATIC_INLINE uint64_t  probability_limit(const double p)
+{
+	if (p <= 0.0)
+		return UINT64_C(0);
+	else
+		if (p <= 0.5)
+			return (uint64_t)(p * 18446744073709551615.0);
+		else
+			if (p >= 1.0)
+				return UINT64_C(18446744073709551615);
+			else
+				return UINT64_C(18446744073709551615) - (uint64_t)((double)(1.0 - p) * 18446744073709551615.0);
+}
+
+/* Return true at probability corresponding to limit 'limit'.
+This implements a Xorshift64* pseudo-random number generator. */
+STATIC_INLINE int  probability(prng *const rng, const uint64_t limit)
+{
+	uint64_t  state = rng->state;
+	uint64_t  value;
+
+	/* To correctly cover the entire range, we ensure we never generate a zero. */
+	do {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		value = state * UINT64_C(2685821657736338717);
+	} while (!value);
+
+	rng->state = state;
+
+	return (value <= limit) ? CLUSTER_BLACK : CLUSTER_WHITE;
+}
+
+/* Number of independent Xorshift64* lanes used by probability_fill(). */
+#define  CLUSTER_LANES  BERNOULLI_LANES
+
+/* Fill 'n' bits, packed 64 per word starting from the least significant bit,
+   with ones at probability corresponding to limit 'limit'; unused bits in the
+   final word are cleared. The generator state is advanced by a single step;
+   see bernoulli_fill(). */
+STATIC_INLINE void  probability_fill(prng *const  rng, const uint64_t  limit,
+	uint64_t *const  out, const size_t  n)
+{
+	bernoulli_fill(&(rng->state), limit, out, n);
+}
+
+/* Generate a random seed for the Xorshift64* pseudo-random number generator. */
+STATIC_INLINE uint64_t  randomize(prng *const rng)
+{
+	unsigned int  rounds = 127;
+	uint64_t      state = UINT64_C(3069887672279) * (uint64_t)time(NULL)
+		^ UINT64_C(60498839) * (uint64_t)clock();
+	if (!state)
+		state = 1;
+
+	/* Churn the state a bit. */
+	while (rounds-->0) {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+	}
+
+	if (rng)
+		rng->state = state;
+
+	return state;
+}
+
+/* Derive the seed of an independent generator stream from a base seed,
+   using the SplitMix64 mixing function. The result is never zero. */
+STATIC_INLINE uint64_t  split_seed(const uint64_t seed, const uint64_t stream)
+{
+	uint64_t  state = seed + (stream + 1) * UINT64_C(11400714819323198485);
+
+	state = (state ^ (state >> 30)) * UINT64_C(13787848793156543929);
+	state = (state ^ (state >> 27)) * UINT64_C(10723151780598845931);
+	state =  state ^ (state >> 31);
+
+	return (state) ? state : UINT64_C(1);
+}
+
+/* Counter-based generator.
+
+   Each random number is a function of the seed, the realization (the number
+   of the matrix generated with that seed), the purpose of the number
+   (CLUSTER_DRAW_), and the row and column of the cell. It does not depend on
+   the size of the matrix, or on the order the cells are generated in, so
+   any part of any realization can be generated on its own. counter_key()
+   mixes the seed, realization and purpose into a key once per matrix,
+   counter_row() the key and the row once per row, and counter_value()
+   the row key and the column, using the SplitMix64 mixing function. */
+STATIC_INLINE uint64_t  counter_mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * UINT64_C(13787848793156543929);
+	z = (z ^ (z >> 27)) * UINT64_C(10723151780598845931);
+	return z ^ (z >> 31);
+}
+
+STATIC_INLINE uint64_t  counter_key(const uint64_t seed, const uint64_t realization,
+	const unsigned int purpose)
+{
+	return counter_mix(split_seed(seed, realization) + (uint64_t)(purpose + 1) * UINT64_C(11400714819323198485));
+}
+
+STATIC_INLINE uint64_t  counter_row(const uint64_t key, const uint64_t row)
+{
+	return counter_mix(key ^ counter_mix(row + 1));
+}
+
+STATIC_INLINE uint64_t  counter_value(const uint64_t row_key, const uint64_t col)
+{
+	return counter_mix(row_key ^ counter_mix(col + 1));
+}
+
+/* Return true at probability corresponding to limit 'limit', for
+   column 'col' of the row with key 'row_key'. As with probability(),
+   a zero value is never used. */
+STATIC_INLINE int  counter_probability(const uint64_t row_key, const uint64_t col,
+	const uint64_t limit)
+{
+	const uint64_t  value = counter_value(row_key, col);
+
+	return (value + !value <= limit) ? CLUSTER_BLACK : CLUSTER_WHITE;
+}
+
+/* Fill 'n' bits, packed 64 per word starting from the least significant bit,
+   with counter_probability() of columns 0 to n-1; unused bits in the final
+   word are cleared. The cells are independent, so the compiler is free to
+   vectorize the loop. */
+STATIC_INLINE void  counter_fill(const uint64_t row_key, const uint64_t limit,
+	uint64_t *const  out, const size_t  n)
+{
+	const size_t  words = (n + 63) / 64;
+	size_t        w;
+	int           i;
+
+	if (!limit || limit == UINT64_C(18446744073709551615)) {
+		for (w = 0; w < words; w++)
+			out[w] = (limit) ? ~UINT64_C(0) : UINT64_C(0);
+	} else
+		for (w = 0; w < words; w++) {
+			uint64_t  word = 0;
+
+			for (i = 0; i < 64; i++) {
+				const uint64_t  value = counter_value(row_key, (uint64_t)(w * 64 + i));
+				word |= (uint64_t)(value + !value <= limit) << i;
+			}
+
+			out[w] = word;
+		}
+
+	if (n & 63)
+		out[words - 1] &= (UINT64_C(1) << (n & 63)) - 1;
+}
+
+/* Free all resources related to a cluster. */
+STATIC_INLINE void free_cluster(cluster *c)
+{
+	if (c) {
+		/* Free dynamically allocated pointers. Note: free(NULL) is safe. */
+		free(c->map);
+		free(c->djs);
+		free(c->white_roots);
+		free(c->black_roots);
+		free(c->white_histogram);
+		free(c->black_histogram);
+		free(c->bits);
+		free(c->root_list);
+		free(c->span_mark);
+		free(c->wrap);
+		free(c->seam);
+		c->rng.state = 0;
+		c->rows = 0;
+		c->cols = 0;
+		c->iterations = 0;
+		c->white_spans = 0;
+		c->black_spans = 0;
+		c->p_black = 0;
+		c->d_white = 0;
+		c->d_black = 0;
+		c->map = NULL;
+		c->djs = NULL;
+		c->white_roots = 0;
+		c->black_roots = 0;
+		c->white_histogram = NULL;
+		c->black_histogram = NULL;
+		c->bits = NULL;
+		c->root_list = NULL;
+		c->span_mode = 0;
+		c->span_mark = NULL;
+		c->span_stamp = 0;
+		c->boundary = CLUSTER_BOUNDARY_OPEN;
+		c->wrap = NULL;
+		c->seam = NULL;
+#ifdef CLUSTER_PROFILE
+		memset(&(c->profile), 0, sizeof c->profile);
+#endif
+	}
+}
+
+/* Initialize cluster structure, for a matrix of specified size. */
+STATIC_INLINE int init_cluster(cluster *c, const int rows, const int cols,
+	const double p_black,
+	const double d_white, const double d_black)
+{
+	const cluster_label  label_cols = cols;
+	const cluster_label  label_rows = rows;
+	const cluster_label  color_rows = rows + 2;
+	const cluster_label  color_cols = cols + 1;
+	const cluster_label  color_cells = color_rows * color_cols;
+	const cluster_label  label_cells = label_rows * label_cols;
+	const cluster_label  labels = label_cells + 2; /* One extra! */
+
+	if (!c)
+		return ERR_INVALID;
+
+	c->rng.state = 0; /* Invalid seed for Xorshift64*. */
+	c->rows = 0;
+	c->cols = 0;
+	c->iterations = 0;
+	c->white_spans = 0;
+	c->black_spans = 0;
+	c->white_euler = 0;
+	c->black_euler = 0;
+	c->white_euler2 = 0.0;
+	c->black_euler2 = 0.0;
+	c->p_black = 0;
+	c->d_white = 0;
+	c->d_black = 0;
+	c->map = NULL;
+	c->djs = NULL;
+	c->white_roots = NULL;
+	c->black_roots = NULL;
+	c->white_histogram = NULL;
+	c->black_histogram = NULL;
+	c->bits = NULL;
+	c->root_list = NULL;
+	c->span_mode = CLUSTER_SPAN_EITHER;
+	c->span_mark = NULL;
+	c->span_stamp = 0;
+	c->boundary = CLUSTER_BOUNDARY_OPEN;
+	c->wrap = NULL;
+	c->seam = NULL;
+	c->rng_mode = CLUSTER_RNG_SEQUENTIAL;
+	c->rng_seed = 0;
+	c->realization = 0;
+#ifdef CLUSTER_PROFILE
+	memset(&(c->profile), 0, sizeof c->profile);
+#endif
+
+	if (rows < 1 || cols < 1)
+		return ERR_INVALID;
+
+	if ((unsigned int)color_rows <= (unsigned int)rows ||
+		(unsigned int)color_cols <= (unsigned int)cols ||
+		(cluster_label)(color_cells / color_rows) != color_cols ||
+		(cluster_label)(color_cells / color_cols) != color_rows ||
+		(cluster_label)(label_cells / label_rows) != label_cols ||
+		(cluster_label)(label_cells / label_cols) != label_rows)
+		return ERR_TOOLARGE;
+
+#ifdef DJS_BY_SIZE
+	/* The root flag leaves 31 bits for labels and sizes. */
+	if (label_cells >= ((cluster_label)1 << 31))
+		return ERR_TOOLARGE;
+#endif
+
+	c->black_histogram = (cluster_count*)calloc(labels, sizeof(cluster_count));
+	c->white_histogram = (cluster_count*)calloc(labels, sizeof(cluster_count));
+	c->djs = (cluster_label*)calloc(label_cells, sizeof(cluster_label));
+	c->map = (cluster_color*)calloc(color_cells, sizeof(cluster_color));
+#ifndef DJS_BY_SIZE
+	/* With DJS_BY_SIZE, the roots know the sizes of their clusters. */
+	c->black_roots = (cluster_label*)calloc(labels, sizeof(cluster_label));
+	c->white_roots = (cluster_label*)calloc(labels, sizeof(cluster_label));
+	c->root_list = (cluster_label*)malloc((size_t)label_cells * sizeof(cluster_label));
+	if (!c->white_roots || !c->black_roots || !c->root_list) {
+		free(c->map);
+		c->map = NULL;
+	}
+#endif
+	c->span_mark = (cluster_label*)calloc(label_cells, sizeof(cluster_label));
+#ifdef CLUSTER_BITPACK
+	/* Two rows of words with a zero word at both ends, four mask rows,
+	   and four rows of diagonal connection bits. */
+	c->bits = (uint64_t*)calloc(10 * (((size_t)label_cols + 63) / 64) + 4, sizeof(uint64_t));
+	if (!c->bits) {
+		free(c->map);
+		c->map = NULL;
+	}
+#endif
+	if (!c->map || !c->djs ||
+		!c->white_histogram || !c->black_histogram ||
+		!c->span_mark) {
+		free(c->bits);
+		c->bits = NULL;
+		free(c->root_list);
+		c->root_list = NULL;
+		free(c->span_mark);
+		c->span_mark = NULL;
+		free(c->map);
+		free(c->djs);
+		free(c->white_roots);
+		free(c->black_roots);
+		free(c->white_histogram);
+		free(c->black_histogram);
+		return ERR_NOMEM;
+	}
+
+	c->rows = rows;
+	c->cols = cols;
+
+	c->p_black = probability_limit(p_black);
+	c->d_white = probability_limit(d_white);
+	c->d_black = probability_limit(d_black);
+
+	/* Initialize the color map to NONE. */
+	{
+		cluster_color        *ptr = c->map;
+		cluster_color *const  end = c->map + color_cells;
+		while (ptr < end)
+			*(ptr++) = CLUSTER_NONE;
+	}
+
+	/* calloc() initialized the other arrays to zeros already. */
+	return 0;
+}
+
+/* Set the boundary conditions of an initialized cluster. */
+STATIC_INLINE int set_cluster_boundary(cluster *c, const int boundary)
+{
+	if (!c || !c->map)
+		return ERR_INVALID;
+
+	if (boundary == CLUSTER_BOUNDARY_OPEN) {
+		free(c->wrap);
+		free(c->seam);
+		c->wrap = NULL;
+		c->seam = NULL;
+		c->boundary = boundary;
+		return 0;
+	}
+
+	if (boundary != CLUSTER_BOUNDARY_PERIODIC)
+		return ERR_INVALID;
+
+	/* The displacements must fit in 32 bits. */
+	if ((uint64_t)c->rows * (uint64_t)c->cols >= ((uint64_t)1 << 31))
+		return ERR_TOOLARGE;
+
+	if (!c->wrap || !c->seam) {
+		free(c->wrap);
+		free(c->seam);
+		c->wrap = (cluster_wrap*)malloc((size_t)c->rows * c->cols * sizeof(cluster_wrap));
+		c->seam = (cluster_label*)malloc(6 * ((size_t)c->rows + c->cols) * sizeof(cluster_label));
+		if (!c->wrap || !c->seam) {
+			free(c->wrap);
+			free(c->seam);
+			c->wrap = NULL;
+			c->seam = NULL;
+			return ERR_NOMEM;
+		}
+	}
+
+	c->boundary = boundary;
+	return 0;
+}
+
+/* Reset the statistics and probabilities of an initialized cluster,
+   keeping the allocated arrays and the generator state. */
+STATIC_INLINE int reset_cluster(cluster *c, const double p_black,
+	const double d_white, const double d_black)
+{
+	size_t  labels;
+
+	if (!c || !c->map)
+		return ERR_INVALID;
+
+	labels = (size_t)c->rows * (size_t)c->cols + 2;
+
+	c->iterations = 0;
+	c->white_spans = 0;
+	c->black_spans = 0;
+	c->white_euler = 0;
+	c->black_euler = 0;
+	c->white_euler2 = 0.0;
+	c->black_euler2 = 0.0;
+	c->p_black = probability_limit(p_black);
+	c->d_white = probability_limit(d_white);
+	c->d_black = probability_limit(d_black);
+
+	if (c->white_histogram)
+		memset(c->white_histogram, 0, labels * sizeof(cluster_count));
+	if (c->black_histogram)
+		memset(c->black_histogram, 0, labels * sizeof(cluster_count));
+
+#ifdef CLUSTER_PROFILE
+	memset(&(c->profile), 0, sizeof c->profile);
+#endif
+
+	return 0;
+}
+
+/* Add the statistics collected in cluster 'from' to cluster 'to'.
+   Both must describe matrices of the same size. */
+STATIC_INLINE int merge_cluster(cluster *const to, const cluster *const from)
+{
+	size_t  i;
+
+	if (!to || !from)
+		return ERR_INVALID;
+
+	if (to->rows != from->rows || to->cols != from->cols)
+		return ERR_INVALID;
+
+	if (to->white_histogram && from->white_histogram) {
+		i = (size_t)to->rows * (size_t)to->cols + 2;
+		while (i-->0)
+			to->white_histogram[i] += from->white_histogram[i];
+	}
+	if (to->black_histogram && from->black_histogram) {
+		i = (size_t)to->rows * (size_t)to->cols + 2;
+		while (i-->0)
+			to->black_histogram[i] += from->black_histogram[i];
+	}
+
+	to->iterations += from->iterations;
+	to->white_spans += from->white_spans;
+	to->black_spans += from->black_spans;
+	to->white_euler += from->white_euler;
+	to->black_euler += from->black_euler;
+	to->white_euler2 += from->white_euler2;
+	to->black_euler2 += from->black_euler2;
+
+#ifdef CLUSTER_PROFILE
+	for (i = 0; i < CLUSTER_PHASES; i++) {
+		to->profile.cycles[i] += from->profile.cycles[i];
+		to->profile.bytes[i] += from->profile.bytes[i];
+		to->profile.walks[i] += from->profile.walks[i];
+		to->profile.steps[i] += from->profile.steps[i];
+	}
+	for (i = 0; i < 16; i++)
+		to->profile.joins[i] += from->profile.joins[i];
+	if (to->profile.longest < from->profile.longest)
+		to->profile.longest = from->profile.longest;
+#endif
+
+	return 0;
+}
+
+/* Disjoint set operations.
+
+   By default, the smallest label in each subset is its root, and every
+   join compresses the paths it walked. Define DJS_BY_SIZE at compile time
+   to instead keep each root as DJS_ROOT | size, link the smaller subset
+   under the larger one, and halve paths as they are walked. Then the size
+   of each cluster is known at its root, and no root counting is needed. */
+
+#ifdef DJS_BY_SIZE
+
+#define  DJS_ROOT  ((cluster_label)1 << 31)
+
+/* Disjoint set: create a single-element subset. */
+STATIC_INLINE void  djs_init(cluster_label *const  djs, const cluster_label  label)
+{
+	djs[label] = DJS_ROOT | 1;
+}
+
+/* Disjoint set: true if label is a root. */
+STATIC_INLINE int  djs_is_root(const cluster_label *const  djs, const cluster_label  label)
+{
+	return !!(djs[label] & DJS_ROOT);
+}
+
+/* Disjoint set: size of the subset of a root. */
+STATIC_INLINE cluster_label  djs_size(const cluster_label *const  djs, const cluster_label  root)
+{
+	return djs[root] & ~DJS_ROOT;
+}
+
+/* Disjoint set: find root. */
+STATIC_INLINE cluster_label  djs_root(const cluster_label *const  djs, cluster_label  from)
+{
+	while (!(djs[from] & DJS_ROOT)) {
+		DJS_PROFILE_STEP();
+		from = djs[from];
+	}
+	DJS_PROFILE_WALK();
+	return from;
+}
+
+/* Disjoint set: path compression. */
+STATIC_INLINE void  djs_path(cluster_label *const  djs, cluster_label  from, const cluster_label  root)
+{
+	while (from != root) {
+		const cluster_label  temp = djs[from];
+		djs[from] = root;
+		from = temp;
+	}
+}
+
+/* Disjoint set: Flatten. Returns the root, halving the path to it. */
+STATIC_INLINE cluster_label  djs_flatten(cluster_label *const  djs, cluster_label  from)
+{
+	while (!(djs[from] & DJS_ROOT)) {
+		const cluster_label  parent = djs[from];
+		DJS_PROFILE_STEP();
+		if (djs[parent] & DJS_ROOT) {
+			DJS_PROFILE_WALK();
+			return parent;
+		}
+		djs[from] = djs[parent];
+		from = djs[parent];
+	}
+	DJS_PROFILE_WALK();
+	return from;
+}
+
+/* Disjoint set: Link two roots, the smaller subset under the larger one.
+   Returns the new root. */
+STATIC_INLINE cluster_label  djs_link(cluster_label *const  djs,
+	cluster_label  root1, cluster_label  root2)
+{
+	if (root1 != root2) {
+		if ((djs[root1] & ~DJS_ROOT) < (djs[root2] & ~DJS_ROOT)) {
+			const cluster_label  temp = root1;
+			root1 = root2;
+			root2 = temp;
+		}
+		djs[root1] += djs[root2] & ~DJS_ROOT;
+		djs[root2] = root1;
+	}
+	return root1;
+}
+
+/* Disjoint set: Join two subsets. */
+STATIC_INLINE void  djs_join2(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2)
+{
+	djs_link(djs, djs_flatten(djs, from1), djs_flatten(djs, from2));
+}
+
+/* Disjoint set: Join three subsets. */
+STATIC_INLINE void  djs_join3(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2,
+	cluster_label  from3)
+{
+	cluster_label  root = djs_flatten(djs, from1);
+
+	root = djs_link(djs, root, djs_flatten(djs, from2));
+	djs_link(djs, root, djs_flatten(djs, from3));
+}
+
+/* Disjoint set: Join four subsets. */
+STATIC_INLINE void  djs_join4(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2,
+	cluster_label  from3, cluster_label  from4)
+{
+	cluster_label  root = djs_flatten(djs, from1);
+
+	root = djs_link(djs, root, djs_flatten(djs, from2));
+	root = djs_link(djs, root, djs_flatten(djs, from3));
+	djs_link(djs, root, djs_flatten(djs, from4));
+}
+
+/* Disjoint set: Join five subsets. */
+STATIC_INLINE void  djs_join5(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2,
+	cluster_label  from3, cluster_label  from4,
+	cluster_label  from5)
+{
+	cluster_label  root = djs_flatten(djs, from1);
+
+	root = djs_link(djs, root, djs_flatten(djs, from2));
+	root = djs_link(djs, root, djs_flatten(djs, from3));
+	root = djs_link(djs, root, djs_flatten(djs, from4));
+	djs_link(djs, root, djs_flatten(djs, from5));
+}
+
+#else /* !DJS_BY_SIZE */
+
+/* Disjoint set: create a single-element subset. */
+STATIC_INLINE void  djs_init(cluster_label *const  djs, const cluster_label  label)
+{
+	djs[label] = label;
+}
+
+/* Disjoint set: true if label is a root. */
+STATIC_INLINE int  djs_is_root(const cluster_label *const  djs, const cluster_label  label)
+{
+	return djs[label] == label;
+}
+
+/* Disjoint set: find root. */
+STATIC_INLINE cluster_label  djs_root(const cluster_label *const  djs, cluster_label  from)
+{
+	while (from != djs[from]) {
+		DJS_PROFILE_STEP();
+		from = djs[from];
+	}
+	DJS_PROFILE_WALK();
+	return from;
+}
+
+/* Disjoint set: path compression. */
+STATIC_INLINE void  djs_path(cluster_label *const  djs, cluster_label  from, const cluster_label  root)
+{
+	while (from != root) {
+		const cluster_label  temp = djs[from];
+		djs[from] = root;
+		from = temp;
+	}
+}
+
+/* Disjoint set: Flatten. Returns the root, and flattens the path to it. */
+STATIC_INLINE cluster_label  djs_flatten(cluster_label *const  djs, cluster_label  from)
+{
+	const cluster_label  root = djs_root(djs, from);
+	djs_path(djs, from, root);
+	return root;
+}
+
+/* Disjoint set: Link two roots, the smaller label becoming the root.
+   Returns the new root. */
+STATIC_INLINE cluster_label  djs_link(cluster_label *const  djs,
+	const cluster_label  root1, const cluster_label  root2)
+{
+	if (root1 < root2) {
+		djs[root2] = root1;
+		return root1;
+	} else {
+		djs[root1] = root2;
+		return root2;
+	}
+}
+
+/* Disjoint set: Join two subsets. */
+STATIC_INLINE void  djs_join2(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2)
+{
+	cluster_label  root, temp;
+
+	root = djs_root(djs, from1);
+
+	temp = djs_root(djs, from2);
+	if (root > temp)
+		temp = root;
+
+	djs_path(djs, from1, root);
+	djs_path(djs, from2, root);
+}
+
+/* Disjoint set: Join three subsets. */
+STATIC_INLINE void  djs_join3(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2,
+	cluster_label  from3)
+{
+	cluster_label  root, temp;
+
+	root = djs_root(djs, from1);
+
+	temp = djs_root(djs, from2);
+	if (root > temp)
+		root = temp;
+
+	temp = djs_root(djs, from3);
+	if (root > temp)
+		root = temp;
+
+	djs_path(djs, from1, root);
+	djs_path(djs, from2, root);
+	djs_path(djs, from3, root);
+}
+
+/* Disjoint set: Join four subsets. */
+STATIC_INLINE void  djs_join4(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2,
+	cluster_label  from3, cluster_label  from4)
+{
+	cluster_label  root, temp;
+
+	root = djs_root(djs, from1);
+
+	temp = djs_root(djs, from2);
+	if (root > temp)
+		root = temp;
+
+	temp = djs_root(djs, from3);
+	if (root > temp)
+		root = temp;
+
+	temp = djs_root(djs, from4);
+	if (root > temp)
+		root = temp;
+
+	djs_path(djs, from1, root);
+	djs_path(djs, from2, root);
+	djs_path(djs, from3, root);
+	djs_path(djs, from4, root);
+}
+
+/* Disjoint set: Join five subsets. */
+STATIC_INLINE void  djs_join5(cluster_label *const  djs,
+	cluster_label  from1, cluster_label  from2,
+	cluster_label  from3, cluster_label  from4,
+	cluster_label  from5)
+{
+	cluster_label  root, temp;
+
+	root = djs_root(djs, from1);
+
+	temp = djs_root(djs, from2);
+	if (root > temp)
+		root = temp;
+
+	temp = djs_root(djs, from3);
+	if (root > temp)
+		root = temp;
+
+	temp = djs_root(djs, from4);
+	if (root > temp)
+		root = temp;
+
+	temp = djs_root(djs, from5);
+	if (root > temp)
+		root = temp;
+
+	djs_path(djs, from1, root);
+	djs_path(djs, from2, root);
+	djs_path(djs, from3, root);
+	djs_path(djs, from4, root);
+	djs_path(djs, from5, root);
+}
+
+#endif /* DJS_BY_SIZE */
+
+/* Join 'label' with its left (bit 0), up (bit 1), up-left (bit 2), and
+   up-right (bit 3) neighbours, as selected by 'joins'. */
+STATIC_INLINE void  djs_joins(cluster_label *const  djs, const cluster_label  label,
+	const cluster_label  cols, const unsigned int  joins)
+{
+	switch (joins) {
+	case 1: /* Left */
+		djs_join2(djs, label, label - 1);
+		break;
+	case 2: /* Up */
+		djs_join2(djs, label, label - cols);
+		break;
+	case 3: /* Left and up */
+		djs_join3(djs, label, label - 1, label - cols);
+		break;
+	case 4: /* Up-left */
+		djs_join2(djs, label, label - cols - 1);
+		break;
+	case 5: /* Left and up-left */
+		djs_join3(djs, label, label - 1, label - cols - 1);
+		break;
+	case 6: /* Up and up-left */
+		djs_join3(djs, label, label - cols, label - cols - 1);
+		break;
+	case 7: /* Left, up, and up-left */
+		djs_join4(djs, label, label - 1, label - cols, label - cols - 1);
+		break;
+	case 8: /* Up-right */
+		djs_join2(djs, label, label - cols + 1);
+		break;
+	case 9: /* Left and up-right */
+		djs_join3(djs, label, label - 1, label - cols + 1);
+		break;
+	case 10: /* Up and up-right */
+		djs_join3(djs, label, label - cols, label - cols + 1);
+		break;
+	case 11: /* Left, up, and up-right */
+		djs_join4(djs, label, label - 1, label - cols, label - cols + 1);
+		break;
+	case 12: /* Up-left and up-right */
+		djs_join3(djs, label, label - cols - 1, label - cols + 1);
+		break;
+	case 13: /* Left, up-left, and up-right */
+		djs_join4(djs, label, label - 1, label - cols - 1, label - cols + 1);
+		break;
+	case 14: /* Up, up-left, and up-right */
+		djs_join4(djs, label, label - cols, label - cols - 1, label - cols + 1);
+		break;
+	case 15: /* Left, up, up-left, and up-right */
+		djs_join5(djs, label, label - 1, label - cols, label - cols - 1, label - cols + 1);
+		break;
+	}
+}
+
+/* Euler numbers.
+
+   Each color forms a graph, with the cells as vertices and the joins as
+   edges, and the Euler number of the color is vertices - edges + faces,
+   or clusters minus holes. A face is a cycle within a 2x2 block of cells,
+   which encloses no other cells: a block of four cells of the same color
+   has one plus the number of diagonal joins in it, and a block of three
+   has one if the two cells on the diagonal are joined. iterate() adds one
+   for each cell, subtracts one for each join, and adds the faces of each
+   block; 'diagonals' is the number of diagonal joins in the block. */
+STATIC_INLINE void  euler_block(int64_t euler[2],
+	const cluster_color  upleft, const cluster_color  up,
+	const cluster_color  left, const cluster_color  color,
+	const int  diagonals)
+{
+	const int  n = upleft + up + left + color;
+
+	/* In a block of three, only the color of the three can have
+	   a diagonal join. */
+	if (n != 2)
+		euler[n > 2] += (n == 0 || n == 4) + diagonals;
+}
+
+/* Mark the roots of the 'count' cells along a matrix edge with 'stamp'.
+   The cells are 'step' apart in the disjoint set, starting at 'label'. */
+STATIC_INLINE void  span_mark_edge(cluster_label *const djs, cluster_label *const mark,
+	cluster_label label, const cluster_label step, cluster_label count,
+	const cluster_label stamp)
+{
+	while (count-->0) {
+		mark[djs_flatten(djs, label)] = stamp;
+		label += step;
+	}
+}
+
+/* Probe the roots of the 'count' cells along a matrix edge, as above.
+   Roots marked with 'from' are marked with 'to' instead, and the colors
+   (at the same step in 'map', starting at 'color') are flagged in 'found'.
+   Returns nonzero if any root was marked with 'from'. */
+STATIC_INLINE int  span_probe_edge(cluster_label *const djs, cluster_label *const mark,
+	cluster_label label, const cluster_label step, cluster_label count,
+	const cluster_color *color, const cluster_label color_step,
+	const cluster_label from, const cluster_label to, int found[2])
+{
+	int  any = 0;
+
+	while (count-->0) {
+		const cluster_label  root = djs_flatten(djs, label);
+		if (mark[root] == from) {
+			mark[root] = to;
+			found[*color] = 1;
+			any = 1;
+		}
+		label += step;
+		color += color_step;
+	}
+
+	return any;
+}
+
+
+/* Wrapping union-find: Find the root of 'from', and the displacement
+   from the root to 'from', compressing the path. */
+STATIC_INLINE cluster_label  wrap_find(cluster_wrap *const  wrap, const cluster_label  from,
+	int64_t *const  dx, int64_t *const  dy)
+{
+	cluster_label  root = from;
+	int64_t        x = 0, y = 0;
+
+	while (wrap[root].parent != root) {
+		x += wrap[root].dx;
+		y += wrap[root].dy;
+		root = wrap[root].parent;
+	}
+
+	*dx = x;
+	*dy = y;
+
+	/* Point the path directly at the root. */
+	{
+		cluster_label  curr = from;
+		while (curr != root) {
+			const cluster_label  next = wrap[curr].parent;
+			const int32_t        cx = wrap[curr].dx;
+			const int32_t        cy = wrap[curr].dy;
+			wrap[curr].parent = root;
+			wrap[curr].dx = (int32_t)x;
+			wrap[curr].dy = (int32_t)y;
+			x -= cx;
+			y -= cy;
+			curr = next;
+		}
+	}
+
+	return root;
+}
+
+/* Join cells 'a' and 'b' across the matrix edge, where 'b' is at (dx, dy)
+   from 'a' on the plane. The roots of the open-boundary clusters, found
+   in 'djs', are joined in the wrapping union-find. If they already were in
+   the same set, but at a different displacement, the cluster wraps around.
+   Returns the wrapping directions of the joined cluster. */
+STATIC_INLINE unsigned int  wrap_join(cluster_wrap *const  wrap, cluster_label *const  djs,
+	const cluster_label  cols, const cluster_label  a, const cluster_label  b,
+	const int  dx, const int  dy)
+{
+	const cluster_label  root_a = djs_flatten(djs, a);
+	const cluster_label  root_b = djs_flatten(djs, b);
+	/* Displacement from root_a to root_b on the plane, through a and b. */
+	const int64_t        need_x = ((int64_t)(a % cols) - (int64_t)(root_a % cols)) + dx
+	                            - ((int64_t)(b % cols) - (int64_t)(root_b % cols));
+	const int64_t        need_y = ((int64_t)(a / cols) - (int64_t)(root_a / cols)) + dy
+	                            - ((int64_t)(b / cols) - (int64_t)(root_b / cols));
+	int64_t              ax, ay, bx, by;
+	const cluster_label  set_a = wrap_find(wrap, root_a, &ax, &ay);
+	const cluster_label  set_b = wrap_find(wrap, root_b, &bx, &by);
+
+	if (set_a == set_b) {
+		if (bx - ax != need_x)
+			wrap[set_a].wraps |= CLUSTER_WRAPS_X;
+		if (by - ay != need_y)
+			wrap[set_a].wraps |= CLUSTER_WRAPS_Y;
+	} else {
+		wrap[set_b].parent = set_a;
+		wrap[set_b].dx = (int32_t)(ax + need_x - bx);
+		wrap[set_b].dy = (int32_t)(ay + need_y - by);
+		wrap[set_a].wraps |= wrap[set_b].wraps;
+	}
+
+	return wrap[set_a].wraps;
+}
+
+/* Periodic boundaries: after the open-boundary labelling, join the cells
+   on opposite edges of the matrix (left and up, including the diagonals
+   at probability d_color[] as in iterate()), and find which colors have
+   a cluster wrapping around according to the spanning criterion.
+   The joins and blocks across the edges are added to euler[].
+   If 'key' is not NULL, the counter-based generator is used with the
+   keys of the matrix; the first row and column have no diagonal joins
+   with open boundaries, so their numbers are not used otherwise. */
+static void  cluster_seams(cluster *const cl, const cluster_color *const map,
+	const cluster_label map_stride, const uint64_t d_color[2], const uint64_t *const key,
+	int spanned[2], int64_t euler[2])
+{
+	prng          *const  rng = &(cl->rng);
+	cluster_label *const  djs = cl->djs;
+	cluster_wrap  *const  wrap = cl->wrap;
+	cluster_label  const  rows = cl->rows;
+	cluster_label  const  cols = cl->cols;
+	cluster_label  const  last = (rows - 1) * cols;
+	cluster_label        *seam = cl->seam;
+	unsigned int          want;
+	cluster_label         r, c;
+	int                   upleft, upright = 0, first_upleft = 0;
+
+	switch (cl->span_mode) {
+	case CLUSTER_SPAN_HORIZONTAL: want = CLUSTER_WRAPS_X; break;
+	case CLUSTER_SPAN_VERTICAL:   want = CLUSTER_WRAPS_Y; break;
+	case CLUSTER_SPAN_BOTH:       want = CLUSTER_WRAPS_X | CLUSTER_WRAPS_Y; break;
+	default:                      want = 0; break;
+	}
+
+#define  CELL_COLOR_AT(label)  (map[((label) / cols) * map_stride + (label) % cols])
+#define  DRAW(purpose, label, limit) \
+	((key) ? counter_probability(counter_row(key[purpose], (label) / cols), (label) % cols, (limit)) \
+	       : probability(rng, (limit)))
+#define  SEAM_JOIN(a, b, dx, dy) \
+	do { \
+		const unsigned int  wraps = wrap_join(wrap, djs, cols, (a), (b), (dx), (dy)); \
+		if ((want) ? ((wraps & want) == want) : (wraps != 0)) \
+			spanned[CELL_COLOR_AT(a)] = 1; \
+		euler[CELL_COLOR_AT(a)]--; \
+		*(seam++) = (a); \
+		*(seam++) = (b); \
+	} while (0)
+
+	/* Each open-boundary cluster on an edge starts as a set of its own. */
+	for (r = 0; r < rows; r++) {
+		const cluster_label  first = djs_flatten(djs, r * cols);
+		const cluster_label  final = djs_flatten(djs, r * cols + cols - 1);
+		wrap[first].parent = first;
+		wrap[first].dx = wrap[first].dy = 0;
+		wrap[first].wraps = 0;
+		wrap[final].parent = final;
+		wrap[final].dx = wrap[final].dy = 0;
+		wrap[final].wraps = 0;
+	}
+	for (c = 0; c < cols; c++) {
+		const cluster_label  first = djs_flatten(djs, c);
+		const cluster_label  final = djs_flatten(djs, last + c);
+		wrap[first].parent = first;
+		wrap[first].dx = wrap[first].dy = 0;
+		wrap[first].wraps = 0;
+		wrap[final].parent = final;
+		wrap[final].dx = wrap[final].dy = 0;
+		wrap[final].wraps = 0;
+	}
+
+	/* Left and up-left neighbours of the first column, and up-right
+	   neighbours of the last column, on the previous rows. */
+	for (r = 0; r < rows; r++) {
+		const cluster_label   first = r * cols;
+		const cluster_label   final = first + cols - 1;
+		const cluster_color   color = CELL_COLOR_AT(first);
+
+		if (CELL_COLOR_AT(final) == color)
+			SEAM_JOIN(first, final, -1, 0);
+		if (r > 0) {
+			upleft = (CELL_COLOR_AT(final - cols) == color && DRAW(CLUSTER_DRAW_UPLEFT, first, d_color[color]));
+			if (upleft)
+				SEAM_JOIN(first, final - cols, -1, -1);
+			upright = (CELL_COLOR_AT(first - cols) == CELL_COLOR_AT(final) &&
+				DRAW(CLUSTER_DRAW_UPRIGHT, final, d_color[CELL_COLOR_AT(final)]));
+			if (upright)
+				SEAM_JOIN(final, first - cols, +1, -1);
+			euler_block(euler, CELL_COLOR_AT(final - cols), CELL_COLOR_AT(first - cols),
+				CELL_COLOR_AT(final), color, upleft + upright);
+		}
+	}
+
+	/* Up, up-left and up-right neighbours of the first row, on the last row. */
+	for (c = 0; c < cols; c++) {
+		const cluster_color   color = CELL_COLOR_AT(c);
+		const cluster_label   left = (c > 0) ? c - 1 : cols - 1;
+		const cluster_label   right = (c < cols - 1) ? c + 1 : 0;
+
+		if (CELL_COLOR_AT(last + c) == color)
+			SEAM_JOIN(c, last + c, 0, -1);
+		upleft = (CELL_COLOR_AT(last + left) == color && DRAW(CLUSTER_DRAW_UPLEFT, c, d_color[color]));
+		if (upleft)
+			SEAM_JOIN(c, last + left, -1, -1);
+
+		/* The block up-left of the first cell needs the up-right join
+		   of the last cell, so it is added after the loop. */
+		if (c > 0)
+			euler_block(euler, CELL_COLOR_AT(last + left), CELL_COLOR_AT(last + c),
+				CELL_COLOR_AT(left), color, upleft + upright);
+		else
+			first_upleft = upleft;
+
+		upright = (CELL_COLOR_AT(last + right) == color && DRAW(CLUSTER_DRAW_UPRIGHT, c, d_color[color]));
+		if (upright)
+			SEAM_JOIN(c, last + right, +1, -1);
+	}
+	euler_block(euler, CELL_COLOR_AT(last + cols - 1), CELL_COLOR_AT(last),
+		CELL_COLOR_AT(cols - 1), CELL_COLOR_AT(0), first_upleft + upright);
+
+#undef  SEAM_JOIN
+#undef  DRAW
+#undef  CELL_COLOR_AT
+
+	/* Join the same pairs in the disjoint set. */
+	{
+		const cluster_label  *pair = cl->seam;
+		while (pair < seam) {
+			djs_join2(djs, pair[0], pair[1]);
+			pair += 2;
+		}
+	}
+}
+
+
+#ifdef CLUSTER_PROFILE
+
+/* Read the time stamp counter, or the monotonic clock in nanoseconds
+   on architectures without one. */
+STATIC_INLINE uint64_t  cluster_profile_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec  now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * UINT64_C(1000000000) + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/* End a phase of iterate(), adding the ticks since 'ticks' and the
+   root walks of this thread to the profile of the cluster. */
+STATIC_INLINE void  cluster_profile_phase(cluster *const cl, const int phase,
+	uint64_t *const ticks)
+{
+	const uint64_t  now = cluster_profile_ticks();
+
+	cl->profile.cycles[phase] += now - *ticks;
+	cl->profile.walks[phase] += djs_profile.walks;
+	cl->profile.steps[phase] += djs_profile.steps;
+	cl->profile.bytes[phase] += djs_profile.steps * sizeof(cluster_label);
+	if (cl->profile.longest < djs_profile.longest)
+		cl->profile.longest = djs_profile.longest;
+
+	djs_profile.walks = 0;
+	djs_profile.steps = 0;
+	djs_profile.longest = 0;
+	*ticks = now;
+}
+
+/* Print the profile of a cluster as comment lines. */
+STATIC_INLINE void print_cluster_profile(FILE *const out, const cluster *const cl)
+{
+	static const char *const  phase_name[CLUSTER_PHASES] = { "label", "roots", "histogram", "spanning" };
+	const double              sites = (double)cl->iterations * (double)cl->rows * (double)cl->cols;
+	int                       i;
+
+	fprintf(out, "# profile: phase ticks ticks_per_site bytes_per_site root_walks steps_per_walk\n");
+	for (i = 0; i < CLUSTER_PHASES; i++)
+		fprintf(out, "# profile: %s %" PRIu64 " %.3f %.3f %" PRIu64 " %.3f\n",
+			phase_name[i], cl->profile.cycles[i],
+			(sites > 0.0) ? (double)cl->profile.cycles[i] / sites : 0.0,
+			(sites > 0.0) ? (double)cl->profile.bytes[i] / sites : 0.0,
+			cl->profile.walks[i],
+			(cl->profile.walks[i] > 0) ? (double)cl->profile.steps[i] / (double)cl->profile.walks[i] : 0.0);
+	fprintf(out, "# profile: longest root walk %" PRIu64 " steps\n", cl->profile.longest);
+	fprintf(out, "# profile: cells per joins case (1 left, 2 up, 4 up-left, 8 up-right):");
+	for (i = 0; i < 16; i++)
+		fprintf(out, " %d:%" PRIu64, i, cl->profile.joins[i]);
+	fprintf(out, "\n");
+}
+
+#define  CLUSTER_PROFILE_PHASE(phase)       cluster_profile_phase(cl, (phase), &profile_ticks)
+#define  CLUSTER_PROFILE_BYTES(phase, n)    (cl->profile.bytes[(phase)] += (uint64_t)(n))
+#define  CLUSTER_PROFILE_JOINS(which, n)    (cl->profile.joins[(which)] += (uint64_t)(n))
+
+#else  /* !CLUSTER_PROFILE */
+
+#define  CLUSTER_PROFILE_PHASE(phase)       ((void)0)
+#define  CLUSTER_PROFILE_BYTES(phase, n)    ((void)0)
+#define  CLUSTER_PROFILE_JOINS(which, n)    ((void)0)
+
+#endif /* CLUSTER_PROFILE */
+
+#ifdef CLUSTER_BITPACK
+
+/* Index of the lowest set bit of a nonzero word. */
+STATIC_INLINE int  bitpack_lowest(const uint64_t  word)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	uint64_t  w = word;
+	int       i = 0;
+	while (!(w & 1)) {
+		w >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+/* Number of set bits in a word. */
+STATIC_INLINE int  bitpack_count(const uint64_t  word)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	uint64_t  w = word;
+	int       n = 0;
+	while (w) {
+		w &= w - 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Compute the neighbour equality masks of a bit-packed row 'curr' of 'words'
+   words, given the previous row 'prev'. Bit i of eq_left is set if cell i
+   has the same color as the cell to its left, and similarly for the others.
+   Both rows must have a readable word before and after them. */
+STATIC_INLINE void  bitpack_masks(const uint64_t *const  curr, const uint64_t *const  prev,
+	const size_t  words,
+	uint64_t *const  eq_left, uint64_t *const  eq_up,
+	uint64_t *const  eq_upleft, uint64_t *const  eq_upright)
+{
+	size_t  w = 0;
+
+#ifdef __AVX2__
+	const __m256i  ones = _mm256_set1_epi64x(-1);
+
+	for (; w + 4 <= words; w += 4) {
+		const __m256i  x  = _mm256_loadu_si256((const __m256i *)(curr + w));
+		const __m256i  xl = _mm256_loadu_si256((const __m256i *)(curr + w - 1));
+		const __m256i  p  = _mm256_loadu_si256((const __m256i *)(prev + w));
+		const __m256i  pl = _mm256_loadu_si256((const __m256i *)(prev + w - 1));
+		const __m256i  pr = _mm256_loadu_si256((const __m256i *)(prev + w + 1));
+
+		const __m256i  left    = _mm256_or_si256(_mm256_slli_epi64(x, 1), _mm256_srli_epi64(xl, 63));
+		const __m256i  upleft  = _mm256_or_si256(_mm256_slli_epi64(p, 1), _mm256_srli_epi64(pl, 63));
+		const __m256i  upright = _mm256_or_si256(_mm256_srli_epi64(p, 1), _mm256_slli_epi64(pr, 63));
+
+		_mm256_storeu_si256((__m256i *)(eq_left + w),    _mm256_xor_si256(_mm256_xor_si256(x, left), ones));
+		_mm256_storeu_si256((__m256i *)(eq_up + w),      _mm256_xor_si256(_mm256_xor_si256(x, p), ones));
+		_mm256_storeu_si256((__m256i *)(eq_upleft + w),  _mm256_xor_si256(_mm256_xor_si256(x, upleft), ones));
+		_mm256_storeu_si256((__m256i *)(eq_upright + w), _mm256_xor_si256(_mm256_xor_si256(x, upright), ones));
+	}
+#endif
+
+	for (; w < words; w++) {
+		const uint64_t  x = curr[w];
+		const uint64_t  p = prev[w];
+
+		eq_left[w]    = ~(x ^ ((x << 1) | (curr[w - 1] >> 63)));
+		eq_up[w]      = ~(x ^ p);
+		eq_upleft[w]  = ~(x ^ ((p << 1) | (prev[w - 1] >> 63)));
+		eq_upright[w] = ~(x ^ ((p >> 1) | (prev[w + 1] << 63)));
+	}
+}
+
+#endif /* CLUSTER_BITPACK */
+
+/* Label rows first to end-1 of the byte map, joining each cell to its
+   left and up neighbours as they are generated. The row above 'first'
+   is treated as empty, so that only cells of these rows are accessed.
+   If 'key' is not NULL, the counter-based generator is used with the
+   keys of the matrix. The Euler number terms of the cells, and of the
+   blocks below 'first', are added to euler[]. */
+STATIC_INLINE void  label_rows(cluster *const cl, const cluster_label first, const cluster_label end,
+	const uint64_t *const key, int64_t euler[2])
+{
+	prng          *const  rng = &(cl->rng);
+	uint64_t       const  p_black = cl->p_black;
+	uint64_t              d_color[2];
+
+	cluster_color *const  map = cl->map + cl->cols + 2;
+	cluster_label  const  map_stride = cl->cols + 1;
+
+	cluster_label *const  djs = cl->djs;
+	cluster_label  const  cols = cl->cols;
+
+	int                   r, c;
+
+	d_color[CLUSTER_WHITE] = cl->d_white;
+	d_color[CLUSTER_BLACK] = cl->d_black;
+
+	for (r = first; r < end; r++) {
+		cluster_label  const  curr_i = r * cols;
+		cluster_color *const  curr_row = map + r * map_stride;
+		cluster_color *const  prev_row = (r > first) ? curr_row - map_stride : map - map_stride;
+		unsigned int          left_joins = 0;
+		uint64_t              row_key[CLUSTER_DRAWS];
+
+		if (key) {
+			row_key[CLUSTER_DRAW_COLOR] = counter_row(key[CLUSTER_DRAW_COLOR], r);
+			row_key[CLUSTER_DRAW_UPLEFT] = counter_row(key[CLUSTER_DRAW_UPLEFT], r);
+			row_key[CLUSTER_DRAW_UPRIGHT] = counter_row(key[CLUSTER_DRAW_UPRIGHT], r);
+		}
+
+		for (c = 0; c < cols; c++) {
+			cluster_color  color = (key) ? counter_probability(row_key[CLUSTER_DRAW_COLOR], c, p_black)
+			                             : probability(rng, p_black);
+			cluster_label  label = curr_i + c;
+			uint64_t       diag = d_color[color];
+			unsigned int   joins = 0;
+
+			/* Assign the label and color of the current cell, */
+			djs_init(djs, label);
+			curr_row[c] = color;
+
+			/* Because we join left, up-left, up, and up-right, and
+			all those have been assigned to already, we can do
+			the necessary joins right now. */
+
+			/* Join left? */
+			joins |= (curr_row[c - 1] == color) << 0;
+
+			/* Join up? */
+			joins |= (prev_row[c] == color) << 1;
+
+			/* Join up left? */
+			joins |= (prev_row[c - 1] == color &&
+				((key) ? counter_probability(row_key[CLUSTER_DRAW_UPLEFT], c, diag)
+				       : probability(rng, diag))) << 2;
+
+			/* Join up right? */
+			joins |= (prev_row[c + 1] == color &&
+				((key) ? counter_probability(row_key[CLUSTER_DRAW_UPRIGHT], c, diag)
+				       : probability(rng, diag))) << 3;
+
+			/* Do the corresponding joins. */
+			CLUSTER_PROFILE_JOINS(joins, 1);
+			djs_joins(djs, label, cols, joins);
+
+			/* Euler number: the cell, its joins, and the block
+			   up-left of it, with the up-right join of the cell
+			   to the left. */
+			euler[color] += 1 - (int)((joins & 1) + ((joins >> 1) & 1) + ((joins >> 2) & 1) + (joins >> 3));
+			if (r > first && c > 0)
+				euler_block(euler, prev_row[c - 1], prev_row[c], curr_row[c - 1], color,
+					(int)(((joins >> 2) & 1) + (left_joins >> 3)));
+			left_joins = joins;
+		}
+	}
+}
+
+/* Check for spanning clusters, after the matrix has been labelled.
+   The roots along one edge are marked with a new stamp, and probed along
+   the opposite edge; roots of both colors are handled in the same pass,
+   as each root has one color. The marks are never cleared, only when the
+   stamps wrap around. On a periodic matrix, the colors with clusters that
+   wrap around are already known, and given in 'wrapped'. */
+static void  cluster_spans(cluster *const cl, const cluster_color *const map,
+	const cluster_label map_stride, const int *const wrapped)
+{
+	cluster_label *const  djs = cl->djs;
+	cluster_label  const  rows = cl->rows;
+	cluster_label  const  cols = cl->cols;
+
+	if (wrapped) {
+		cl->white_spans += wrapped[CLUSTER_WHITE];
+		cl->black_spans += wrapped[CLUSTER_BLACK];
+	} else
+	if (cl->span_mark) {
+		cluster_label *const  mark = cl->span_mark;
+		cluster_label         stamp = cl->span_stamp;
+		int                   spanned[2] = { 0, 0 };
+		int                   unused[2];
+
+		if (stamp > (cluster_label)(~(cluster_label)0) - 4) {
+			memset(mark, 0, (size_t)rows * cols * sizeof(cluster_label));
+			stamp = 0;
+		}
+
+		switch (cl->span_mode) {
+		case CLUSTER_SPAN_HORIZONTAL:
+			span_mark_edge(djs, mark, 0, cols, rows, stamp + 1);
+			span_probe_edge(djs, mark, cols - 1, cols, rows, map + cols - 1, map_stride,
+				stamp + 1, stamp + 2, spanned);
+			break;
+
+		case CLUSTER_SPAN_VERTICAL:
+			span_mark_edge(djs, mark, 0, 1, cols, stamp + 1);
+			span_probe_edge(djs, mark, (rows - 1)*cols, 1, cols, map + (rows - 1)*map_stride, 1,
+				stamp + 1, stamp + 2, spanned);
+			break;
+
+		case CLUSTER_SPAN_BOTH:
+			/* Left and right, then top, then bottom; only roots that
+			   were found on all the previous edges are kept marked. */
+			span_mark_edge(djs, mark, 0, cols, rows, stamp + 1);
+			if (span_probe_edge(djs, mark, cols - 1, cols, rows, map + cols - 1, map_stride,
+					stamp + 1, stamp + 2, unused) &&
+				span_probe_edge(djs, mark, 0, 1, cols, map, 1,
+					stamp + 2, stamp + 3, unused))
+				span_probe_edge(djs, mark, (rows - 1)*cols, 1, cols, map + (rows - 1)*map_stride, 1,
+					stamp + 3, stamp + 4, spanned);
+			break;
+
+		default:
+			/* Left-right, or top-bottom if neither color spanned yet
+			   horizontally. */
+			span_mark_edge(djs, mark, 0, cols, rows, stamp + 1);
+			span_probe_edge(djs, mark, cols - 1, cols, rows, map + cols - 1, map_stride,
+				stamp + 1, stamp + 2, spanned);
+			if (!spanned[CLUSTER_WHITE] || !spanned[CLUSTER_BLACK]) {
+				span_mark_edge(djs, mark, 0, 1, cols, stamp + 3);
+				span_probe_edge(djs, mark, (rows - 1)*cols, 1, cols, map + (rows - 1)*map_stride, 1,
+					stamp + 3, stamp + 4, spanned);
+			}
+			break;
+		}
+
+		cl->span_stamp = stamp + 4;
+		cl->white_spans += spanned[CLUSTER_WHITE];
+		cl->black_spans += spanned[CLUSTER_BLACK];
+	}
+}
+
+STATIC_INLINE void iterate(cluster *const cl)
+{
+	uint64_t              d_color[2];
+
+	cluster_color *const  map = cl->map + cl->cols + 2;
+	cluster_label  const  map_stride = cl->cols + 1;
+
+	cluster_label *const  djs = cl->djs;
+
+#ifndef DJS_BY_SIZE
+	cluster_label        *roots[2];
+#endif
+
+	cluster_label  const  rows = cl->rows;
+	cluster_label  const  cols = cl->cols;
+
+	int                   r, c;
+
+	/* Colors with a cluster wrapping around a periodic matrix */
+	int                   wrapped[2] = { 0, 0 };
+
+	/* Euler numbers of the white and black cells */
+	int64_t               euler[2] = { 0, 0 };
+
+	/* Keys of the counter-based generator for this matrix, if used */
+	uint64_t              key[CLUSTER_DRAWS];
+	int            const  counter = (cl->rng_mode == CLUSTER_RNG_COUNTER);
+	int            const  periodic = (cl->boundary == CLUSTER_BOUNDARY_PERIODIC && cl->wrap && cl->seam);
+
+#ifdef CLUSTER_PROFILE
+	uint64_t              profile_ticks = cluster_profile_ticks();
+#endif
+
+	d_color[CLUSTER_WHITE] = cl->d_white;
+	d_color[CLUSTER_BLACK] = cl->d_black;
+#ifndef DJS_BY_SIZE
+	roots[CLUSTER_WHITE] = cl->white_roots;
+	roots[CLUSTER_BLACK] = cl->black_roots;
+#endif
+
+	if (counter)
+		for (r = 0; r < CLUSTER_DRAWS; r++)
+			key[r] = counter_key(cl->rng_seed, cl->realization, r);
+	cl->realization++;
+
+#ifdef CLUSTER_BITPACK
+	/* Colors are packed 64 cells per word. The colors and the diagonal
+	   connections of each row are generated in bulk by probability_fill(),
+	   so the generator is used differently than below, and the results
+	   differ from the byte map version for the same seed, unless the
+	   counter-based generator is used. The equality
+	   masks of each word are computed at once, and only cells with a set
+	   bit in any of them are joined; other cells start a cluster of their
+	   own.
+
+	   Only the labelling uses the packed rows. The byte map is still
+	   written for every cell, and the root counting, spanning and
+	   periodic seam passes read it, so the memory traffic of an
+	   iteration is not reduced. */
+	{
+		prng   *const         rng = &(cl->rng);
+		const uint64_t        p_black = cl->p_black;
+		const size_t          words = ((size_t)cols + 63) / 64;
+		const uint64_t        tail = (cols & 63) ? ((uint64_t)1 << (cols & 63)) - 1 : ~(uint64_t)0;
+		uint64_t *const       eq_left = cl->bits + 2 * (words + 2);
+		uint64_t *const       eq_up = eq_left + words;
+		uint64_t *const       eq_upleft = eq_up + words;
+		uint64_t *const       eq_upright = eq_upleft + words;
+		uint64_t             *diag_upleft[2], *diag_upright[2];
+
+		diag_upleft[CLUSTER_WHITE] = eq_upright + words;
+		diag_upleft[CLUSTER_BLACK] = diag_upleft[CLUSTER_WHITE] + words;
+		diag_upright[CLUSTER_WHITE] = diag_upleft[CLUSTER_BLACK] + words;
+		diag_upright[CLUSTER_BLACK] = diag_upright[CLUSTER_WHITE] + words;
+
+		for (r = 0; r < rows; r++) {
+			cluster_label  const  curr_i = r * cols;
+			cluster_color *const  curr_row = map + r * map_stride;
+			uint64_t      *const  curr_bits = cl->bits + (size_t)(r & 1) * (words + 2) + 1;
+			uint64_t      *const  prev_bits = cl->bits + (size_t)(~r & 1) * (words + 2) + 1;
+			size_t                w;
+
+			/* Generate the colors of the row. The byte map is still
+			   needed for counting the roots and checking spanning. */
+			if (counter)
+				counter_fill(counter_row(key[CLUSTER_DRAW_COLOR], r), p_black, curr_bits, cols);
+			else
+				probability_fill(rng, p_black, curr_bits, cols);
+			for (c = 0; c < cols; c++)
+				curr_row[c] = (curr_bits[c >> 6] >> (c & 63)) & 1;
+
+			bitpack_masks(curr_bits, prev_bits, words, eq_left, eq_up, eq_upleft, eq_upright);
+
+			/* The first column has no left neighbours, and the last
+			   no up-right neighbour; the first row has nothing above. */
+			eq_left[0] &= ~(uint64_t)1;
+			eq_upleft[0] &= ~(uint64_t)1;
+			eq_upright[(cols - 1) >> 6] &= ~((uint64_t)1 << ((cols - 1) & 63));
+			eq_left[words - 1] &= tail;
+			if (r > 0) {
+				/* Diagonal connections, at the probability of each
+				   cell's own color. The counter-based generator draws
+				   one number per cell and direction, like the byte map
+				   version, and compares it to both limits. */
+				if (counter) {
+					const uint64_t  upleft = counter_row(key[CLUSTER_DRAW_UPLEFT], r);
+					const uint64_t  upright = counter_row(key[CLUSTER_DRAW_UPRIGHT], r);
+					counter_fill(upleft, d_color[CLUSTER_WHITE], diag_upleft[CLUSTER_WHITE], cols);
+					counter_fill(upleft, d_color[CLUSTER_BLACK], diag_upleft[CLUSTER_BLACK], cols);
+					counter_fill(upright, d_color[CLUSTER_WHITE], diag_upright[CLUSTER_WHITE], cols);
+					counter_fill(upright, d_color[CLUSTER_BLACK], diag_upright[CLUSTER_BLACK], cols);
+				} else {
+					probability_fill(rng, d_color[CLUSTER_WHITE], diag_upleft[CLUSTER_WHITE], cols);
+					probability_fill(rng, d_color[CLUSTER_BLACK], diag_upleft[CLUSTER_BLACK], cols);
+					probability_fill(rng, d_color[CLUSTER_WHITE], diag_upright[CLUSTER_WHITE], cols);
+					probability_fill(rng, d_color[CLUSTER_BLACK], diag_upright[CLUSTER_BLACK], cols);
+				}
+				for (w = 0; w < words; w++) {
+					const uint64_t  x = curr_bits[w];
+					eq_upleft[w] &= (x & diag_upleft[CLUSTER_BLACK][w]) | (~x & diag_upleft[CLUSTER_WHITE][w]);
+					eq_upright[w] &= (x & diag_upright[CLUSTER_BLACK][w]) | (~x & diag_upright[CLUSTER_WHITE][w]);
+				}
+				eq_up[words - 1] &= tail;
+			} else {
+				memset(eq_up, 0, words * sizeof eq_up[0]);
+				memset(eq_upleft, 0, words * sizeof eq_upleft[0]);
+				memset(eq_upright, 0, words * sizeof eq_upright[0]);
+			}
+
+			for (w = 0; w < words; w++) {
+				const cluster_label  first = curr_i + (cluster_label)(w * 64);
+				const int            n = (w + 1 < words) ? 64 : (int)(cols - w * 64);
+				uint64_t             pending = eq_left[w] | eq_up[w] | eq_upleft[w] | eq_upright[w];
+				int                  i;
+
+				/* Euler number: the cells, their joins, and the blocks
+				   up-left of them; see euler_block(). */
+				{
+					const uint64_t  x = curr_bits[w];
+					const int       black = bitpack_count(x);
+
+					euler[CLUSTER_BLACK] += black
+						- bitpack_count(x & eq_left[w]) - bitpack_count(x & eq_up[w])
+						- bitpack_count(x & eq_upleft[w]) - bitpack_count(x & eq_upright[w]);
+					euler[CLUSTER_WHITE] += (n - black)
+						- bitpack_count(~x & eq_left[w]) - bitpack_count(~x & eq_up[w])
+						- bitpack_count(~x & eq_upleft[w]) - bitpack_count(~x & eq_upright[w]);
+
+					if (r > 0) {
+						const uint64_t  xl = (x << 1) | (curr_bits[w - 1] >> 63);
+						const uint64_t  p = prev_bits[w];
+						const uint64_t  pl = (p << 1) | (prev_bits[w - 1] >> 63);
+						const uint64_t  block = ((w + 1 < words) ? ~(uint64_t)0 : tail) & ((w > 0) ? ~(uint64_t)0 : ~(uint64_t)1);
+						const uint64_t  diag_ul = eq_upleft[w];
+						const uint64_t  diag_ur = (eq_upright[w] << 1) | ((w > 0) ? eq_upright[w - 1] >> 63 : 0);
+						const uint64_t  odd = x ^ xl ^ p ^ pl;
+						const uint64_t  pairs = (x & xl) | (p & pl) | ((x | xl) & (p | pl));
+						const uint64_t  all_black = x & xl & p & pl & block;
+						const uint64_t  all_white = ~(x | xl | p | pl) & block;
+						const uint64_t  most_black = all_black | (odd & pairs & block);
+						const uint64_t  most_white = all_white | (odd & ~pairs & block);
+
+						euler[CLUSTER_BLACK] += bitpack_count(all_black)
+							+ bitpack_count(most_black & diag_ul) + bitpack_count(most_black & diag_ur);
+						euler[CLUSTER_WHITE] += bitpack_count(all_white)
+							+ bitpack_count(most_white & diag_ul) + bitpack_count(most_white & diag_ur);
+					}
+				}
+
+				for (i = 0; i < n; i++)
+					djs_init(djs, first + i);
+
+#ifdef CLUSTER_PROFILE
+				{
+					uint64_t  temp = pending;
+					int       joined = 0;
+					while (temp) {
+						temp &= temp - 1;
+						joined++;
+					}
+					CLUSTER_PROFILE_JOINS(0, n - joined);
+				}
+#endif
+
+				while (pending) {
+					const int            b = bitpack_lowest(pending);
+					const unsigned int   joins = (unsigned int)(((eq_left[w] >> b) & 1)
+					                                         | (((eq_up[w] >> b) & 1) << 1)
+					                                         | (((eq_upleft[w] >> b) & 1) << 2)
+					                                         | (((eq_upright[w] >> b) & 1) << 3));
+
+					pending &= pending - 1;
+
+					CLUSTER_PROFILE_JOINS(joins, 1);
+					djs_joins(djs, first + b, cols, joins);
+				}
+			}
+		}
+	}
+#else
+	label_rows(cl, 0, rows, (counter) ? key : NULL, euler);
+#endif
+
+	/* Join the clusters across the edges of a periodic matrix. */
+	if (periodic)
+		cluster_seams(cl, map, map_stride, d_color, (counter) ? key : NULL, wrapped, euler);
+
+	cl->white_euler += euler[CLUSTER_WHITE];
+	cl->black_euler += euler[CLUSTER_BLACK];
+	cl->white_euler2 += (double)euler[CLUSTER_WHITE] * (double)euler[CLUSTER_WHITE];
+	cl->black_euler2 += (double)euler[CLUSTER_BLACK] * (double)euler[CLUSTER_BLACK];
+
+	CLUSTER_PROFILE_BYTES(CLUSTER_PHASE_LABEL, (size_t)rows * cols * (sizeof(cluster_color) + sizeof(cluster_label)));
+	CLUSTER_PROFILE_PHASE(CLUSTER_PHASE_LABEL);
+
+#ifdef DJS_BY_SIZE
+	/* Each root knows the size of its cluster; no root counting is needed. */
+	{
+		cluster_count  *histogram[2];
+
+		histogram[CLUSTER_WHITE] = cl->white_histogram;
+		histogram[CLUSTER_BLACK] = cl->black_histogram;
+
+		if (histogram[0] && histogram[1])
+			for (r = 0; r < rows; r++) {
+				const cluster_color *const  curr_row = map + r * map_stride;
+				const cluster_label         curr_i = r * cols;
+				for (c = 0; c < cols; c++)
+					if (djs_is_root(djs, curr_i + c))
+						histogram[curr_row[c]][djs_size(djs, curr_i + c)]++;
+			}
+	}
+
+	CLUSTER_PROFILE_BYTES(CLUSTER_PHASE_ROOTS, (size_t)rows * cols * (sizeof(cluster_color) + sizeof(cluster_label)));
+	CLUSTER_PROFILE_PHASE(CLUSTER_PHASE_ROOTS);
+#else
+	/* Count the occurrences of each disjoint-set root label, listing
+	each root when it is first seen. The counts are all zero here. */
+	if (roots[0] && roots[1] && cl->root_list) {
+		cluster_label *const  list_begin = cl->root_list;
+		cluster_label *const  list_end = cl->root_list + rows * cols;
+		cluster_label        *white = list_begin;
+		cluster_label        *black = list_end;
+
+		for (r = 0; r < rows; r++) {
+			const cluster_color *const  curr_row = map + r * map_stride;
+			const cluster_label         curr_i = r * cols;
+			for (c = 0; c < cols; c++) {
+				const cluster_label  root = djs_flatten(djs, curr_i + c);
+				if (curr_row[c] == CLUSTER_BLACK) {
+					if (!roots[1][root]++)
+						*(--black) = root;
+				}
+				else {
+					if (!roots[0][root]++)
+						*(white++) = root;
+				}
+			}
+		}
+
+		CLUSTER_PROFILE_BYTES(CLUSTER_PHASE_ROOTS, (size_t)rows * cols * (sizeof(cluster_color) + 2 * sizeof(cluster_label))
+			+ (size_t)((white - list_begin) + (list_end - black)) * sizeof(cluster_label));
+		CLUSTER_PROFILE_PHASE(CLUSTER_PHASE_ROOTS);
+
+		/* Collect the statistics from the listed roots only,
+		clearing their counts for the next iteration. */
+		CLUSTER_PROFILE_BYTES(CLUSTER_PHASE_HISTOGRAM, (size_t)((white - list_begin) + (list_end - black))
+			* (2 * sizeof(cluster_label) + sizeof(cluster_count)));
+		while (white > list_begin) {
+			const cluster_label  root = *(--white);
+			if (cl->white_histogram)
+				cl->white_histogram[roots[0][root]]++;
+			roots[0][root] = 0;
+		}
+		while (black < list_end) {
+			const cluster_label  root = *(black++);
+			if (cl->black_histogram)
+				cl->black_histogram[roots[1][root]]++;
+			roots[1][root] = 0;
+		}
+	}
+	else {
+		size_t  i = rows * cols;
+		while (i-->0)
+			djs_flatten(djs, i);
+		CLUSTER_PROFILE_PHASE(CLUSTER_PHASE_ROOTS);
+	}
+#endif
+
+	/* Note: index zero and (rows*cols+1) are zero in the histogram, for ease of scanning. */
+	if (cl->white_histogram || cl->black_histogram) {
+		const size_t  n = rows * cols + 1;
+		if (cl->white_histogram) {
+			cl->white_histogram[0] = 0;
+			cl->white_histogram[n] = 0;
+		}
+		if (cl->black_histogram) {
+			cl->black_histogram[0] = 0;
+			cl->black_histogram[n] = 0;
+		}
+	}
+
+	CLUSTER_PROFILE_PHASE(CLUSTER_PHASE_HISTOGRAM);
+
+	/* Check for spanning clusters. */
+	cluster_spans(cl, map, map_stride, (periodic) ? wrapped : NULL);
+
+	CLUSTER_PROFILE_BYTES(CLUSTER_PHASE_SPANNING, ((size_t)rows + cols) * 2 * (sizeof(cluster_color) + 3 * sizeof(cluster_label)));
+	CLUSTER_PROFILE_PHASE(CLUSTER_PHASE_SPANNING);
+
+	/* One more iteration performed. */
+	cl->iterations++;
+}
+
+#endif /* CLUSTERS_H */
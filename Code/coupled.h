@@ -0,0 +1,453 @@
+#ifndef   COUPLED_H
+#define   COUPLED_H
+/*
+Coupled sweeps over the probability of black cells.
+
+Include after clusters_modified.h. With the counter-based generator, a
+cell of a realization is black if its number is below the limit of
+p_black, so the same realization at a higher p_black only has more black
+cells; the diagonal draws do not depend on p_black at all. Sweeping p_black
+over the same realizations gives correlated, much smoother curves, and
+each matrix need not be labelled again from scratch at every point.
+
+iterate_coupled() does one realization at every point of a sweep at once,
+collecting the same statistics as iterate() would at each point with the
+same seed and realization: the spanning counts and Euler numbers, but not
+the cluster size histograms. Each cell is assigned the first point it is
+black at, and the cells are sorted by it. The black clusters only grow
+with p_black, so they are built by adding the cells of each point in turn
+to a disjoint set, joining them to their black neighbours. The white
+clusters only grow as p_black decreases, so they are built the same way,
+from the last point down. No cell is ever removed from a set, so no point
+needs a full relabel. The Euler numbers are local sums, and are updated
+around each cell as it turns black.
+
+Only open boundaries are supported.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "clusters_modified.h"
+
+/* Cell not in the disjoint set. */
+#define  COUPLED_EMPTY   (~(cluster_label)0)
+
+/* Boundary flags, valid for roots. */
+#define  COUPLED_TOP     1u
+#define  COUPLED_BOTTOM  2u
+#define  COUPLED_LEFT    4u
+#define  COUPLED_RIGHT   8u
+
+/* Diagonal join bits of a cell, for each color of the cell. */
+#define  COUPLED_UPLEFT(color)   (1u << (color))
+#define  COUPLED_UPRIGHT(color)  (4u << (color))
+
+/* Statistics of one point, as in cluster. */
+typedef struct {
+    cluster_count   white_spans;
+    cluster_count   black_spans;
+    int64_t         white_euler;
+    int64_t         black_euler;
+    double          white_euler2;
+    double          black_euler2;
+} coupled_point;
+
+typedef struct {
+    /* Actual size of the matrix */
+    cluster_label   rows;
+    cluster_label   cols;
+
+    /* Spanning criterion, CLUSTER_SPAN_EITHER by default */
+    int             span_mode;
+
+    /* Counter-based generator seed, and the number of the next matrix */
+    uint64_t        rng_seed;
+    cluster_count   realization;
+
+    /* Number of matrices the statistics have been collected from */
+    cluster_count   iterations;
+
+    /* Probability limits of diagonal connections */
+    uint64_t        d_white;
+    uint64_t        d_black;
+
+    /* Probability limit of black cells at each point, nondecreasing */
+    size_t          points;
+    uint64_t       *p_black;
+    coupled_point  *point;
+
+    /* Cells sorted by the first point they are black at; those of point k
+       (or never black, for k == points) are order[start[k] .. start[k+1]-1].
+       (points+3) starts. */
+    cluster_label  *order;
+    size_t         *start;
+
+    /* Disjoint set of the color being added, (rows*cols); COUPLED_EMPTY
+       for cells not added yet */
+    cluster_label  *djs;
+    unsigned char  *edge;
+
+    /* Colors at the current point, and diagonal join bits, (rows*cols) */
+    cluster_color  *map;
+    unsigned char  *diag;
+} coupled;
+#define  COUPLED_INITIALIZER  { 0, 0, CLUSTER_SPAN_EITHER, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+
+/* Free all resources related to a coupled sweep. */
+STATIC_INLINE void free_coupled(coupled *e)
+{
+    if (e) {
+        free(e->p_black);
+        free(e->point);
+        free(e->order);
+        free(e->start);
+        free(e->djs);
+        free(e->edge);
+        free(e->map);
+        free(e->diag);
+        memset(e, 0, sizeof *e);
+        e->span_mode = CLUSTER_SPAN_EITHER;
+    }
+}
+
+/* Initialize a coupled sweep of 'points' points, for a matrix of
+   specified size. */
+static int init_coupled(coupled *e, const int rows, const int cols, const size_t points)
+{
+    const cluster_label  label_rows = rows;
+    const cluster_label  label_cols = cols;
+    const cluster_label  cells = label_rows * label_cols;
+
+    if (!e)
+        return ERR_INVALID;
+
+    memset(e, 0, sizeof *e);
+    e->span_mode = CLUSTER_SPAN_EITHER;
+
+    if (rows < 1 || cols < 1 || points < 1)
+        return ERR_INVALID;
+
+    if ((cluster_label)(cells / label_rows) != label_cols ||
+        (cluster_label)(cells / label_cols) != label_rows ||
+        cells >= COUPLED_EMPTY || (cluster_label)points != points)
+        return ERR_TOOLARGE;
+
+#ifdef DJS_BY_SIZE
+    /* The root flag leaves 31 bits for labels and sizes. */
+    if (cells >= ((cluster_label)1 << 31))
+        return ERR_TOOLARGE;
+#endif
+
+    e->p_black = calloc(points, sizeof e->p_black[0]);
+    e->point = calloc(points, sizeof e->point[0]);
+    e->order = malloc((size_t)cells * sizeof e->order[0]);
+    e->start = malloc((points + 3) * sizeof e->start[0]);
+    e->djs = malloc((size_t)cells * sizeof e->djs[0]);
+    e->edge = malloc((size_t)cells);
+    e->map = malloc((size_t)cells * sizeof e->map[0]);
+    e->diag = malloc((size_t)cells);
+    if (!e->p_black || !e->point || !e->order || !e->start ||
+        !e->djs || !e->edge || !e->map || !e->diag) {
+        free_coupled(e);
+        return ERR_NOMEM;
+    }
+
+    e->rows = rows;
+    e->cols = cols;
+    e->points = points;
+
+    return 0;
+}
+
+/* Set the probabilities, one p_black per point in increasing order, and
+   clear the statistics. */
+static int reset_coupled(coupled *e, const double *const p_black,
+    const double d_white, const double d_black)
+{
+    size_t  k;
+
+    if (!e || !e->point || !p_black)
+        return ERR_INVALID;
+
+    for (k = 0; k < e->points; k++) {
+        e->p_black[k] = probability_limit(p_black[k]);
+        if (k > 0 && e->p_black[k] < e->p_black[k - 1])
+            return ERR_INVALID;
+    }
+
+    e->d_white = probability_limit(d_white);
+    e->d_black = probability_limit(d_black);
+    e->iterations = 0;
+    memset(e->point, 0, e->points * sizeof e->point[0]);
+
+    return 0;
+}
+
+/* Copy the statistics of point k to the counters of 'to'. */
+static void coupled_stats(const coupled *const e, const size_t k, cluster *const to)
+{
+    const coupled_point *const  point = e->point + k;
+
+    to->iterations = e->iterations;
+    to->white_spans = point->white_spans;
+    to->black_spans = point->black_spans;
+    to->white_euler = point->white_euler;
+    to->black_euler = point->black_euler;
+    to->white_euler2 = point->white_euler2;
+    to->black_euler2 = point->black_euler2;
+}
+
+/* Add the Euler number terms iterate() assigns to the cell at 'label':
+   the cell, its left, up, up-left and up-right joins, and the block
+   up-left of it; see euler_block(). */
+STATIC_INLINE void  coupled_euler_cell(const coupled *const e, const cluster_label label,
+                                       int64_t euler[2])
+{
+    const cluster_color *const  map = e->map;
+    const unsigned char *const  diag = e->diag;
+    cluster_label  const        cols = e->cols;
+    cluster_label  const        r = label / cols;
+    cluster_label  const        c = label % cols;
+    cluster_color  const        color = map[label];
+    int                         joins = 0;
+    int                         upleft = 0;
+
+    if (c > 0)
+        joins += (map[label - 1] == color);
+    if (r > 0) {
+        joins += (map[label - cols] == color);
+        if (c > 0) {
+            upleft = (map[label - cols - 1] == color && (diag[label] & COUPLED_UPLEFT(color)));
+            joins += upleft;
+        }
+        if (c < cols - 1)
+            joins += (map[label - cols + 1] == color && (diag[label] & COUPLED_UPRIGHT(color)));
+    }
+    euler[color] += 1 - joins;
+
+    if (r > 0 && c > 0) {
+        const cluster_color  left = map[label - 1];
+        /* The up-right join of the cell to the left. */
+        const int            upright = (map[label - cols] == left && (diag[label - 1] & COUPLED_UPRIGHT(left)));
+
+        euler_block(euler, map[label - cols - 1], map[label - cols], left, color, upleft + upright);
+    }
+}
+
+/* Add the Euler number terms of all cells with terms depending on the
+   color of the cell at 'label': itself, and the cells right, down-left,
+   down, and down-right of it. */
+STATIC_INLINE void  coupled_euler_around(const coupled *const e, const cluster_label label,
+                                         int64_t euler[2])
+{
+    cluster_label  const  rows = e->rows;
+    cluster_label  const  cols = e->cols;
+    cluster_label  const  r = label / cols;
+    cluster_label  const  c = label % cols;
+
+    coupled_euler_cell(e, label, euler);
+    if (c < cols - 1)
+        coupled_euler_cell(e, label + 1, euler);
+    if (r < rows - 1) {
+        if (c > 0)
+            coupled_euler_cell(e, label + cols - 1, euler);
+        coupled_euler_cell(e, label + cols, euler);
+        if (c < cols - 1)
+            coupled_euler_cell(e, label + cols + 1, euler);
+    }
+}
+
+/* Join the cluster of root 'root' with the cluster of cell 'other'.
+   Returns the new root. */
+STATIC_INLINE cluster_label  coupled_join(coupled *const e, const cluster_label root,
+                                          const cluster_label other)
+{
+    const cluster_label  temp = djs_flatten(e->djs, other);
+    cluster_label        joined;
+
+    if (temp == root)
+        return root;
+
+    joined = djs_link(e->djs, root, temp);
+    e->edge[joined] = e->edge[root] | e->edge[temp];
+    return joined;
+}
+
+/* Add the cell at 'label' to the disjoint set, joining it to the cells
+   of the same color already added, as iterate() would join them.
+   Returns nonzero if its cluster spans the matrix. */
+STATIC_INLINE int  coupled_add(coupled *const e, const cluster_label label, const cluster_color color)
+{
+    cluster_label *const        djs = e->djs;
+    const unsigned char *const  diag = e->diag;
+    cluster_label  const        rows = e->rows;
+    cluster_label  const        cols = e->cols;
+    cluster_label  const        r = label / cols;
+    cluster_label  const        c = label % cols;
+    cluster_label               root = label;
+    unsigned int                edge;
+
+    djs_init(djs, label);
+    e->edge[label] = (r == 0        ? COUPLED_TOP    : 0)
+                   | (r == rows - 1 ? COUPLED_BOTTOM : 0)
+                   | (c == 0        ? COUPLED_LEFT   : 0)
+                   | (c == cols - 1 ? COUPLED_RIGHT  : 0);
+
+    /* Left, right, up, down. */
+    if (c > 0 && djs[label - 1] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label - 1);
+    if (c < cols - 1 && djs[label + 1] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label + 1);
+    if (r > 0 && djs[label - cols] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label - cols);
+    if (r < rows - 1 && djs[label + cols] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label + cols);
+
+    /* Diagonals, decided by the draws of the lower cell. */
+    if (r > 0 && c > 0 && (diag[label] & COUPLED_UPLEFT(color)) &&
+        djs[label - cols - 1] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label - cols - 1);
+    if (r > 0 && c < cols - 1 && (diag[label] & COUPLED_UPRIGHT(color)) &&
+        djs[label - cols + 1] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label - cols + 1);
+    if (r < rows - 1 && c > 0 && (diag[label + cols - 1] & COUPLED_UPRIGHT(color)) &&
+        djs[label + cols - 1] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label + cols - 1);
+    if (r < rows - 1 && c < cols - 1 && (diag[label + cols + 1] & COUPLED_UPLEFT(color)) &&
+        djs[label + cols + 1] != COUPLED_EMPTY)
+        root = coupled_join(e, root, label + cols + 1);
+
+    edge = e->edge[root];
+    switch (e->span_mode) {
+    case CLUSTER_SPAN_HORIZONTAL:
+        return (edge & (COUPLED_LEFT | COUPLED_RIGHT)) == (COUPLED_LEFT | COUPLED_RIGHT);
+    case CLUSTER_SPAN_VERTICAL:
+        return (edge & (COUPLED_TOP | COUPLED_BOTTOM)) == (COUPLED_TOP | COUPLED_BOTTOM);
+    case CLUSTER_SPAN_BOTH:
+        return edge == (COUPLED_TOP | COUPLED_BOTTOM | COUPLED_LEFT | COUPLED_RIGHT);
+    default:
+        return (edge & (COUPLED_LEFT | COUPLED_RIGHT)) == (COUPLED_LEFT | COUPLED_RIGHT) ||
+               (edge & (COUPLED_TOP | COUPLED_BOTTOM)) == (COUPLED_TOP | COUPLED_BOTTOM);
+    }
+}
+
+/* Do one realization at all points. */
+static void iterate_coupled(coupled *const e)
+{
+    cluster_label  const  rows = e->rows;
+    cluster_label  const  cols = e->cols;
+    cluster_label  const  cells = rows * cols;
+    size_t         const  points = e->points;
+    cluster_label *const  order = e->order;
+    size_t        *const  start = e->start;
+    cluster_label *const  djs = e->djs;
+    cluster_color *const  map = e->map;
+    uint64_t              key[CLUSTER_DRAWS];
+    int64_t               euler[2] = { 0, 0 };
+    cluster_label         r, c, i;
+    size_t                k, j;
+    int                   spanned;
+
+    for (i = 0; i < CLUSTER_DRAWS; i++)
+        key[i] = counter_key(e->rng_seed, e->realization, i);
+    e->realization++;
+
+    /* The first point each cell is black at, kept in djs for now, and
+       the diagonal joins of each cell for both colors. */
+    memset(start, 0, (points + 3) * sizeof start[0]);
+    for (r = 0; r < rows; r++) {
+        const uint64_t  color_key = counter_row(key[CLUSTER_DRAW_COLOR], r);
+        const uint64_t  upleft_key = counter_row(key[CLUSTER_DRAW_UPLEFT], r);
+        const uint64_t  upright_key = counter_row(key[CLUSTER_DRAW_UPRIGHT], r);
+
+        for (c = 0; c < cols; c++) {
+            const cluster_label  label = r * cols + c;
+            const uint64_t       value = counter_value(color_key, c);
+            const uint64_t       limit = value + !value;
+            size_t               lo = 0, hi = points;
+
+            /* First point where counter_probability() is black. */
+            while (lo < hi) {
+                const size_t  mid = lo + (hi - lo) / 2;
+                if (limit <= e->p_black[mid])
+                    hi = mid;
+                else
+                    lo = mid + 1;
+            }
+            djs[label] = (cluster_label)lo;
+            start[lo + 2]++;
+
+            /* The first row has nothing above it. */
+            e->diag[label] = (r == 0) ? 0 :
+                  (counter_probability(upleft_key, c, e->d_white) ? COUPLED_UPLEFT(CLUSTER_WHITE) : 0)
+                | (counter_probability(upleft_key, c, e->d_black) ? COUPLED_UPLEFT(CLUSTER_BLACK) : 0)
+                | (counter_probability(upright_key, c, e->d_white) ? COUPLED_UPRIGHT(CLUSTER_WHITE) : 0)
+                | (counter_probability(upright_key, c, e->d_black) ? COUPLED_UPRIGHT(CLUSTER_BLACK) : 0);
+        }
+    }
+
+    /* Counting sort; afterwards, start[k] is the first cell of point k. */
+    for (k = 2; k < points + 3; k++)
+        start[k] += start[k - 1];
+    for (i = 0; i < cells; i++)
+        order[start[djs[i] + 1]++] = i;
+
+    /* Black clusters, up from the first point. The first point is labelled
+       in full, by adding all its black cells; after that, the Euler numbers
+       are updated around each cell turning black. */
+    for (i = 0; i < cells; i++) {
+        djs[i] = COUPLED_EMPTY;
+        map[i] = CLUSTER_WHITE;
+    }
+    for (j = start[0]; j < start[1]; j++)
+        map[order[j]] = CLUSTER_BLACK;
+    for (i = 0; i < cells; i++)
+        coupled_euler_cell(e, i, euler);
+
+    spanned = 0;
+    for (k = 0; k < points; k++) {
+        coupled_point *const  point = e->point + k;
+
+        for (j = start[k]; j < start[k + 1]; j++) {
+            const cluster_label  label = order[j];
+
+            if (k > 0) {
+                int64_t  before[2] = { 0, 0 };
+                int64_t  after[2] = { 0, 0 };
+
+                coupled_euler_around(e, label, before);
+                map[label] = CLUSTER_BLACK;
+                coupled_euler_around(e, label, after);
+
+                euler[CLUSTER_WHITE] += after[CLUSTER_WHITE] - before[CLUSTER_WHITE];
+                euler[CLUSTER_BLACK] += after[CLUSTER_BLACK] - before[CLUSTER_BLACK];
+            }
+
+            if (coupled_add(e, label, CLUSTER_BLACK))
+                spanned = 1;
+        }
+
+        point->black_spans += spanned;
+        point->white_euler += euler[CLUSTER_WHITE];
+        point->black_euler += euler[CLUSTER_BLACK];
+        point->white_euler2 += (double)euler[CLUSTER_WHITE] * (double)euler[CLUSTER_WHITE];
+        point->black_euler2 += (double)euler[CLUSTER_BLACK] * (double)euler[CLUSTER_BLACK];
+    }
+
+    /* White clusters, down from the last point. The cells white at point
+       k are those black only after it, or never. */
+    for (i = 0; i < cells; i++)
+        djs[i] = COUPLED_EMPTY;
+
+    spanned = 0;
+    for (k = points; k-->0; ) {
+        for (j = start[k + 1]; j < start[k + 2]; j++)
+            if (coupled_add(e, order[j], CLUSTER_WHITE))
+                spanned = 1;
+
+        e->point[k].white_spans += spanned;
+    }
+
+    e->iterations++;
+}
+
+#endif /* COUPLED_H */
@@ -1,185 +1,425 @@
-/* Courtesy: Nominal Animal <question@nominal-animal.net>
-*/
-
-#include <stdlib.h>
-#include <inttypes.h>
-#include <string.h>
-#include <stdio.h>
-#include "clusters.h"
-
-#define  DEFAULT_ROWS          100
-#define  DEFAULT_COLS          100
-#define  DEFAULT_P_BLACK       0.0
-#define  DEFAULT_P_DIAG        0.0
-#define  DEFAULT_P_DIAG_BLACK  0.0
-#define  DEFAULT_ITERS         1
-
-int usage(const char *argv0)
-{
-    fprintf(stderr, "\n");
-    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
-    fprintf(stderr, "       %s OPTIONS [ > output.txt ]\n", argv0);
-    fprintf(stderr, "\n");
-    fprintf(stderr, "Options:\n");
-    fprintf(stderr, "       rows=SIZE    Set number of rows. Default is %d.\n", DEFAULT_ROWS);
-    fprintf(stderr, "       cols=SIZE    Set number of columns. Default is %d.\n", DEFAULT_ROWS);
-    fprintf(stderr, "       L=SIZE       Set rows=SIZE and cols=SIZE.\n");
-    fprintf(stderr, "       black=P      Set the probability of a cell to be black. Default is %g.\n", DEFAULT_P_BLACK);
-    fprintf(stderr, "                    All non-black cells are white.\n");
-    fprintf(stderr, "       diag=P       Set the probability of cells connecting diagonally.\n");
-    fprintf(stderr, "                    Default is %g.\n", DEFAULT_P_DIAG);
-    fprintf(stderr, "       diagblack=P  Set the probability of a diagonal connection to be between\n");
-    fprintf(stderr, "                    black cells. Default is %g.\n", DEFAULT_P_DIAG_BLACK);
-    fprintf(stderr, "       N=COUNT      Number of iterations for gathering statistics. Default is %d.\n", DEFAULT_ITERS);
-    fprintf(stderr, "       seed=U64     Set the Xorshift64* pseudorandom number generator seed; nonzero.\n");
-    fprintf(stderr, "                    Default is to pick one randomly (based on time).\n");
-    fprintf(stderr, "\n");
-    fprintf(stderr, "The output consists of comment lines and data lines.\n");
-    fprintf(stderr, "Comment lines begin with a #:\n");
-    fprintf(stderr, "   # This is a comment line.\n");
-    fprintf(stderr, "Each data line contains a cluster size, the number of white clusters of that size\n");
-    fprintf(stderr, "observed during iterations, the number of black clusters of that size observed\n");
-    fprintf(stderr, "during iterations, and the number of any clusters of that size observed:\n");
-    fprintf(stderr, "   SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS  TOTAL_CLUSTERS\n");
-    fprintf(stderr, "\n");
-    return EXIT_SUCCESS;
-}
-
-int main(int argc, char *argv[])
-{
-    int      rows = DEFAULT_ROWS;
-    int      cols = DEFAULT_COLS;
-    double   p_black      = DEFAULT_P_BLACK;
-    double   p_diag       = DEFAULT_P_DIAG;
-    double   p_diag_black = DEFAULT_P_DIAG_BLACK;
-    long     iters = DEFAULT_ITERS;
-    uint64_t seed = 0;
-    cluster  c = CLUSTER_INITIALIZER;
-
-    int      arg, itemp;
-    uint64_t u64temp;
-    double   dtemp;
-    long     ltemp;
-    char     dummy;
-
-    size_t   n;
-    size_t   i;
-
-    if (argc < 2)
-        return usage(argv[0]);
-
-    for (arg = 1; arg < argc; arg++)
-        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
-            return usage(argv[0]);
-        else
-        if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "l=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
-            rows = itemp;
-            cols = itemp;
-        } else
-        if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
-            sscanf(argv[arg], "seed=%" SCNx64 " %c", &u64temp, &dummy) == 1 ||
-            sscanf(argv[arg], "s=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
-            sscanf(argv[arg], "s=%" SCNx64 " %c", &u64temp, &dummy) == 1) {
-            seed = u64temp;
-        } else
-        if (sscanf(argv[arg], "N=%ld %c", &ltemp, &dummy) == 1 ||
-            sscanf(argv[arg], "n=%ld %c", &ltemp, &dummy) == 1 ||
-            sscanf(argv[arg], "count=%ld %c", &ltemp, &dummy) == 1) {
-            iters = ltemp;
-        } else
-        if (sscanf(argv[arg], "rows=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "r=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "height=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "h=%d %c", &itemp, &dummy) == 1) {
-            rows = itemp;
-        } else
-        if (sscanf(argv[arg], "columns=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "cols=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "c=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "width=%d %c", &itemp, &dummy) == 1 ||
-            sscanf(argv[arg], "w=%d %c", &itemp, &dummy) == 1) {
-            cols = itemp;
-        } else
-        if (sscanf(argv[arg], "black=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "p0=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "b=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "P=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "p0=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "p=%lf %c", &dtemp, &dummy) == 1) {
-            p_black = dtemp;
-        } else
-        if (sscanf(argv[arg], "white=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "p1=%lf %c", &dtemp, &dummy) == 1) {
-            p_black = 1.0 - dtemp;
-        } else
-        if (sscanf(argv[arg], "d=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "diag=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "pd=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "pdiag=%lf %c", &dtemp, &dummy) == 1) {
-            p_diag = dtemp;
-        } else
-        if (sscanf(argv[arg], "d0=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "db=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "diag0=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "diagblack=%lf %c", &dtemp, &dummy) == 1 ||
-            sscanf(argv[arg], "diag_black=%lf %c", &dtemp, &dummy) == 1) {
-            p_diag_black = dtemp;
-        } else {
-            fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
-            return EXIT_FAILURE;
-        }
-
-    switch (init_cluster(&c, rows, cols, p_black, p_diag, p_diag_black)) {
-    case 0: break; /* OK */
-    case ERR_INVALID:
-        fprintf(stderr, "Invalid size.\n");
-        return EXIT_FAILURE;
-    case ERR_TOOLARGE:
-        fprintf(stderr, "Size is too large.\n");
-        return EXIT_FAILURE;
-    case ERR_NOMEM:
-        fprintf(stderr, "Not enough memory.\n");
-        return EXIT_FAILURE;
-    }
-
-    if (!seed)
-        seed = randomize(NULL);
-
-    c.rng.state = seed;
-
-    /* The largest possible cluster has n cells. */
-    n = (size_t)rows * (size_t)cols;
-
-    /* Print the comments describing the initial parameters. */
-    printf("# seed: %" PRIu64 " (Xorshift 64*)\n", seed);
-    printf("# size: %d rows, %d columns\n", rows, cols);
-    printf("# P(black): %.6f (%" PRIu64 "/18446744073709551615)\n", p_black, c.p_black);
-    printf("# P(connecting diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", p_diag, c.p_diag);
-    printf("# P(black connecting diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", p_diag_black, c.p_diag_black);
-    fflush(stdout);
-
-    while (iters-->0)
-        iterate(&c);
-
-    printf("# Iterations: %" PRIu64 "\n", c.iterations);
-    printf("#\n");
-    printf("# size  white_clusters(size) black_clusters(size) clusters(size)\n");
-
-    /* Note: c._histogram[0] == c._histogram[n] == 0, for ease of scanning. */
-    for (i = 1; i <= n; i++)
-        if (c.white_histogram[i-1] || c.white_histogram[i] || c.white_histogram[i+1] ||
-            c.black_histogram[i-1] || c.black_histogram[i] || c.black_histogram[i+1])
-            printf("%lu %" FMT_COUNT " %" FMT_COUNT " %" FMT_COUNT "\n",
-                   (unsigned long)i,
-                   c.white_histogram[i],
-                   c.black_histogram[i],
-                   c.white_histogram[i]+c.black_histogram[i]);
-
-    /* Since we are exiting anyway, this is not really necessary. */
-    free_cluster(&c);
-
-    /* All done. */
-    return EXIT_SUCCESS;
-}
+/* Courtesy: Nominal Animal <question@nominal-animal.net>
+*/
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "clusters.h"
+#include "replicas.h"
+#include "checkpoint.h"
+#include "bsd.h"
+
+#define  DEFAULT_ROWS          100
+#define  DEFAULT_COLS          100
+#define  DEFAULT_P_BLACK       0.0
+#define  DEFAULT_P_DIAG        0.0
+#define  DEFAULT_P_DIAG_BLACK  0.0
+#define  DEFAULT_ITERS         1
+#define  DEFAULT_THREADS       1
+#define  DEFAULT_EVERY         600.0
+
+int usage(const char *argv0)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
+    fprintf(stderr, "       %s OPTIONS [ > output.txt ]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "       rows=SIZE    Set number of rows. Default is %d.\n", DEFAULT_ROWS);
+    fprintf(stderr, "       cols=SIZE    Set number of columns. Default is %d.\n", DEFAULT_ROWS);
+    fprintf(stderr, "       L=SIZE       Set rows=SIZE and cols=SIZE.\n");
+    fprintf(stderr, "       black=P      Set the probability of a cell to be black. Default is %g.\n", DEFAULT_P_BLACK);
+    fprintf(stderr, "                    All non-black cells are white.\n");
+    fprintf(stderr, "       diag=P       Set the probability of cells connecting diagonally.\n");
+    fprintf(stderr, "                    Default is %g.\n", DEFAULT_P_DIAG);
+    fprintf(stderr, "       diagblack=P  Set the probability of a diagonal connection to be between\n");
+    fprintf(stderr, "                    black cells. Default is %g.\n", DEFAULT_P_DIAG_BLACK);
+    fprintf(stderr, "       N=COUNT      Number of iterations for gathering statistics. Default is %d.\n", DEFAULT_ITERS);
+    fprintf(stderr, "       seed=U64     Set the Xorshift64* pseudorandom number generator seed; nonzero.\n");
+    fprintf(stderr, "                    Default is to pick one randomly (based on time).\n");
+    fprintf(stderr, "       threads=K    Split the iterations among K independent replicas,\n");
+    fprintf(stderr, "                    each in its own thread. Default is %d.\n", DEFAULT_THREADS);
+    fprintf(stderr, "       bins=log2    Print the histogram in base-2 logarithmic bins of\n");
+    fprintf(stderr, "                    cluster sizes. Default is bins=exact.\n");
+    fprintf(stderr, "       binary=FILE  Append the histogram to FILE in the binary format of\n");
+    fprintf(stderr, "                    bsd.h, instead of printing it. bsd2txt converts it\n");
+    fprintf(stderr, "                    back to the text layout below.\n");
+    fprintf(stderr, "       checkpoint=FILE\n");
+    fprintf(stderr, "                    Save the state of the run to FILE periodically, and\n");
+    fprintf(stderr, "                    when the run completes.\n");
+    fprintf(stderr, "       every=SECONDS\n");
+    fprintf(stderr, "                    Set the checkpoint interval. Default is %.0f.\n", DEFAULT_EVERY);
+    fprintf(stderr, "       resume=FILE  Continue the run saved in FILE. The size, probabilities,\n");
+    fprintf(stderr, "                    seed and threads are taken from FILE, and N is the total\n");
+    fprintf(stderr, "                    number of iterations, including those already done.\n");
+    fprintf(stderr, "                    The results are the same as for an uninterrupted run.\n");
+    fprintf(stderr, "                    Checkpoints are saved to FILE unless checkpoint is given.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "The output consists of comment lines and data lines.\n");
+    fprintf(stderr, "Comment lines begin with a #:\n");
+    fprintf(stderr, "   # This is a comment line.\n");
+    fprintf(stderr, "Each data line contains a cluster size, the number of white clusters of that size\n");
+    fprintf(stderr, "observed during iterations, the number of black clusters of that size observed\n");
+    fprintf(stderr, "during iterations, and the number of any clusters of that size observed:\n");
+    fprintf(stderr, "   SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS  TOTAL_CLUSTERS\n");
+    fprintf(stderr, "With bins=log2, each data line covers the sizes MIN_SIZE to MAX_SIZE, inclusive:\n");
+    fprintf(stderr, "   MIN_SIZE  MAX_SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS  TOTAL_CLUSTERS\n");
+    fprintf(stderr, "\n");
+    return EXIT_SUCCESS;
+}
+
+/* Save the state of the replicas to a checkpoint file. The number of
+   iterations done by each replica is already in cp->done. */
+static int save_checkpoint(checkpoint *const cp, const char *const path,
+                           const cluster *const replica, const int count)
+{
+    size_t  i;
+    int     r;
+
+    memset(cp->white_histogram, 0, cp->size * sizeof cp->white_histogram[0]);
+    memset(cp->black_histogram, 0, cp->size * sizeof cp->black_histogram[0]);
+    cp->iterations = 0;
+
+    for (r = 0; r < count; r++) {
+        for (i = 0; i < cp->size; i++) {
+            cp->white_histogram[i] += replica[r].white_histogram[i];
+            cp->black_histogram[i] += replica[r].black_histogram[i];
+        }
+        cp->iterations += replica[r].iterations;
+        cp->state[r] = replica[r].rng.state;
+    }
+
+    cp->param[0] = replica->p_black;
+    cp->param[1] = replica->p_diag;
+    cp->param[2] = replica->p_diag_black;
+
+    return checkpoint_save(cp, path);
+}
+
+int main(int argc, char *argv[])
+{
+    int      rows = DEFAULT_ROWS;
+    int      cols = DEFAULT_COLS;
+    double   p_black      = DEFAULT_P_BLACK;
+    double   p_diag       = DEFAULT_P_DIAG;
+    double   p_diag_black = DEFAULT_P_DIAG_BLACK;
+    long     iters = DEFAULT_ITERS;
+    int      threads = DEFAULT_THREADS;
+    int      log_bins = 0;
+    uint64_t seed = 0;
+    cluster  c = CLUSTER_INITIALIZER;
+    cluster *replica = &c;
+
+    checkpoint   cp = CHECKPOINT_INITIALIZER;
+    const char  *checkpoint_path = NULL;
+    const char  *resume_path = NULL;
+    const char  *binary_path = NULL;
+    double       every = DEFAULT_EVERY;
+    int          result, r;
+
+    int      arg, itemp;
+    uint64_t u64temp;
+    double   dtemp;
+    long     ltemp;
+    char     dummy;
+
+    size_t   n;
+    size_t   i;
+
+    if (argc < 2)
+        return usage(argv[0]);
+
+    for (arg = 1; arg < argc; arg++)
+        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
+            return usage(argv[0]);
+        else
+        if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "l=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
+            rows = itemp;
+            cols = itemp;
+        } else
+        if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "seed=%" SCNx64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "s=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "s=%" SCNx64 " %c", &u64temp, &dummy) == 1) {
+            seed = u64temp;
+        } else
+        if (sscanf(argv[arg], "N=%ld %c", &ltemp, &dummy) == 1 ||
+            sscanf(argv[arg], "n=%ld %c", &ltemp, &dummy) == 1 ||
+            sscanf(argv[arg], "count=%ld %c", &ltemp, &dummy) == 1) {
+            iters = ltemp;
+        } else
+        if (sscanf(argv[arg], "rows=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "r=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "height=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "h=%d %c", &itemp, &dummy) == 1) {
+            rows = itemp;
+        } else
+        if (sscanf(argv[arg], "columns=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "cols=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "c=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "width=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "w=%d %c", &itemp, &dummy) == 1) {
+            cols = itemp;
+        } else
+        if (sscanf(argv[arg], "black=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "p0=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "b=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "P=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "p0=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "p=%lf %c", &dtemp, &dummy) == 1) {
+            p_black = dtemp;
+        } else
+        if (sscanf(argv[arg], "white=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "p1=%lf %c", &dtemp, &dummy) == 1) {
+            p_black = 1.0 - dtemp;
+        } else
+        if (sscanf(argv[arg], "d=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "diag=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "pd=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "pdiag=%lf %c", &dtemp, &dummy) == 1) {
+            p_diag = dtemp;
+        } else
+        if (sscanf(argv[arg], "d0=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "db=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "diag0=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "diagblack=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "diag_black=%lf %c", &dtemp, &dummy) == 1) {
+            p_diag_black = dtemp;
+        } else
+        if (sscanf(argv[arg], "threads=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "t=%d %c", &itemp, &dummy) == 1) {
+            if (itemp < 1) {
+                fprintf(stderr, "%s: Invalid number of threads.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            threads = itemp;
+        } else
+        if (!strcmp(argv[arg], "bins=log2") || !strcmp(argv[arg], "bins=log")) {
+            log_bins = 1;
+        } else
+        if (!strcmp(argv[arg], "bins=exact") || !strcmp(argv[arg], "bins=1")) {
+            log_bins = 0;
+        } else
+        if (!strncmp(argv[arg], "checkpoint=", 11) && argv[arg][11]) {
+            checkpoint_path = argv[arg] + 11;
+        } else
+        if (!strncmp(argv[arg], "binary=", 7) && argv[arg][7]) {
+            binary_path = argv[arg] + 7;
+        } else
+        if (!strncmp(argv[arg], "resume=", 7) && argv[arg][7]) {
+            resume_path = argv[arg] + 7;
+        } else
+        if (sscanf(argv[arg], "every=%lf %c", &dtemp, &dummy) == 1) {
+            if (dtemp < 0.0) {
+                fprintf(stderr, "%s: Invalid checkpoint interval.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            every = dtemp;
+        } else {
+            fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
+            return EXIT_FAILURE;
+        }
+
+    if (resume_path) {
+        result = checkpoint_load(&cp, resume_path);
+        if (result) {
+            fprintf(stderr, "%s: %s.\n", resume_path, checkpoint_strerror(result));
+            return EXIT_FAILURE;
+        }
+        if (cp.streams < 1 || cp.streams > 65536 || cp.rows > INT_MAX || cp.cols > INT_MAX) {
+            fprintf(stderr, "%s: This checkpoint cannot be continued.\n", resume_path);
+            return EXIT_FAILURE;
+        }
+
+        rows = (int)cp.rows;
+        cols = (int)cp.cols;
+        threads = (int)cp.streams;
+        seed = cp.seed;
+        p_black = (double)cp.param[0] / 18446744073709551616.0;
+        p_diag = (double)cp.param[1] / 18446744073709551616.0;
+        p_diag_black = (double)cp.param[2] / 18446744073709551616.0;
+
+        if (!checkpoint_path)
+            checkpoint_path = resume_path;
+    }
+
+    if (!seed)
+        seed = randomize(NULL);
+
+    if (threads > 1) {
+        replica = malloc((size_t)threads * sizeof replica[0]);
+        if (!replica) {
+            fprintf(stderr, "Not enough memory.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    switch ((threads > 1) ? init_replicas(replica, threads, rows, cols, p_black, p_diag, p_diag_black, seed)
+                          : init_cluster(&c, rows, cols, p_black, p_diag, p_diag_black)) {
+    case 0: break; /* OK */
+    case ERR_INVALID:
+        fprintf(stderr, "Invalid size.\n");
+        return EXIT_FAILURE;
+    case ERR_TOOLARGE:
+        fprintf(stderr, "Size is too large.\n");
+        return EXIT_FAILURE;
+    case ERR_NOMEM:
+        fprintf(stderr, "Not enough memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (threads < 2)
+        c.rng.state = seed;
+
+    if (resume_path) {
+        /* Restore the exact generator states and probabilities, and add
+           the statistics so far to the first replica. */
+        for (r = 0; r < threads; r++) {
+            replica[r].rng.state = cp.state[r];
+            replica[r].p_black = cp.param[0];
+            replica[r].p_diag = cp.param[1];
+            replica[r].p_diag_black = cp.param[2];
+        }
+        for (i = 0; i < cp.size; i++) {
+            replica->white_histogram[i] += cp.white_histogram[i];
+            replica->black_histogram[i] += cp.black_histogram[i];
+        }
+        replica->iterations += cp.iterations;
+    } else
+    if (checkpoint_path) {
+        result = init_checkpoint(&cp, rows, cols, threads);
+        if (result) {
+            fprintf(stderr, "%s: %s.\n", checkpoint_path, checkpoint_strerror(result));
+            return EXIT_FAILURE;
+        }
+        cp.seed = seed;
+    }
+
+    /* The largest possible cluster has n cells. */
+    n = (size_t)rows * (size_t)cols;
+
+    /* Print the comments describing the initial parameters. */
+    printf("# seed: %" PRIu64 " (Xorshift 64*)\n", seed);
+    printf("# size: %d rows, %d columns\n", rows, cols);
+    printf("# P(black): %.6f (%" PRIu64 "/18446744073709551615)\n", p_black, replica->p_black);
+    printf("# P(connecting diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", p_diag, replica->p_diag);
+    printf("# P(black connecting diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", p_diag_black, replica->p_diag_black);
+    if (threads > 1)
+        printf("# threads: %d (replica seeds split from seed)\n", threads);
+    fflush(stdout);
+
+    if (checkpoint_path) {
+        /* Run in rounds, doubling the round length while it is short
+           compared to the checkpoint interval. */
+        cluster_count *const  share = malloc((size_t)threads * sizeof share[0]);
+        cluster_count         chunk = 1;
+        time_t                saved = time(NULL);
+
+        if (!share) {
+            fprintf(stderr, "Not enough memory.\n");
+            return EXIT_FAILURE;
+        }
+
+        while (1) {
+            const time_t   started = time(NULL);
+            cluster_count  left = 0;
+
+            for (r = 0; r < threads; r++) {
+                const cluster_count  target = replica_share((iters > 0) ? iters : 0, threads, r);
+                const cluster_count  rest = (cp.done[r] < target) ? target - cp.done[r] : 0;
+                share[r] = (rest < chunk) ? rest : chunk;
+                left += rest;
+            }
+            if (!left)
+                break;
+
+            if (run_replicas(replica, threads, share)) {
+                fprintf(stderr, "Cannot run replicas.\n");
+                return EXIT_FAILURE;
+            }
+            for (r = 0; r < threads; r++)
+                cp.done[r] += share[r];
+
+            if (difftime(time(NULL), saved) >= every) {
+                result = save_checkpoint(&cp, checkpoint_path, replica, threads);
+                if (result)
+                    fprintf(stderr, "%s: %s.\n", checkpoint_path, checkpoint_strerror(result));
+                saved = time(NULL);
+            }
+
+            if (difftime(time(NULL), started) * 8.0 < every && chunk < ((cluster_count)1 << 40))
+                chunk *= 2;
+        }
+
+        free(share);
+
+        result = save_checkpoint(&cp, checkpoint_path, replica, threads);
+        if (result)
+            fprintf(stderr, "%s: %s.\n", checkpoint_path, checkpoint_strerror(result));
+
+        if (merge_replicas(replica, threads)) {
+            fprintf(stderr, "Cannot merge replicas.\n");
+            return EXIT_FAILURE;
+        }
+        c = replica[0];
+    } else
+    if (threads > 1) {
+        if (iterate_replicas(replica, threads, (iters > 0) ? iters : 0) ||
+            merge_replicas(replica, threads)) {
+            fprintf(stderr, "Cannot run replicas.\n");
+            return EXIT_FAILURE;
+        }
+        c = replica[0];
+    } else
+        while (iters-->0)
+            iterate(&c);
+
+    printf("# Iterations: %" PRIu64 "\n", c.iterations);
+    printf("#\n");
+
+    if (binary_path) {
+        bsd_header  header;
+        FILE       *out;
+
+        header.seed = seed;
+        header.rows = rows;
+        header.cols = cols;
+        header.threads = threads;
+        header.p_black = p_black;
+        header.p_diag = p_diag;
+        header.p_diag_black = p_diag_black;
+        header.limit_black = c.p_black;
+        header.limit_diag = c.p_diag;
+        header.limit_diag_black = c.p_diag_black;
+        header.iterations = c.iterations;
+
+        out = fopen(binary_path, "ab");
+        if (!out) {
+            fprintf(stderr, "%s: %s.\n", binary_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        result = bsd_write(out, &header, c.white_histogram, c.black_histogram, n);
+        if (fclose(out) && !result)
+            result = (errno) ? errno : EIO;
+        if (result) {
+            fprintf(stderr, "%s: %s.\n", binary_path, bsd_strerror(result));
+            return EXIT_FAILURE;
+        }
+        printf("# Histogram appended to %s\n", binary_path);
+    } else
+        checkpoint_print_histogram(stdout, c.white_histogram, c.black_histogram, n, log_bins);
+
+    /* Since we are exiting anyway, this is not really necessary. */
+    if (threads > 1) {
+        free_replicas(replica, threads);
+        free(replica);
+    } else
+        free_cluster(&c);
+    free_checkpoint(&cp);
+
+    /* All done. */
+    return EXIT_SUCCESS;
+}
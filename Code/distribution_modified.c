@@ -2,7 +2,12 @@
 #include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
-#include "clustersx.h"
+#include <math.h>
+#include "clusters_modified.h"
+#include "options.h"
+#include "replicas.h"
+#include "tiles.h"
+#include "coupled.h"
 
 #define  DEFAULT_ROWS     100
 #define  DEFAULT_COLS     100
@@ -10,6 +15,214 @@
 #define  DEFAULT_D_WHITE  0.0
 #define  DEFAULT_D_BLACK  0.0
 #define  DEFAULT_ITERS    1
+#define  DEFAULT_THREADS  1
+#define  DEFAULT_BATCH    100
+
+/* Normal quantile of the two-sided 95% confidence intervals */
+#define  Z_95  1.959963984540054
+
+/* Half-width of the 95% Wilson score interval of the probability,
+   with 'hits' successes in 'trials' trials. Unlike the normal
+   approximation, it is not zero when 'hits' is 0 or 'trials'. */
+static double wilson_error(const double hits, const double trials)
+{
+	const double  p = hits / trials;
+	const double  z2n = Z_95 * Z_95 / trials;
+
+	return Z_95 / (1.0 + z2n) * sqrt(p * (1.0 - p) / trials + z2n / (4.0 * trials));
+}
+
+/* Sum of the k'th powers of the black cluster sizes over all iterations
+   so far, in all 'count' replicas. */
+static double black_moment(const cluster *const replica, const int count, const int k)
+{
+	const size_t  n = (size_t)replica->rows * (size_t)replica->cols;
+	double        sum = 0.0;
+	size_t        s;
+	int           i, j;
+
+	for (i = 0; i < count; i++)
+		for (s = 1; s <= n; s++)
+			if (replica[i].black_histogram[s]) {
+				double  power = (double)replica[i].black_histogram[s];
+				for (j = 0; j < k; j++)
+					power *= (double)s;
+				sum += power;
+			}
+
+	return sum;
+}
+
+/* Do 'iters' more iterations, in replicas or tiles as requested;
+   'pool' is NULL without tiles. */
+static int run_iterations(cluster *const replica, const int threads, tile_pool *const pool, long iters)
+{
+	if (threads > 1)
+		return iterate_replicas(replica, threads, (iters > 0) ? iters : 0);
+
+	while (iters-->0)
+		if (pool) {
+			if (iterate_tiled(pool))
+				return ERR_NOMEM;
+		} else
+			iterate(replica);
+
+	return 0;
+}
+
+/* Root finding modes: where the spanning probability of black clusters,
+   or of white clusters, is one half, or where they are equal. */
+#define  PC_NONE      0
+#define  PC_BLACK     1
+#define  PC_WHITE     2
+#define  PC_CROSSING  3
+
+/* Steps of the stochastic root finding: the probability, and the mean
+   of the observable over the batch, which increases with p and is zero
+   at the root. */
+typedef struct {
+	double  *p;
+	double  *y;
+	long     count;
+	long     size;
+} pc_steps;
+
+/* Fit a line to the steps from 'first' on, and find where it is zero.
+   The variance of each step is at least 'var', if known.
+   Returns the half-width of the 95% confidence interval of the root
+   (to first order), or HUGE_VAL if the fit is not meaningful yet. */
+static double pc_fit(const pc_steps *const s, const long first, const double var,
+	double *const pc)
+{
+	const long  n = s->count - first;
+	double      p_mean = 0.0, y_mean = 0.0, sxx = 0.0, sxy = 0.0, ss = 0.0;
+	double      slope, var_step, var_mean, var_slope;
+	long        i;
+
+	if (n < 3)
+		return HUGE_VAL;
+
+	for (i = first; i < s->count; i++) {
+		p_mean += s->p[i];
+		y_mean += s->y[i];
+	}
+	p_mean /= (double)n;
+	y_mean /= (double)n;
+
+	for (i = first; i < s->count; i++) {
+		sxx += (s->p[i] - p_mean) * (s->p[i] - p_mean);
+		sxy += (s->p[i] - p_mean) * (s->y[i] - y_mean);
+	}
+	if (!(sxx > 0.0) || !(sxy > 0.0))
+		return HUGE_VAL;
+	slope = sxy / sxx;
+
+	for (i = first; i < s->count; i++) {
+		const double  r = s->y[i] - y_mean - slope * (s->p[i] - p_mean);
+		ss += r * r;
+	}
+
+	/* The mean and the slope are uncorrelated around p_mean. */
+	var_step = ss / (double)(n - 2);
+	if (var_step < var)
+		var_step = var;
+	var_mean = var_step / (double)n;
+	var_slope = var_step / sxx;
+
+	*pc = p_mean - y_mean / slope;
+	return Z_95 * sqrt(var_mean + (y_mean / slope) * (y_mean / slope) * var_slope) / slope;
+}
+
+/* Find p_c in [min, max] by Robbins-Monro iteration: each step runs a
+   batch of iterations at the current p, and moves p against the mean of
+   the observable, by a gain decreasing as step^-3/4. The iterates settle
+   around the root; a line fitted to the second half of the steps gives
+   p_c and its error. Stops when the error is below 'tolerance', or when
+   'iters' iterations are done. The replicas or tiles, and their generator
+   streams, are reused for all steps. */
+static int find_pc(cluster *const replica, const int threads, tile_pool *const pool, const int mode,
+	const double min, const double max, const double dw, const double db,
+	const long batch, const long iters, const double tolerance,
+	double *const pc, double *const error, long *const done)
+{
+	pc_steps  s = { NULL, NULL, 0, 0 };
+	double    p = 0.5 * (min + max);
+	double    lo = (min < max) ? min : max;
+	double    hi = (min < max) ? max : min;
+	int       result = 0;
+
+	*pc = p;
+	*error = HUGE_VAL;
+	*done = 0;
+
+	while (*done < iters) {
+		const long     now = (iters - *done > batch) ? batch : iters - *done;
+		cluster_count  white = 0, black = 0;
+		double         y;
+		int            k;
+
+		result = (threads > 1) ? reset_replicas(replica, threads, p, dw, db)
+		                       : reset_cluster(replica, p, dw, db);
+		if (!result)
+			result = run_iterations(replica, threads, pool, now);
+		if (result)
+			break;
+		*done += now;
+
+		for (k = 0; k < threads; k++) {
+			white += replica[k].white_spans;
+			black += replica[k].black_spans;
+		}
+		switch (mode) {
+		case PC_WHITE: y = 0.5 - (double)white / (double)now; break;
+		case PC_CROSSING: y = ((double)black - (double)white) / (double)now; break;
+		default: y = (double)black / (double)now - 0.5; break;
+		}
+
+		if (s.count >= s.size) {
+			const long  size = (s.size < 64) ? 64 : 2 * s.size;
+			double     *np = realloc(s.p, (size_t)size * sizeof s.p[0]);
+			double     *ny;
+			if (np)
+				s.p = np;
+			ny = realloc(s.y, (size_t)size * sizeof s.y[0]);
+			if (ny)
+				s.y = ny;
+			if (!np || !ny) {
+				result = ERR_NOMEM;
+				break;
+			}
+			s.size = size;
+		}
+		s.p[s.count] = p;
+		s.y[s.count] = y;
+		s.count++;
+
+		/* Robbins-Monro step, within the bracket. */
+		p -= (hi - lo) * y / pow((double)s.count, 0.75);
+		if (p < lo)
+			p = lo;
+		if (p > hi)
+			p = hi;
+
+		/* Near the root, a spanning probability in a batch has the
+		   binomial variance 1/(4 batch); the residuals of a few steps
+		   can be much smaller by chance. */
+		if (s.count >= 16) {
+			*error = pc_fit(&s, s.count / 2, (mode == PC_CROSSING) ? 0.0 : 0.25 / (double)batch, pc);
+			if (*error < tolerance)
+				break;
+		}
+	}
+
+	/* Without a fit, the latest iterate is the best guess. */
+	if (!(*error < HUGE_VAL))
+		*pc = p;
+
+	free(s.p);
+	free(s.y);
+	return result;
+}
 
 int usage(const char *argv0)
 {
@@ -23,13 +236,83 @@ int usage(const char *argv0)
 	fprintf(stderr, "       L=SIZE      Set rows=SIZE and cols=SIZE.\n");
 	fprintf(stderr, "       black=P     Set the probability of a cell to be black. Default is %g.\n", DEFAULT_P_BLACK);
 	fprintf(stderr, "                   All non-black cells are white.\n");
+	fprintf(stderr, "       black=MIN:MAX:STEP\n");
+	fprintf(stderr, "                   Sweep the probability from MIN to MAX, inclusive.\n");
+	fprintf(stderr, "                   dwhite and dblack can be swept the same way; all\n");
+	fprintf(stderr, "                   combinations are then computed in one run.\n");
 	fprintf(stderr, "       dwhite=P    Set the probability of white cells connecting diagonally.\n");
 	fprintf(stderr, "                   Default is %g.\n", DEFAULT_D_WHITE);
 	fprintf(stderr, "       dblack=P    Set the probability of black cells connecting diagonally.\n");
 	fprintf(stderr, "                   Default is %g.\n", DEFAULT_D_BLACK);
 	fprintf(stderr, "       N=COUNT     Number of iterations for gathering statistics. Default is %d.\n", DEFAULT_ITERS);
+	fprintf(stderr, "       tolerance=E Instead, run batches of iterations until the half-width of\n");
+	fprintf(stderr, "                   the 95%% Wilson confidence interval of the probability of\n");
+	fprintf(stderr, "                   a black cluster spanning the matrix is below E (0.01 for\n");
+	fprintf(stderr, "                   one percentage point), or N=COUNT iterations are done.\n");
+	fprintf(stderr, "                   Points far from the threshold then need far fewer.\n");
+	fprintf(stderr, "       moment=K    With tolerance=E, use the relative standard error of the\n");
+	fprintf(stderr, "                   mean of the K'th moment of the black cluster sizes per\n");
+	fprintf(stderr, "                   matrix, estimated from the batch means, instead.\n");
+	fprintf(stderr, "       pc=black    Find where a black cluster spans the matrix with probability\n");
+	fprintf(stderr, "                   one half, with black=MIN:MAX:STEP as the interval to search,\n");
+	fprintf(stderr, "                   instead of sweeping it. Each step runs a batch of iterations,\n");
+	fprintf(stderr, "                   and moves the probability by a decreasing gain (Robbins-Monro);\n");
+	fprintf(stderr, "                   a line fitted to the later steps gives the result and its\n");
+	fprintf(stderr, "                   95%% error. Runs until the error is below tolerance=E, or for\n");
+	fprintf(stderr, "                   N=COUNT iterations. pc=white finds where a white cluster\n");
+	fprintf(stderr, "                   spans with probability one half, and pc=crossing where the\n");
+	fprintf(stderr, "                   black and white spanning probabilities are equal.\n");
+	fprintf(stderr, "       batch=COUNT Number of iterations per batch with tolerance=E or pc.\n");
+	fprintf(stderr, "                   Default is %d.\n", DEFAULT_BATCH);
 	fprintf(stderr, "       seed=U64    Set the Xorshift64* pseudorandom number generator seed; nonzero.\n");
 	fprintf(stderr, "                   Default is to pick one randomly (based on time).\n");
+	fprintf(stderr, "       rng=counter Use a counter-based generator instead: each cell of each\n");
+	fprintf(stderr, "                   matrix gets its own numbers from the seed, the number of\n");
+	fprintf(stderr, "                   the matrix (realization), and the cell's row and column.\n");
+	fprintf(stderr, "                   The results then do not depend on threads=K, and a single\n");
+	fprintf(stderr, "                   matrix is reproduced with seed, realization=K, and N=1.\n");
+	fprintf(stderr, "                   Default is rng=xorshift.\n");
+	fprintf(stderr, "       realization=K\n");
+	fprintf(stderr, "                   Number of the first matrix with rng=counter. Each point of\n");
+	fprintf(stderr, "                   a sweep continues after the previous one. Default is 0.\n");
+	fprintf(stderr, "       coupled=yes With rng=counter, use the same matrices for every point of\n");
+	fprintf(stderr, "                   black=MIN:MAX:STEP, and compute all points at once. As\n");
+	fprintf(stderr, "                   black increases, cells only turn black, so the black\n");
+	fprintf(stderr, "                   clusters are built by joining the new black cells at each\n");
+	fprintf(stderr, "                   point, and the white clusters likewise from the last point\n");
+	fprintf(stderr, "                   down; a point costs a small fraction of a full labelling,\n");
+	fprintf(stderr, "                   and the curves are much smoother. The results at each point\n");
+	fprintf(stderr, "                   are those of black=P with the same seed and realization=K.\n");
+	fprintf(stderr, "                   Needs boundary=open, and cannot be combined with threads=K,\n");
+	fprintf(stderr, "                   tiles=K, tolerance=E or pc. Default is coupled=no.\n");
+	fprintf(stderr, "       threads=K   Split the iterations among K independent replicas,\n");
+	fprintf(stderr, "                   each in its own thread. Default is %d.\n", DEFAULT_THREADS);
+	fprintf(stderr, "       tiles=K     Label each matrix in K tiles of consecutive rows, each in\n");
+	fprintf(stderr, "                   its own thread, for very large matrices. The results are\n");
+	fprintf(stderr, "                   the same as without tiles. Needs rng=counter, and cannot\n");
+	fprintf(stderr, "                   be combined with threads=K. Default is 1.\n");
+	fprintf(stderr, "       span=MODE   Set the spanning criterion: horizontal (left to right),\n");
+	fprintf(stderr, "                   vertical (top to bottom), either (the default), or both\n");
+	fprintf(stderr, "                   (the same cluster left to right and top to bottom).\n");
+	fprintf(stderr, "       boundary=periodic\n");
+	fprintf(stderr, "                   Wrap the matrix around in both directions, joining cells\n");
+	fprintf(stderr, "                   on opposite edges. A cluster then spans the matrix if it\n");
+	fprintf(stderr, "                   wraps around. Default is boundary=open.\n");
+	fprintf(stderr, "       euler=yes   Also print the mean and variance of the Euler number\n");
+	fprintf(stderr, "                   (clusters minus holes) of the white and of the black\n");
+	fprintf(stderr, "                   cells. Default is euler=no.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "For each point, the output has one line with the black probability and\n");
+	fprintf(stderr, "the percentage of iterations where a black cluster spanned the matrix:\n");
+	fprintf(stderr, "   BLACK : PERCENT%%\n");
+	fprintf(stderr, "If dwhite or dblack is swept, the line begins with BLACK DWHITE DBLACK.\n");
+	fprintf(stderr, "With euler=yes, the line continues with\n");
+	fprintf(stderr, "   WHITE_EULER WHITE_VARIANCE BLACK_EULER BLACK_VARIANCE\n");
+	fprintf(stderr, "With tolerance=E, the line ends with the error reached and the number of\n");
+	fprintf(stderr, "iterations done; the error of the spanning probability is in percent.\n");
+	fprintf(stderr, "With pc, the output has one line for each DWHITE and DBLACK,\n");
+	fprintf(stderr, "   P_C ERROR ITERATIONS\n");
+	fprintf(stderr, "which begins with DWHITE DBLACK : if either is swept.\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "The output consists of comment lines and data lines.\n");
 	fprintf(stderr, "Comment lines begin with a #:\n");
@@ -46,20 +329,37 @@ int main(int argc, char *argv[])
 {
 	int      rows = DEFAULT_ROWS;
 	int      cols = DEFAULT_COLS;
-	double   p_black = DEFAULT_P_BLACK;
-	double   d_white = DEFAULT_D_WHITE;
-	double   d_black = DEFAULT_D_BLACK;
+	sweep    p_black = { DEFAULT_P_BLACK, DEFAULT_P_BLACK, 0.0 };
+	sweep    d_white = { DEFAULT_D_WHITE, DEFAULT_D_WHITE, 0.0 };
+	sweep    d_black = { DEFAULT_D_BLACK, DEFAULT_D_BLACK, 0.0 };
+	long     pi, wi, bi;
 	long     iters = DEFAULT_ITERS;
+	long     batch = DEFAULT_BATCH;
+	double   tolerance = 0.0;
+	int      moment = 0;
+	int      iters_given = 0;
+	int      pc_mode = PC_NONE;
+	int      threads = DEFAULT_THREADS;
+	int      tiles = 1;
+	int      span_mode = CLUSTER_SPAN_EITHER;
+	int      boundary = CLUSTER_BOUNDARY_OPEN;
+	int      euler = 0;
+	int      coupled_sweep = 0;
+	int      rng_mode = CLUSTER_RNG_SEQUENTIAL;
+	uint64_t realization = 0;
 	uint64_t seed = 0;
 	cluster  c = CLUSTER_INITIALIZER;
+	cluster *replica = &c;
+	coupled  cs = COUPLED_INITIALIZER;
+	tile_pool tp = TILE_POOL_INITIALIZER;
+	double  *cs_p = NULL;
 
-	int      arg, itemp;
+	int      arg, itemp, result;
 	uint64_t u64temp;
-	double   dtemp;
 	long     ltemp;
+	double   dtemp;
 	char     dummy;
 
-	size_t   n;
 	size_t   i;
 
 	if (argc < 2)
@@ -69,124 +369,407 @@ int main(int argc, char *argv[])
 		if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
 			return usage(argv[0]);
 		else
-			if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
-				sscanf(argv[arg], "l=%d %c", &itemp, &dummy) == 1 ||
-				sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
-				rows = itemp;
-				cols = itemp;
+		if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "l=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
+			rows = itemp;
+			cols = itemp;
+		} else
+		if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+			sscanf(argv[arg], "seed=%" SCNx64 " %c", &u64temp, &dummy) == 1 ||
+			sscanf(argv[arg], "s=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+			sscanf(argv[arg], "s=%" SCNx64 " %c", &u64temp, &dummy) == 1) {
+			seed = u64temp;
+		} else
+		if (sscanf(argv[arg], "realization=%" SCNu64 " %c", &u64temp, &dummy) == 1) {
+			realization = u64temp;
+		} else
+		if (!strcmp(argv[arg], "rng=counter")) {
+			rng_mode = CLUSTER_RNG_COUNTER;
+		} else
+		if (!strcmp(argv[arg], "rng=xorshift") || !strcmp(argv[arg], "rng=sequential")) {
+			rng_mode = CLUSTER_RNG_SEQUENTIAL;
+		} else
+		if (sscanf(argv[arg], "N=%ld %c", &ltemp, &dummy) == 1 ||
+			sscanf(argv[arg], "n=%ld %c", &ltemp, &dummy) == 1 ||
+			sscanf(argv[arg], "count=%ld %c", &ltemp, &dummy) == 1) {
+			iters = ltemp;
+			iters_given = 1;
+		} else
+		if (sscanf(argv[arg], "tolerance=%lf %c", &dtemp, &dummy) == 1 ||
+			sscanf(argv[arg], "tol=%lf %c", &dtemp, &dummy) == 1) {
+			if (!(dtemp > 0.0)) {
+				fprintf(stderr, "%s: Invalid tolerance.\n", argv[arg]);
+				return EXIT_FAILURE;
+			}
+			tolerance = dtemp;
+		} else
+		if (sscanf(argv[arg], "moment=%d %c", &itemp, &dummy) == 1) {
+			if (itemp < 1) {
+				fprintf(stderr, "%s: Invalid moment.\n", argv[arg]);
+				return EXIT_FAILURE;
+			}
+			moment = itemp;
+		} else
+		if (!strcmp(argv[arg], "pc=black") || !strcmp(argv[arg], "pc=1")) {
+			pc_mode = PC_BLACK;
+		} else
+		if (!strcmp(argv[arg], "pc=white") || !strcmp(argv[arg], "pc=0")) {
+			pc_mode = PC_WHITE;
+		} else
+		if (!strcmp(argv[arg], "pc=crossing") || !strcmp(argv[arg], "pc=cross")) {
+			pc_mode = PC_CROSSING;
+		} else
+		if (sscanf(argv[arg], "batch=%ld %c", &ltemp, &dummy) == 1) {
+			if (ltemp < 1) {
+				fprintf(stderr, "%s: Invalid batch size.\n", argv[arg]);
+				return EXIT_FAILURE;
 			}
-			else
-				if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
-					sscanf(argv[arg], "seed=%" SCNx64 " %c", &u64temp, &dummy) == 1 ||
-					sscanf(argv[arg], "s=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
-					sscanf(argv[arg], "s=%" SCNx64 " %c", &u64temp, &dummy) == 1) {
-					seed = u64temp;
+			batch = ltemp;
+		} else
+		if (sscanf(argv[arg], "rows=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "r=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "height=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "h=%d %c", &itemp, &dummy) == 1) {
+			rows = itemp;
+		} else
+		if (sscanf(argv[arg], "columns=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "cols=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "c=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "width=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "w=%d %c", &itemp, &dummy) == 1) {
+			cols = itemp;
+		} else
+		if (parse_sweep(argv[arg], "black", &p_black) ||
+			parse_sweep(argv[arg], "p0", &p_black) ||
+			parse_sweep(argv[arg], "b", &p_black) ||
+			parse_sweep(argv[arg], "P", &p_black) ||
+			parse_sweep(argv[arg], "p", &p_black)) {
+			/* Already parsed. */
+		} else
+		if (parse_sweep(argv[arg], "white", &p_black) ||
+			parse_sweep(argv[arg], "p1", &p_black)) {
+			p_black.min = 1.0 - p_black.min;
+			p_black.max = 1.0 - p_black.max;
+			p_black.step = -p_black.step;
+		} else
+		if (parse_sweep(argv[arg], "dwhite", &d_white) ||
+			parse_sweep(argv[arg], "dw", &d_white) ||
+			parse_sweep(argv[arg], "d0", &d_white)) {
+			/* Already parsed. */
+		} else
+		if (parse_sweep(argv[arg], "dblack", &d_black) ||
+			parse_sweep(argv[arg], "db", &d_black) ||
+			parse_sweep(argv[arg], "d1", &d_black)) {
+			/* Already parsed. */
+		} else
+		if (sscanf(argv[arg], "threads=%d %c", &itemp, &dummy) == 1 ||
+			sscanf(argv[arg], "t=%d %c", &itemp, &dummy) == 1) {
+			if (itemp < 1) {
+				fprintf(stderr, "%s: Invalid number of threads.\n", argv[arg]);
+				return EXIT_FAILURE;
+			}
+			threads = itemp;
+		} else
+		if (sscanf(argv[arg], "tiles=%d %c", &itemp, &dummy) == 1) {
+			if (itemp < 1) {
+				fprintf(stderr, "%s: Invalid number of tiles.\n", argv[arg]);
+				return EXIT_FAILURE;
+			}
+			tiles = itemp;
+		} else
+		if ((result = parse_cluster_option(argv[arg], &span_mode, &boundary, &euler))) {
+			if (result < 0)
+				return EXIT_FAILURE;
+		} else
+		if (!strcmp(argv[arg], "coupled=yes") || !strcmp(argv[arg], "coupled=1")) {
+			coupled_sweep = 1;
+		} else
+		if (!strcmp(argv[arg], "coupled=no") || !strcmp(argv[arg], "coupled=0")) {
+			coupled_sweep = 0;
+		} else {
+			fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
+			return EXIT_FAILURE;
+		}
+
+	if (tiles > 1 && rng_mode != CLUSTER_RNG_COUNTER) {
+		fprintf(stderr, "tiles=%d: Needs rng=counter.\n", tiles);
+		return EXIT_FAILURE;
+	}
+	if (tiles > 1 && threads > 1) {
+		fprintf(stderr, "tiles=%d: Cannot be combined with threads=%d.\n", tiles, threads);
+		return EXIT_FAILURE;
+	}
+
+	if (coupled_sweep) {
+		if (rng_mode != CLUSTER_RNG_COUNTER) {
+			fprintf(stderr, "coupled=yes: Needs rng=counter.\n");
+			return EXIT_FAILURE;
+		}
+		if (boundary != CLUSTER_BOUNDARY_OPEN) {
+			fprintf(stderr, "coupled=yes: Needs boundary=open.\n");
+			return EXIT_FAILURE;
+		}
+		if (threads > 1 || tiles > 1 || tolerance > 0.0 || pc_mode != PC_NONE) {
+			fprintf(stderr, "coupled=yes: Cannot be combined with threads=K, tiles=K, tolerance=E or pc.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* Without N=COUNT, an adaptive run has no iteration limit. */
+	if (tolerance > 0.0 && !iters_given)
+		iters = LONG_MAX;
+	if (moment > 0 && tolerance <= 0.0) {
+		fprintf(stderr, "moment=%d: Needs tolerance=E.\n", moment);
+		return EXIT_FAILURE;
+	}
+	if (pc_mode != PC_NONE) {
+		if (p_black.step == 0.0) {
+			fprintf(stderr, "pc: Needs black=MIN:MAX:STEP as the interval to search.\n");
+			return EXIT_FAILURE;
+		}
+		if (tolerance <= 0.0 && !iters_given) {
+			fprintf(stderr, "pc: Needs tolerance=E or N=COUNT.\n");
+			return EXIT_FAILURE;
+		}
+		if (moment > 0) {
+			fprintf(stderr, "pc: Cannot be combined with moment=K.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!seed)
+		seed = randomize(NULL);
+
+	if (threads > 1) {
+		replica = (cluster*)malloc((size_t)threads * sizeof(cluster));
+		if (!replica) {
+			fprintf(stderr, "Not enough memory.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	switch ((threads > 1) ? init_replicas(replica, threads, rows, cols, p_black.min, d_white.min, d_black.min, seed)
+	                      : init_cluster(&c, rows, cols, p_black.min, d_white.min, d_black.min)) {
+	case 0: break; /* OK */
+	case ERR_INVALID:
+		fprintf(stderr, "Invalid size.\n");
+		return EXIT_FAILURE;
+	case ERR_TOOLARGE:
+		fprintf(stderr, "Size is too large.\n");
+		return EXIT_FAILURE;
+	case ERR_NOMEM:
+		fprintf(stderr, "Not enough memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (threads < 2)
+		c.rng.state = seed;
+
+	for (i = 0; i < (size_t)threads; i++) {
+		replica[i].span_mode = span_mode;
+		replica[i].rng_mode = rng_mode;
+		replica[i].rng_seed = seed;
+		replica[i].realization = realization;
+		switch (set_cluster_boundary(replica + i, boundary)) {
+		case 0: break; /* OK */
+		case ERR_TOOLARGE:
+			fprintf(stderr, "Size is too large for periodic boundaries.\n");
+			return EXIT_FAILURE;
+		default:
+			fprintf(stderr, "Not enough memory.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* The tile threads are started once, and reused for all points. */
+	if (tiles > 1 && init_tile_pool(&tp, &c, tiles)) {
+		fprintf(stderr, "Not enough memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (coupled_sweep) {
+		const long  points = sweep_points(&p_black);
+
+		switch (init_coupled(&cs, rows, cols, (size_t)points)) {
+		case 0: break; /* OK */
+		case ERR_TOOLARGE:
+			fprintf(stderr, "Size is too large.\n");
+			return EXIT_FAILURE;
+		default:
+			fprintf(stderr, "Not enough memory.\n");
+			return EXIT_FAILURE;
+		}
+		cs_p = (double*)malloc((size_t)points * sizeof(double));
+		if (!cs_p) {
+			fprintf(stderr, "Not enough memory.\n");
+			return EXIT_FAILURE;
+		}
+
+		/* The points in increasing order of black. */
+		for (ltemp = 0; ltemp < points; ltemp++)
+			cs_p[ltemp] = sweep_value(&p_black, (p_black.step < 0.0) ? points - 1 - ltemp : ltemp);
+
+		cs.span_mode = span_mode;
+		cs.rng_seed = seed;
+	}
+
+	/* Print the comments describing the initial parameters. */
+	//printf("# seed: %" PRIu64 " (Xorshift 64*)\n", seed);
+	//printf("# size: %d rows, %d columns\n", rows, cols);
+	//printf("# P(black): %.6f (%" PRIu64 "/18446744073709551615)\n", p_black, c.p_black);
+	//printf("# P(black connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_black, c.d_black);
+	//printf("# P(white connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_white, c.d_white);
+	fflush(stdout);
+
+	/* All points reuse the same allocations and generator streams. */
+	for (wi = 0; wi < sweep_points(&d_white); wi++)
+	for (bi = 0; bi < sweep_points(&d_black); bi++)
+	for (pi = 0; pi < ((pc_mode != PC_NONE) ? 1 : sweep_points(&p_black)); pi++) {
+		const double  p = sweep_value(&p_black, pi);
+		const double  dw = sweep_value(&d_white, wi);
+		const double  db = sweep_value(&d_black, bi);
+
+		long          done = 0;
+		double        error = 0.0;
+
+		/* Root finding replaces the sweep over black. */
+		if (pc_mode != PC_NONE) {
+			double  pc;
+
+			if (find_pc(replica, threads, (tiles > 1) ? &tp : NULL, pc_mode, p_black.min, p_black.max, dw, db,
+			            batch, iters, tolerance, &pc, &error, &done)) {
+				fprintf(stderr, (threads > 1) ? "Cannot run replicas.\n" : "Not enough memory.\n");
+				return EXIT_FAILURE;
+			}
+			if (d_white.step != 0.0 || d_black.step != 0.0)
+				printf("%.6f %.6f : ", dw, db);
+			printf("%.6f %.6f %ld\n", pc, error, done);
+			fflush(stdout);
+			continue;
+		}
+
+		/* Batch means of the moment, with tolerance=E and moment=K. */
+		double        moment_prev = 0.0;
+		double        moment_sum = 0.0;
+		double        moment_sum2 = 0.0;
+		long          batches = 0;
+
+		if (threads > 1) {
+			if (reset_replicas(replica, threads, p, dw, db)) {
+				fprintf(stderr, "Cannot run replicas.\n");
+				return EXIT_FAILURE;
+			}
+		} else
+			reset_cluster(&c, p, dw, db);
+
+		/* A coupled sweep does all points of black at the first one,
+		   over the same realizations each time. */
+		if (coupled_sweep) {
+			if (pi == 0) {
+				if (reset_coupled(&cs, cs_p, dw, db)) {
+					fprintf(stderr, "Invalid sweep.\n");
+					return EXIT_FAILURE;
 				}
-				else
-					if (sscanf(argv[arg], "N=%ld %c", &ltemp, &dummy) == 1 ||
-						sscanf(argv[arg], "n=%ld %c", &ltemp, &dummy) == 1 ||
-						sscanf(argv[arg], "count=%ld %c", &ltemp, &dummy) == 1) {
-						iters = ltemp;
+				cs.realization = realization;
+				for (ltemp = 0; ltemp < iters; ltemp++)
+					iterate_coupled(&cs);
+			}
+			coupled_stats(&cs, (size_t)((p_black.step < 0.0) ? sweep_points(&p_black) - 1 - pi : pi), &c);
+			done = iters;
+		}
+
+		/* Without tolerance=E, all iterations are done in one batch. */
+		do {
+			const long  now = (tolerance > 0.0 && iters - done > batch) ? batch : iters - done;
+
+			if (run_iterations(replica, threads, (tiles > 1) ? &tp : NULL, now)) {
+				fprintf(stderr, (threads > 1) ? "Cannot run replicas.\n" : "Not enough memory.\n");
+				return EXIT_FAILURE;
+			}
+			done += now;
+
+			if (tolerance > 0.0 && now > 0) {
+				if (moment > 0) {
+					const double  total = black_moment(replica, threads, moment);
+					const double  mean = (total - moment_prev) / (double)now;
+
+					moment_prev = total;
+					moment_sum += mean;
+					moment_sum2 += mean * mean;
+					batches++;
+
+					/* The standard error needs a few batches to be meaningful. */
+					if (batches < 4 || moment_sum <= 0.0)
+						error = HUGE_VAL;
+					else {
+						const double  avg = moment_sum / (double)batches;
+						const double  var = (moment_sum2 - (double)batches * avg * avg) / (double)(batches - 1);
+						error = sqrt(((var > 0.0) ? var : 0.0) / (double)batches) / avg;
+					}
+				} else {
+					cluster_count  spans = 0, count = 0;
+					int            k;
+
+					for (k = 0; k < threads; k++) {
+						spans += replica[k].black_spans;
+						count += replica[k].iterations;
 					}
-					else
-						if (sscanf(argv[arg], "rows=%d %c", &itemp, &dummy) == 1 ||
-							sscanf(argv[arg], "r=%d %c", &itemp, &dummy) == 1 ||
-							sscanf(argv[arg], "height=%d %c", &itemp, &dummy) == 1 ||
-							sscanf(argv[arg], "h=%d %c", &itemp, &dummy) == 1) {
-							rows = itemp;
-						}
-						else
-							if (sscanf(argv[arg], "columns=%d %c", &itemp, &dummy) == 1 ||
-								sscanf(argv[arg], "cols=%d %c", &itemp, &dummy) == 1 ||
-								sscanf(argv[arg], "c=%d %c", &itemp, &dummy) == 1 ||
-								sscanf(argv[arg], "width=%d %c", &itemp, &dummy) == 1 ||
-								sscanf(argv[arg], "w=%d %c", &itemp, &dummy) == 1) {
-								cols = itemp;
-							}
-							else
-								if (sscanf(argv[arg], "black=%lf %c", &dtemp, &dummy) == 1 ||
-									sscanf(argv[arg], "p0=%lf %c", &dtemp, &dummy) == 1 ||
-									sscanf(argv[arg], "b=%lf %c", &dtemp, &dummy) == 1 ||
-									sscanf(argv[arg], "P=%lf %c", &dtemp, &dummy) == 1 ||
-									sscanf(argv[arg], "p0=%lf %c", &dtemp, &dummy) == 1 ||
-									sscanf(argv[arg], "p=%lf %c", &dtemp, &dummy) == 1) {
-									p_black = dtemp;
-								}
-								else
-									if (sscanf(argv[arg], "white=%lf %c", &dtemp, &dummy) == 1 ||
-										sscanf(argv[arg], "p1=%lf %c", &dtemp, &dummy) == 1) {
-										p_black = 1.0 - dtemp;
-									}
-									else
-										if (sscanf(argv[arg], "dwhite=%lf %c", &dtemp, &dummy) == 1 ||
-											sscanf(argv[arg], "dw=%lf %c", &dtemp, &dummy) == 1 ||
-											sscanf(argv[arg], "d0=%lf %c", &dtemp, &dummy) == 1) {
-											d_white = dtemp;
-										}
-										else
-											if (sscanf(argv[arg], "dblack=%lf %c", &dtemp, &dummy) == 1 ||
-												sscanf(argv[arg], "db=%lf %c", &dtemp, &dummy) == 1 ||
-												sscanf(argv[arg], "d1=%lf %c", &dtemp, &dummy) == 1) {
-												d_black = dtemp;
-											}
-											else {
-												fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
-												return EXIT_FAILURE;
-											}
-
-											switch (init_cluster(&c, rows, cols, p_black, d_white, d_black)) {
-											case 0: break; /* OK */
-											case ERR_INVALID:
-												fprintf(stderr, "Invalid size.\n");
-												return EXIT_FAILURE;
-											case ERR_TOOLARGE:
-												fprintf(stderr, "Size is too large.\n");
-												return EXIT_FAILURE;
-											case ERR_NOMEM:
-												fprintf(stderr, "Not enough memory.\n");
-												return EXIT_FAILURE;
-											}
-
-											if (!seed)
-												seed = randomize(NULL);
-
-											c.rng.state = seed;
-
-											/* The largest possible cluster has n cells. */
-											n = (size_t)rows * (size_t)cols;
-
-											/* Print the comments describing the initial parameters. */
-											//printf("# seed: %" PRIu64 " (Xorshift 64*)\n", seed);
-											//printf("# size: %d rows, %d columns\n", rows, cols);
-											//printf("# P(black): %.6f (%" PRIu64 "/18446744073709551615)\n", p_black, c.p_black);
-											//printf("# P(black connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_black, c.d_black);
-											//printf("# P(white connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_white, c.d_white);
-											fflush(stdout);
-
-											while (iters-->0)
-												iterate(&c);
-
-											//printf("# Iterations: %" PRIu64 "\n", c.iterations);
-											//printf("#\n");
-											//printf("# %" FMT_COUNT " times at least one white cluster spanned the matrix (%.6f%%)\n",
-												//c.white_spans, 100.0 * (double)c.white_spans / (double)c.iterations);
-											printf("%.6f : %.6f%%\n", p_black, 100.0 * (double)c.black_spans / (double)c.iterations);
-											//printf("#\n");
-											//printf("# size  white_clusters(size) black_clusters(size) clusters(size)\n");
-
-											/* Note: c._histogram[0] == c._histogram[n] == 0, for ease of scanning. */
-											/*for (i = 1; i <= n; i++)
-												if (c.white_histogram[i - 1] || c.white_histogram[i] || c.white_histogram[i + 1] ||
-													c.black_histogram[i - 1] || c.black_histogram[i] || c.black_histogram[i + 1])
-													printf("%lu %" FMT_COUNT " %" FMT_COUNT " %" FMT_COUNT "\n",
-													(unsigned long)i,
-														c.white_histogram[i],
-														c.black_histogram[i],
-														c.white_histogram[i] + c.black_histogram[i]);*/
-
-											/* Since we are exiting anyway, this is not really necessary. */
-											free_cluster(&c);
-
-											/* All done. */
-											return EXIT_SUCCESS;
+					error = wilson_error((double)spans, (double)count);
+				}
+			}
+		} while (tolerance > 0.0 && done < iters && error >= tolerance);
+
+		if (threads > 1) {
+			if (merge_replicas(replica, threads)) {
+				fprintf(stderr, "Cannot run replicas.\n");
+				return EXIT_FAILURE;
+			}
+			c = replica[0];
+		}
+
+		//printf("# Iterations: %" PRIu64 "\n", c.iterations);
+		//printf("#\n");
+		//printf("# %" FMT_COUNT " times at least one white cluster spanned the matrix (%.6f%%)\n",
+			//c.white_spans, 100.0 * (double)c.white_spans / (double)c.iterations);
+		if (d_white.step != 0.0 || d_black.step != 0.0)
+			printf("%.6f %.6f %.6f : %.6f%%", p, dw, db, 100.0 * (double)c.black_spans / (double)c.iterations);
+		else
+			printf("%.6f : %.6f%%", p, 100.0 * (double)c.black_spans / (double)c.iterations);
+		if (euler)
+			print_euler(stdout, c.iterations, c.white_euler, c.black_euler, c.white_euler2, c.black_euler2);
+		if (tolerance > 0.0)
+			printf(" %.6f %" FMT_COUNT, (moment > 0) ? error : 100.0 * error, c.iterations);
+		printf("\n");
+#ifdef CLUSTER_PROFILE
+		print_cluster_profile(stdout, &c);
+#endif
+		fflush(stdout);
+	}
+
+	//printf("#\n");
+	//printf("# size  white_clusters(size) black_clusters(size) clusters(size)\n");
+
+	/* Note: c._histogram[0] == c._histogram[n] == 0, for ease of scanning. */
+	/*for (i = 1; i <= n; i++)
+		if (c.white_histogram[i - 1] || c.white_histogram[i] || c.white_histogram[i + 1] ||
+			c.black_histogram[i - 1] || c.black_histogram[i] || c.black_histogram[i + 1])
+			printf("%lu %" FMT_COUNT " %" FMT_COUNT " %" FMT_COUNT "\n",
+			(unsigned long)i,
+				c.white_histogram[i],
+				c.black_histogram[i],
+				c.white_histogram[i] + c.black_histogram[i]);*/
+
+	/* Since we are exiting anyway, this is not really necessary. */
+	if (threads > 1) {
+		free_replicas(replica, threads);
+		free(replica);
+	} else
+		free_cluster(&c);
+	free_tile_pool(&tp);
+	free_coupled(&cs);
+	free(cs_p);
+
+	/* All done. */
+	return EXIT_SUCCESS;
 }
@@ -0,0 +1,1057 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#ifdef ENSEMBLE_MPI
+#include <mpi.h>
+#endif
+#include "clusters_modified.h"
+#include "options.h"
+#include "bsd.h"
+
+#define  DEFAULT_ROWS     100
+#define  DEFAULT_COLS     100
+#define  DEFAULT_P_BLACK  0.0
+#define  DEFAULT_D_WHITE  0.0
+#define  DEFAULT_D_BLACK  0.0
+#define  DEFAULT_ITERS    1
+#define  DEFAULT_BLOCK    100
+#define  DEFAULT_WORKERS  1
+#define  DEFAULT_TIMEOUT  0
+
+/* MPI does not tell when a rank dies; its unit is only reassigned when
+   the rank has not responded in time. */
+#define  DEFAULT_MPI_TIMEOUT  600
+
+/* A result message from a worker is a header of UNIT_FIELDS 8-byte
+   little-endian fields,
+
+       unit iterations white_spans black_spans
+       white_euler black_euler white_euler2 black_euler2
+       entries bytes
+
+   with the signed sums as two's complement and the sums of squares as
+   IEEE-754 double bit patterns, followed by 'bytes' bytes of 'entries'
+   (size, white, black) varint triples, as in the payload of bsd.h.
+   The coordinator sends a worker the number of the next unit as a single
+   8-byte field, or UNIT_STOP. */
+#define  UNIT_FIELDS  10
+#define  UNIT_HEADER  (8 * UNIT_FIELDS)
+#define  UNIT_STOP    (~(uint64_t)0)
+
+#define  UNIT_PENDING   0
+#define  UNIT_ASSIGNED  1
+#define  UNIT_DONE      2
+
+#ifdef ENSEMBLE_MPI
+#define  TAG_UNIT    1
+#define  TAG_RESULT  2
+#endif
+
+/* The run, as given on the command line. Every worker has the same. */
+typedef struct {
+    int       rows;
+    int       cols;
+    sweep     p_black;
+    sweep     d_white;
+    sweep     d_black;
+    long      iters;
+    long      block;
+    uint64_t  seed;
+    uint64_t  realization;
+    int       span_mode;
+    int       boundary;
+} ensemble;
+
+/* The statistics of one unit, or summed over the units of a point. */
+typedef struct {
+    uint64_t  unit;
+    uint64_t  iterations;
+    uint64_t  white_spans;
+    uint64_t  black_spans;
+    int64_t   white_euler;
+    int64_t   black_euler;
+    double    white_euler2;
+    double    black_euler2;
+    uint64_t  entries;
+    uint64_t  bytes;
+} unit_result;
+
+/* A point of the sweep, while its units are being collected. */
+typedef struct {
+    unit_result     sum;
+    cluster_count  *white;      /* Histograms, allocated at the first result */
+    cluster_count  *black;
+    long            done;       /* Number of units done */
+} ensemble_point;
+
+/* A worker process or MPI rank, and the unit it is working on. */
+typedef struct {
+    int       alive;
+    uint64_t  unit;             /* UNIT_STOP if idle */
+    time_t    started;
+    pid_t     pid;              /* Local worker processes */
+    int       to;
+    int       from;
+    int       rank;             /* MPI ranks */
+} ensemble_worker;
+
+/* Number of units per point. */
+static long ensemble_blocks(const ensemble *const e)
+{
+    return (e->iters + e->block - 1) / e->block;
+}
+
+/* Number of points, in the same order as in distribution_modified:
+   black varies fastest, then dblack, then dwhite. */
+static long ensemble_points(const ensemble *const e)
+{
+    return sweep_points(&e->p_black) * sweep_points(&e->d_black) * sweep_points(&e->d_white);
+}
+
+/* Probabilities at a point. */
+static void ensemble_point_values(const ensemble *const e, const long point,
+                                  double *const p, double *const dw, double *const db)
+{
+    const long  np = sweep_points(&e->p_black);
+    const long  nb = sweep_points(&e->d_black);
+
+    *p = sweep_value(&e->p_black, point % np);
+    *db = sweep_value(&e->d_black, (point / np) % nb);
+    *dw = sweep_value(&e->d_white, point / np / nb);
+}
+
+/* Do the iterations of a unit. Unit u is block (u % blocks) of point
+   (u / blocks); each point continues from the realizations of the
+   previous one, as in distribution_modified with rng=counter, so the
+   statistics do not depend on which worker does which unit. */
+static int run_unit(cluster *const c, const ensemble *const e, const uint64_t unit)
+{
+    const long  blocks = ensemble_blocks(e);
+    const long  point = (long)(unit / (uint64_t)blocks);
+    const long  first = (long)(unit % (uint64_t)blocks) * e->block;
+    long        count = (e->iters - first < e->block) ? e->iters - first : e->block;
+    double      p, dw, db;
+    int         result;
+
+    ensemble_point_values(e, point, &p, &dw, &db);
+
+    result = reset_cluster(c, p, dw, db);
+    if (result)
+        return result;
+
+    c->realization = e->realization + (uint64_t)point * (uint64_t)e->iters + (uint64_t)first;
+    while (count-->0)
+        iterate(c);
+
+    return 0;
+}
+
+/* Encode the statistics of a unit into a result message in '*buffer',
+   growing it as needed. Returns the message length, or 0 if out of memory. */
+static size_t encode_unit(const cluster *const c, const uint64_t unit,
+                          unsigned char **const buffer, size_t *const size)
+{
+    const size_t    n = (size_t)c->rows * (size_t)c->cols;
+    unsigned char  *ptr, *h;
+    uint64_t        prev = 0;
+    size_t          entries = 0, i;
+
+    for (i = 1; i <= n; i++)
+        entries += (c->white_histogram[i] || c->black_histogram[i]);
+
+    /* Each triple takes at most three ten-byte varints. */
+    if (*size < UNIT_HEADER + 30 * entries) {
+        unsigned char *const  temp = realloc(*buffer, UNIT_HEADER + 30 * entries);
+        if (!temp)
+            return 0;
+        *buffer = temp;
+        *size = UNIT_HEADER + 30 * entries;
+    }
+
+    ptr = *buffer + UNIT_HEADER;
+    for (i = 1; i <= n; i++)
+        if (c->white_histogram[i] || c->black_histogram[i]) {
+            ptr = bsd_put_varint(ptr, (uint64_t)i - prev);
+            ptr = bsd_put_varint(ptr, c->white_histogram[i]);
+            ptr = bsd_put_varint(ptr, c->black_histogram[i]);
+            prev = i;
+        }
+
+    h = *buffer;
+    h = bsd_put_u64(h, unit);
+    h = bsd_put_u64(h, c->iterations);
+    h = bsd_put_u64(h, c->white_spans);
+    h = bsd_put_u64(h, c->black_spans);
+    h = bsd_put_u64(h, (uint64_t)c->white_euler);
+    h = bsd_put_u64(h, (uint64_t)c->black_euler);
+    h = bsd_put_u64(h, bsd_double_bits(c->white_euler2));
+    h = bsd_put_u64(h, bsd_double_bits(c->black_euler2));
+    h = bsd_put_u64(h, entries);
+    h = bsd_put_u64(h, (uint64_t)(ptr - *buffer) - UNIT_HEADER);
+
+    return (size_t)(ptr - *buffer);
+}
+
+/* Decode the header of a result message. Returns 0 if successful. */
+static int decode_unit(const unsigned char *const buffer, const size_t length,
+                       unit_result *const r)
+{
+    if (length < UNIT_HEADER)
+        return BSD_ERR_FORMAT;
+
+    r->unit = bsd_get_u64(buffer);
+    r->iterations = bsd_get_u64(buffer + 8);
+    r->white_spans = bsd_get_u64(buffer + 16);
+    r->black_spans = bsd_get_u64(buffer + 24);
+    r->white_euler = (int64_t)bsd_get_u64(buffer + 32);
+    r->black_euler = (int64_t)bsd_get_u64(buffer + 40);
+    r->white_euler2 = bsd_bits_double(bsd_get_u64(buffer + 48));
+    r->black_euler2 = bsd_bits_double(bsd_get_u64(buffer + 56));
+    r->entries = bsd_get_u64(buffer + 64);
+    r->bytes = bsd_get_u64(buffer + 72);
+
+    if (r->bytes != (uint64_t)(length - UNIT_HEADER))
+        return BSD_ERR_FORMAT;
+
+    return 0;
+}
+
+/* Add the statistics of a result message to a point. The histograms
+   are added as exact 64-bit sums. Returns 0 if successful. */
+static int add_unit(ensemble_point *const to, const unit_result *const r,
+                    const unsigned char *const buffer, const size_t n)
+{
+    const unsigned char  *ptr = buffer + UNIT_HEADER;
+    const unsigned char  *const end = ptr + r->bytes;
+    uint64_t              size = 0, delta, white, black, i;
+
+    if (!to->white) {
+        to->white = calloc(n + 2, sizeof to->white[0]);
+        to->black = calloc(n + 2, sizeof to->black[0]);
+        if (!to->white || !to->black)
+            return BSD_ERR_NOMEM;
+    }
+
+    for (i = 0; i < r->entries; i++) {
+        ptr = bsd_get_varint(ptr, end, &delta);
+        if (ptr)
+            ptr = bsd_get_varint(ptr, end, &white);
+        if (ptr)
+            ptr = bsd_get_varint(ptr, end, &black);
+        if (!ptr || !delta || delta > n - size)
+            return BSD_ERR_FORMAT;
+        size += delta;
+        to->white[size] += white;
+        to->black[size] += black;
+    }
+
+    to->sum.iterations += r->iterations;
+    to->sum.white_spans += r->white_spans;
+    to->sum.black_spans += r->black_spans;
+    to->sum.white_euler += r->white_euler;
+    to->sum.black_euler += r->black_euler;
+    to->sum.white_euler2 += r->white_euler2;
+    to->sum.black_euler2 += r->black_euler2;
+    to->done++;
+
+    return 0;
+}
+
+/* Read or write exactly 'length' bytes. Returns 0 if successful. */
+static int read_all(const int fd, void *const data, const size_t length)
+{
+    unsigned char  *ptr = data;
+    size_t          left = length;
+
+    while (left > 0) {
+        const ssize_t  n = read(fd, ptr, left);
+        if (n > 0) {
+            ptr += n;
+            left -= (size_t)n;
+        } else
+        if (n == 0 || errno != EINTR)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int write_all(const int fd, const void *const data, const size_t length)
+{
+    const unsigned char  *ptr = data;
+    size_t                left = length;
+
+    while (left > 0) {
+        const ssize_t  n = write(fd, ptr, left);
+        if (n > 0) {
+            ptr += n;
+            left -= (size_t)n;
+        } else
+        if (n == 0 || errno != EINTR)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Initialize the cluster of a worker. */
+static int init_worker(cluster *const c, const ensemble *const e)
+{
+    int  result;
+
+    result = init_cluster(c, e->rows, e->cols, e->p_black.min, e->d_white.min, e->d_black.min);
+    if (result)
+        return result;
+
+    c->span_mode = e->span_mode;
+    c->rng_mode = CLUSTER_RNG_COUNTER;
+    c->rng_seed = e->seed;
+
+    return set_cluster_boundary(c, e->boundary);
+}
+
+/* Worker process: do the units read from 'from', writing the results to
+   'to', until UNIT_STOP or end of input. */
+static int local_worker(const ensemble *const e, const int from, const int to)
+{
+    cluster         c = CLUSTER_INITIALIZER;
+    unsigned char  *buffer = NULL;
+    size_t          size = 0, length;
+    unsigned char   field[8];
+    uint64_t        unit;
+
+    if (init_worker(&c, e))
+        return EXIT_FAILURE;
+
+    while (!read_all(from, field, sizeof field)) {
+        unit = bsd_get_u64(field);
+        if (unit == UNIT_STOP)
+            break;
+
+        if (run_unit(&c, e, unit))
+            return EXIT_FAILURE;
+        length = encode_unit(&c, unit, &buffer, &size);
+        if (!length || write_all(to, buffer, length))
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#ifdef ENSEMBLE_MPI
+/* Worker rank: as local_worker(), but over MPI. */
+static int mpi_worker(const ensemble *const e)
+{
+    cluster         c = CLUSTER_INITIALIZER;
+    unsigned char  *buffer = NULL;
+    size_t          size = 0, length;
+    uint64_t        unit;
+
+    if (init_worker(&c, e))
+        return EXIT_FAILURE;
+
+    while (MPI_Recv(&unit, 1, MPI_UINT64_T, 0, TAG_UNIT, MPI_COMM_WORLD, MPI_STATUS_IGNORE) == MPI_SUCCESS) {
+        if (unit == UNIT_STOP)
+            break;
+
+        if (run_unit(&c, e, unit))
+            return EXIT_FAILURE;
+        length = encode_unit(&c, unit, &buffer, &size);
+        if (!length || MPI_Send(buffer, (int)length, MPI_BYTE, 0, TAG_RESULT, MPI_COMM_WORLD) != MPI_SUCCESS)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+#endif
+
+/* Start 'count' worker processes. Returns the number started. */
+static int start_workers(ensemble_worker *const w, const int count, const ensemble *const e)
+{
+    int  i, k;
+
+    for (i = 0; i < count; i++) {
+        int  to[2], from[2];
+
+        if (pipe(to) == -1)
+            break;
+        if (pipe(from) == -1) {
+            close(to[0]);
+            close(to[1]);
+            break;
+        }
+
+        fflush(stdout);
+        w[i].pid = fork();
+        if (w[i].pid == (pid_t)-1) {
+            close(to[0]);
+            close(to[1]);
+            close(from[0]);
+            close(from[1]);
+            break;
+        }
+
+        if (!w[i].pid) {
+            /* Only keep the pipes of this worker. */
+            for (k = 0; k < i; k++) {
+                close(w[k].to);
+                close(w[k].from);
+            }
+            close(to[1]);
+            close(from[0]);
+            _exit(local_worker(e, to[0], from[1]));
+        }
+
+        close(to[0]);
+        close(from[1]);
+        w[i].to = to[1];
+        w[i].from = from[0];
+        w[i].rank = -1;
+        w[i].alive = 1;
+        w[i].unit = UNIT_STOP;
+        w[i].started = 0;
+    }
+
+    return i;
+}
+
+/* Send a unit to a worker. Returns 0 if successful. */
+static int send_unit(ensemble_worker *const w, const uint64_t unit)
+{
+    unsigned char  field[8];
+
+#ifdef ENSEMBLE_MPI
+    if (w->rank > 0) {
+        uint64_t  value = unit;
+        return MPI_Send(&value, 1, MPI_UINT64_T, w->rank, TAG_UNIT, MPI_COMM_WORLD) != MPI_SUCCESS;
+    }
+#endif
+
+    bsd_put_u64(field, unit);
+    return write_all(w->to, field, sizeof field);
+}
+
+/* A worker died or did not respond in time: its unit is done by another.
+   Local worker processes are killed. Returns the unit, or UNIT_STOP. */
+static uint64_t fail_worker(ensemble_worker *const w)
+{
+    const uint64_t  unit = w->unit;
+
+    w->alive = 0;
+    w->unit = UNIT_STOP;
+
+    if (w->rank < 0 && w->pid > 0) {
+        kill(w->pid, SIGKILL);
+        waitpid(w->pid, NULL, 0);
+        close(w->to);
+        close(w->from);
+        w->pid = 0;
+    }
+
+    return unit;
+}
+
+/* Wait for a result from any worker, for at most 'wait' milliseconds, or
+   indefinitely if negative. Returns the worker index with the message in
+   '*buffer', or -1 if none arrived in time. If a worker failed, it is
+   returned with '*length' zero. */
+static int receive_result(ensemble_worker *const w, const int count, const int wait,
+                          unsigned char **const buffer, size_t *const size,
+                          size_t *const length)
+{
+    struct pollfd  *fds;
+    int             i, k, found = -1;
+    unit_result     r;
+
+    *length = 0;
+
+#ifdef ENSEMBLE_MPI
+    if (count > 0 && w[0].rank > 0) {
+        MPI_Status  status;
+        int         flag = 0, bytes;
+        long        waited = 0;
+
+        /* Poll, so that unresponsive ranks can be given up on. */
+        while (1) {
+            if (MPI_Iprobe(MPI_ANY_SOURCE, TAG_RESULT, MPI_COMM_WORLD, &flag, &status) != MPI_SUCCESS)
+                return -1;
+            if (flag || (wait >= 0 && waited >= wait))
+                break;
+            {
+                struct timespec  pause = { 0, 1000000L };
+                nanosleep(&pause, NULL);
+                waited++;
+            }
+        }
+        if (!flag)
+            return -1;
+
+        MPI_Get_count(&status, MPI_BYTE, &bytes);
+        if (*size < (size_t)bytes) {
+            unsigned char *const  temp = realloc(*buffer, (size_t)bytes);
+            if (!temp)
+                return -1;
+            *buffer = temp;
+            *size = (size_t)bytes;
+        }
+        if (MPI_Recv(*buffer, bytes, MPI_BYTE, status.MPI_SOURCE, TAG_RESULT,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+            return -1;
+
+        /* A rank given up on is back. */
+        w[status.MPI_SOURCE - 1].alive = 1;
+        *length = (size_t)bytes;
+        return status.MPI_SOURCE - 1;
+    }
+#endif
+
+    fds = malloc((size_t)count * sizeof fds[0]);
+    if (!fds)
+        return -1;
+
+    for (i = 0, k = 0; i < count; i++)
+        if (w[i].alive) {
+            fds[k].fd = w[i].from;
+            fds[k].events = POLLIN;
+            fds[k].revents = 0;
+            k++;
+        }
+
+    if (poll(fds, (nfds_t)k, wait) > 0)
+        for (i = 0, k = 0; i < count && found < 0; i++)
+            if (w[i].alive) {
+                if (fds[k].revents)
+                    found = i;
+                k++;
+            }
+    free(fds);
+
+    if (found < 0)
+        return -1;
+
+    /* A truncated message means the worker died. */
+    if (*size < UNIT_HEADER) {
+        unsigned char *const  temp = realloc(*buffer, UNIT_HEADER);
+        if (!temp)
+            return -1;
+        *buffer = temp;
+        *size = UNIT_HEADER;
+    }
+    if (read_all(w[found].from, *buffer, UNIT_HEADER))
+        return found;
+    r.bytes = bsd_get_u64(*buffer + 72);
+    if (r.bytes > (uint64_t)1 << 40)
+        return found;
+    if (*size < UNIT_HEADER + (size_t)r.bytes) {
+        unsigned char *const  temp = realloc(*buffer, UNIT_HEADER + (size_t)r.bytes);
+        if (!temp)
+            return -1;
+        *buffer = temp;
+        *size = UNIT_HEADER + (size_t)r.bytes;
+    }
+    if (read_all(w[found].from, *buffer + UNIT_HEADER, (size_t)r.bytes))
+        return found;
+
+    *length = UNIT_HEADER + (size_t)r.bytes;
+    return found;
+}
+
+/* Print the line of a completed point, and append its histograms to
+   the binary file. Returns 0 if successful. */
+static int write_point(FILE *const out, FILE *const binary, const ensemble *const e,
+                       const long point, ensemble_point *const pt, const int euler)
+{
+    const size_t  n = (size_t)e->rows * (size_t)e->cols;
+    double        p, dw, db;
+
+    ensemble_point_values(e, point, &p, &dw, &db);
+
+    if (e->d_white.step != 0.0 || e->d_black.step != 0.0)
+        fprintf(out, "%.6f %.6f %.6f : %.6f%%", p, dw, db, 100.0 * (double)pt->sum.black_spans / (double)pt->sum.iterations);
+    else
+        fprintf(out, "%.6f : %.6f%%", p, 100.0 * (double)pt->sum.black_spans / (double)pt->sum.iterations);
+    if (euler)
+        print_euler(out, pt->sum.iterations, pt->sum.white_euler, pt->sum.black_euler,
+                    pt->sum.white_euler2, pt->sum.black_euler2);
+    fprintf(out, "\n");
+    fflush(out);
+
+    if (binary) {
+        bsd_header  header;
+        int         result;
+
+        header.seed = e->seed;
+        header.rows = e->rows;
+        header.cols = e->cols;
+        header.threads = 1;
+        header.p_black = p;
+        header.p_diag = dw;
+        header.p_diag_black = db;
+        header.limit_black = probability_limit(p);
+        header.limit_diag = probability_limit(dw);
+        header.limit_diag_black = probability_limit(db);
+        header.iterations = pt->sum.iterations;
+
+        result = bsd_write(binary, &header, pt->white, pt->black, n);
+        if (!result && fflush(binary))
+            result = (errno) ? errno : EIO;
+        if (result)
+            return result;
+    }
+
+    free(pt->white);
+    free(pt->black);
+    pt->white = NULL;
+    pt->black = NULL;
+    return 0;
+}
+
+int usage(const char *argv0)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
+    fprintf(stderr, "       %s OPTIONS [ > output.txt ]\n", argv0);
+    fprintf(stderr, "       mpirun -np K %s OPTIONS [ > output.txt ]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "       rows=SIZE    Set number of rows. Default is %d.\n", DEFAULT_ROWS);
+    fprintf(stderr, "       cols=SIZE    Set number of columns. Default is %d.\n", DEFAULT_COLS);
+    fprintf(stderr, "       L=SIZE       Set rows=SIZE and cols=SIZE.\n");
+    fprintf(stderr, "       black=P      Set the probability of a cell to be black. Default is %g.\n", DEFAULT_P_BLACK);
+    fprintf(stderr, "       black=MIN:MAX:STEP\n");
+    fprintf(stderr, "                    Sweep the probability from MIN to MAX, inclusive.\n");
+    fprintf(stderr, "                    dwhite and dblack can be swept the same way.\n");
+    fprintf(stderr, "       dwhite=P     Set the probability of white cells connecting diagonally.\n");
+    fprintf(stderr, "                    Default is %g.\n", DEFAULT_D_WHITE);
+    fprintf(stderr, "       dblack=P     Set the probability of black cells connecting diagonally.\n");
+    fprintf(stderr, "                    Default is %g.\n", DEFAULT_D_BLACK);
+    fprintf(stderr, "       N=COUNT      Number of iterations per point. Default is %d.\n", DEFAULT_ITERS);
+    fprintf(stderr, "       block=COUNT  Number of iterations per work unit. Default is %d.\n", DEFAULT_BLOCK);
+    fprintf(stderr, "       seed=U64     Seed of the counter-based generator. Default is to pick\n");
+    fprintf(stderr, "                    one randomly (based on time).\n");
+    fprintf(stderr, "       realization=K\n");
+    fprintf(stderr, "                    Number of the first matrix. Default is 0.\n");
+    fprintf(stderr, "       workers=K    Number of local worker processes, when not run under\n");
+    fprintf(stderr, "                    MPI. With workers=0, the units are done in this process.\n");
+    fprintf(stderr, "                    Default is %d.\n", DEFAULT_WORKERS);
+    fprintf(stderr, "       timeout=SECS Give up on a worker that has not returned its unit in\n");
+    fprintf(stderr, "                    SECS seconds, and give the unit to another worker.\n");
+    fprintf(stderr, "                    Default is %d for local workers, to only give up on\n", DEFAULT_TIMEOUT);
+    fprintf(stderr, "                    workers that die, and %d under MPI, where a rank that\n", DEFAULT_MPI_TIMEOUT);
+    fprintf(stderr, "                    dies is only noticed by its timeout. With timeout=0,\n");
+    fprintf(stderr, "                    a run under MPI waits for every rank indefinitely.\n");
+    fprintf(stderr, "       span=MODE    Set the spanning criterion: horizontal, vertical,\n");
+    fprintf(stderr, "                    either (the default), or both.\n");
+    fprintf(stderr, "       boundary=periodic\n");
+    fprintf(stderr, "                    Wrap the matrix around in both directions.\n");
+    fprintf(stderr, "       euler=yes    Also print the mean and variance of the Euler numbers.\n");
+    fprintf(stderr, "       output=FILE  Write the results to FILE instead of standard output.\n");
+    fprintf(stderr, "       binary=FILE  Append the histograms of each point to FILE in the\n");
+    fprintf(stderr, "                    binary format of bsd.h, with dwhite as the diagonal\n");
+    fprintf(stderr, "                    and dblack as the black diagonal probability.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "The iterations of each point are split into work units of block=COUNT\n");
+    fprintf(stderr, "matrices, handed out to the MPI ranks (rank 0 coordinates), or to the\n");
+    fprintf(stderr, "local worker processes. The counter-based generator gives each matrix the\n");
+    fprintf(stderr, "same cells regardless of the worker, so the histograms and the spanning\n");
+    fprintf(stderr, "counts, summed exactly, are the same as from distribution_modified with\n");
+    fprintf(stderr, "rng=counter, and the units of a failed worker are simply done again.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Each point is printed when all its units are done, in order, as\n");
+    fprintf(stderr, "   BLACK : PERCENT%%\n");
+    fprintf(stderr, "where PERCENT is the percentage of iterations where a black cluster\n");
+    fprintf(stderr, "spanned the matrix. If dwhite or dblack is swept, the line begins with\n");
+    fprintf(stderr, "BLACK DWHITE DBLACK. With euler=yes, the line continues with\n");
+    fprintf(stderr, "   WHITE_EULER WHITE_VARIANCE BLACK_EULER BLACK_VARIANCE\n");
+    fprintf(stderr, "\n");
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    ensemble         e;
+    int              workers = DEFAULT_WORKERS;
+    long             timeout = -1;
+    int              euler = 0;
+    const char      *output_path = NULL;
+    const char      *binary_path = NULL;
+    FILE            *out = stdout;
+    FILE            *binary = NULL;
+    int              mpi_size = 1;
+
+    cluster          self = CLUSTER_INITIALIZER;
+    ensemble_worker *w = NULL;
+    ensemble_point  *pt;
+    unsigned char   *state;
+    unsigned char   *buffer = NULL;
+    size_t           size = 0, length;
+    uint64_t         units, next = 0, written = 0, u;
+    long             points, blocks;
+    int              count = 0, alive, given_up = 0;
+
+    int              arg, itemp, result;
+    uint64_t         u64temp;
+    long             ltemp;
+    char             dummy;
+    int              i;
+
+#ifdef ENSEMBLE_MPI
+    int              mpi_rank = 0;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+    MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
+#endif
+
+    e.rows = DEFAULT_ROWS;
+    e.cols = DEFAULT_COLS;
+    e.p_black.min = e.p_black.max = DEFAULT_P_BLACK;
+    e.d_white.min = e.d_white.max = DEFAULT_D_WHITE;
+    e.d_black.min = e.d_black.max = DEFAULT_D_BLACK;
+    e.p_black.step = e.d_white.step = e.d_black.step = 0.0;
+    e.iters = DEFAULT_ITERS;
+    e.block = DEFAULT_BLOCK;
+    e.seed = 0;
+    e.realization = 0;
+    e.span_mode = CLUSTER_SPAN_EITHER;
+    e.boundary = CLUSTER_BOUNDARY_OPEN;
+
+    if (argc < 2)
+        return usage(argv[0]);
+
+    for (arg = 1; arg < argc; arg++)
+        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
+            return usage(argv[0]);
+        else
+        if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
+            e.rows = itemp;
+            e.cols = itemp;
+        } else
+        if (sscanf(argv[arg], "rows=%d %c", &itemp, &dummy) == 1) {
+            e.rows = itemp;
+        } else
+        if (sscanf(argv[arg], "cols=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "columns=%d %c", &itemp, &dummy) == 1) {
+            e.cols = itemp;
+        } else
+        if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "seed=%" SCNx64 " %c", &u64temp, &dummy) == 1) {
+            e.seed = u64temp;
+        } else
+        if (sscanf(argv[arg], "realization=%" SCNu64 " %c", &u64temp, &dummy) == 1) {
+            e.realization = u64temp;
+        } else
+        if (sscanf(argv[arg], "N=%ld %c", &ltemp, &dummy) == 1 ||
+            sscanf(argv[arg], "count=%ld %c", &ltemp, &dummy) == 1) {
+            if (ltemp < 1) {
+                fprintf(stderr, "%s: Invalid number of iterations.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            e.iters = ltemp;
+        } else
+        if (sscanf(argv[arg], "block=%ld %c", &ltemp, &dummy) == 1) {
+            if (ltemp < 1) {
+                fprintf(stderr, "%s: Invalid number of iterations per unit.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            e.block = ltemp;
+        } else
+        if (parse_sweep(argv[arg], "black", &e.p_black) ||
+            parse_sweep(argv[arg], "p", &e.p_black)) {
+            /* Already parsed. */
+        } else
+        if (parse_sweep(argv[arg], "dwhite", &e.d_white) ||
+            parse_sweep(argv[arg], "dw", &e.d_white)) {
+            /* Already parsed. */
+        } else
+        if (parse_sweep(argv[arg], "dblack", &e.d_black) ||
+            parse_sweep(argv[arg], "db", &e.d_black)) {
+            /* Already parsed. */
+        } else
+        if (sscanf(argv[arg], "workers=%d %c", &itemp, &dummy) == 1) {
+            if (itemp < 0) {
+                fprintf(stderr, "%s: Invalid number of workers.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            workers = itemp;
+        } else
+        if (sscanf(argv[arg], "timeout=%ld %c", &ltemp, &dummy) == 1) {
+            if (ltemp < 0) {
+                fprintf(stderr, "%s: Invalid timeout.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            timeout = ltemp;
+        } else
+        if ((result = parse_cluster_option(argv[arg], &e.span_mode, &e.boundary, &euler))) {
+            if (result < 0)
+                return EXIT_FAILURE;
+        } else
+        if (!strncmp(argv[arg], "output=", 7) && argv[arg][7]) {
+            output_path = argv[arg] + 7;
+        } else
+        if (!strncmp(argv[arg], "binary=", 7) && argv[arg][7]) {
+            binary_path = argv[arg] + 7;
+        } else {
+            fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
+            return EXIT_FAILURE;
+        }
+
+    /* All ranks need the same seed. */
+    if (!e.seed)
+        e.seed = randomize(NULL);
+#ifdef ENSEMBLE_MPI
+    MPI_Bcast(&e.seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (mpi_rank > 0) {
+        result = mpi_worker(&e);
+        MPI_Finalize();
+        return result;
+    }
+#endif
+
+    /* Check the size before starting any workers. */
+    {
+        cluster  c = CLUSTER_INITIALIZER;
+
+        switch (init_worker(&c, &e)) {
+        case 0: break; /* OK */
+        case ERR_INVALID:
+            fprintf(stderr, "Invalid size.\n");
+            return EXIT_FAILURE;
+        case ERR_TOOLARGE:
+            fprintf(stderr, "Size is too large.\n");
+            return EXIT_FAILURE;
+        default:
+            fprintf(stderr, "Not enough memory.\n");
+            return EXIT_FAILURE;
+        }
+
+        free_cluster(&c);
+    }
+
+    points = ensemble_points(&e);
+    blocks = ensemble_blocks(&e);
+    units = (uint64_t)points * (uint64_t)blocks;
+
+    pt = calloc((size_t)points, sizeof pt[0]);
+    state = calloc((size_t)units, sizeof state[0]);
+    if (mpi_size > 1)
+        workers = mpi_size - 1;
+    if (timeout < 0)
+        timeout = (mpi_size > 1) ? DEFAULT_MPI_TIMEOUT : DEFAULT_TIMEOUT;
+    if (workers > 0)
+        w = calloc((size_t)workers, sizeof w[0]);
+    if (!pt || !state || (workers > 0 && !w)) {
+        fprintf(stderr, "Not enough memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (output_path) {
+        out = fopen(output_path, "w");
+        if (!out) {
+            fprintf(stderr, "%s: %s.\n", output_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    if (binary_path) {
+        binary = fopen(binary_path, "ab");
+        if (!binary) {
+            fprintf(stderr, "%s: %s.\n", binary_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (mpi_size > 1) {
+        for (i = 0; i < workers; i++) {
+            w[i].rank = i + 1;
+            w[i].alive = 1;
+            w[i].unit = UNIT_STOP;
+        }
+        count = workers;
+    } else
+    if (workers > 0) {
+        /* A worker that dies must not kill us. */
+        signal(SIGPIPE, SIG_IGN);
+        count = start_workers(w, workers, &e);
+        if (count < 1) {
+            fprintf(stderr, "Cannot start worker processes.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    fprintf(out, "# seed: %" PRIu64 " (counter-based, realizations %" PRIu64 " to %" PRIu64 ")\n",
+            e.seed, e.realization, e.realization + (uint64_t)points * (uint64_t)e.iters - 1);
+    fprintf(out, "# size: %d rows, %d columns\n", e.rows, e.cols);
+    if (mpi_size > 1)
+        fprintf(out, "# workers: %d MPI ranks, %ld iterations per unit\n", count, e.block);
+    else
+        fprintf(out, "# workers: %d processes, %ld iterations per unit\n", count, e.block);
+    fflush(out);
+
+    while (written < (uint64_t)points) {
+        int  k;
+
+        if (count > 0) {
+            const time_t  now = time(NULL);
+            int           wait = -1;
+
+            /* Hand out the pending units to the idle workers. */
+            for (i = 0; i < count; i++)
+                if (w[i].alive && w[i].unit == UNIT_STOP) {
+                    while (next < units && state[next] != UNIT_PENDING)
+                        next++;
+                    if (next >= units)
+                        break;
+                    if (send_unit(w + i, next)) {
+                        fail_worker(w + i);
+                        continue;
+                    }
+                    state[next] = UNIT_ASSIGNED;
+                    w[i].unit = next;
+                    w[i].started = now;
+                }
+
+            for (i = 0, alive = 0; i < count; i++)
+                alive += w[i].alive;
+            if (!alive) {
+                fprintf(stderr, "All workers have failed.\n");
+                return EXIT_FAILURE;
+            }
+
+            /* Wait at most until the first worker is due. */
+            if (timeout > 0) {
+                for (i = 0; i < count; i++)
+                    if (w[i].alive && w[i].unit != UNIT_STOP) {
+                        const long  left = (long)(w[i].started + timeout - now);
+                        const int   ms = (left > 0) ? (int)((left < 86400) ? left : 86400) * 1000 : 0;
+                        if (wait < 0 || ms < wait)
+                            wait = ms;
+                    }
+            }
+
+            k = receive_result(w, count, wait, &buffer, &size, &length);
+            if (k >= 0 && !length) {
+                u = fail_worker(w + k);
+                if (u != UNIT_STOP && state[u] == UNIT_ASSIGNED) {
+                    state[u] = UNIT_PENDING;
+                    if (u < next)
+                        next = u;
+                }
+                fprintf(stderr, "Worker %d failed; its unit is reassigned.\n", k + 1);
+                continue;
+            }
+
+            /* Give up on the workers that are overdue. */
+            if (k < 0 && timeout > 0) {
+                const time_t  later = time(NULL);
+                for (i = 0; i < count; i++)
+                    if (w[i].alive && w[i].unit != UNIT_STOP && later - w[i].started >= timeout) {
+                        u = fail_worker(w + i);
+                        if (state[u] == UNIT_ASSIGNED) {
+                            state[u] = UNIT_PENDING;
+                            if (u < next)
+                                next = u;
+                        }
+                        if (w[i].rank > 0)
+                            given_up++;
+                        fprintf(stderr, "Worker %d did not respond in %ld seconds; its unit is reassigned.\n",
+                                i + 1, timeout);
+                    }
+            }
+            if (k < 0)
+                continue;
+
+            /* A rank given up on earlier may still respond. */
+            if (w[k].rank > 0 && w[k].unit == UNIT_STOP && given_up > 0)
+                given_up--;
+            w[k].unit = UNIT_STOP;
+        } else {
+            /* Without workers, this process does the units. */
+            if (!self.map && init_worker(&self, &e)) {
+                fprintf(stderr, "Not enough memory.\n");
+                return EXIT_FAILURE;
+            }
+            while (next < units && state[next] != UNIT_PENDING)
+                next++;
+            if (run_unit(&self, &e, next)) {
+                fprintf(stderr, "Not enough memory.\n");
+                return EXIT_FAILURE;
+            }
+            length = encode_unit(&self, next, &buffer, &size);
+            if (!length) {
+                fprintf(stderr, "Not enough memory.\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        /* Units done twice, after giving up on a worker, are only counted once. */
+        {
+            unit_result  r;
+
+            if (decode_unit(buffer, length, &r) || r.unit >= units) {
+                fprintf(stderr, "Invalid result from a worker.\n");
+                return EXIT_FAILURE;
+            }
+            if (state[r.unit] == UNIT_DONE)
+                continue;
+
+            result = add_unit(pt + r.unit / (uint64_t)blocks, &r, buffer, (size_t)e.rows * (size_t)e.cols);
+            if (result) {
+                fprintf(stderr, "Invalid result from a worker: %s.\n", bsd_strerror(result));
+                return EXIT_FAILURE;
+            }
+            state[r.unit] = UNIT_DONE;
+        }
+
+        /* Write the points that are complete, in order. */
+        while (written < (uint64_t)points && pt[written].done == blocks) {
+            result = write_point(out, binary, &e, (long)written, pt + written, euler);
+            if (result) {
+                fprintf(stderr, "%s: %s.\n", binary_path, bsd_strerror(result));
+                return EXIT_FAILURE;
+            }
+            written++;
+        }
+    }
+
+    /* Stop the workers. */
+    for (i = 0; i < count; i++)
+        if (w[i].alive) {
+            send_unit(w + i, UNIT_STOP);
+            if (w[i].rank < 0) {
+                close(w[i].to);
+                close(w[i].from);
+                waitpid(w[i].pid, NULL, 0);
+            }
+        }
+
+    if (binary && fclose(binary)) {
+        fprintf(stderr, "%s: %s.\n", binary_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (out != stdout && fclose(out)) {
+        fprintf(stderr, "%s: %s.\n", output_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+#ifdef ENSEMBLE_MPI
+    /* Ranks that never responded would keep MPI_Finalize() waiting. */
+    if (given_up > 0) {
+        fprintf(stderr, "%d ranks did not respond; aborting them.\n", given_up);
+        MPI_Abort(MPI_COMM_WORLD, EXIT_SUCCESS);
+    }
+    MPI_Finalize();
+#endif
+
+    /* All done. */
+    return EXIT_SUCCESS;
+}
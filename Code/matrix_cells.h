@@ -0,0 +1,655 @@
+/* Courtesy: Nominal Animal <question@nominal-animal.net>
+*/
+
+/*
+The cell type dependent part of matrix.h, included there once per cell
+type. Before each inclusion, matrix.h defines
+
+    MATRIX_CELL       the cell type, an unsigned integer type
+    MATRIX_CELL_BITS  its width in bits, used as the suffix of the names
+    PRI_CELL          the printf() conversion for the cell type
+
+so that, for example, matrix_generate() here becomes matrix_generate_16()
+for uint16_t cells. The macros are undefined at the end of this file.
+*/
+
+#ifndef  MATRIX_CELL
+#error   matrix_cells.h is included by matrix.h only.
+#endif
+
+#define  MATRIX_JOIN(name, bits)  name ## _ ## bits
+#define  MATRIX_NAME2(name, bits) MATRIX_JOIN(name, bits)
+#define  MATRIX_NAME(name)        MATRIX_NAME2(name, MATRIX_CELL_BITS)
+
+#define  cell             MATRIX_CELL
+#define  cell_common      MATRIX_NAME(cell_common)
+#define  djs_root         MATRIX_NAME(djs_root)
+#define  djs_path         MATRIX_NAME(djs_path)
+#define  djs_flatten      MATRIX_NAME(djs_flatten)
+#define  djs_link         MATRIX_NAME(djs_link)
+#define  djs_single       MATRIX_NAME(djs_single)
+#define  djs_grow         MATRIX_NAME(djs_grow)
+#define  djs_join2        MATRIX_NAME(djs_join2)
+#define  djs_join3        MATRIX_NAME(djs_join3)
+#define  djs_join4        MATRIX_NAME(djs_join4)
+#define  matrix_generate  MATRIX_NAME(matrix_generate)
+
+/* Save the cells in array2 that also occur in array1 to dest, each only once.
+   The cells are marked in the 'mark' bitmap (one bit per cell index),
+   which must be all clear, and is left all clear. */
+static_inline size_t cell_common(cell *const dest, const cell *const array1, const cell *const array2,
+                                 const size_t count, uint64_t *const mark)
+{
+    size_t  have = 0;
+    size_t  i;
+
+    for (i = 0; i < count; i++) {
+        const cell  c = CELL_INDEX(array1[i]);
+        mark[c >> 6] |= (uint64_t)1 << (c & 63);
+    }
+
+    for (i = 0; i < count; i++) {
+        const cell      c = CELL_INDEX(array2[i]);
+        const uint64_t  bit = (uint64_t)1 << (c & 63);
+        if (mark[c >> 6] & bit) {
+            mark[c >> 6] ^= bit;
+            dest[have++] = array2[i];
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        const cell  c = CELL_INDEX(array1[i]);
+        mark[c >> 6] &= ~((uint64_t)1 << (c & 63));
+    }
+
+    return have;
+}
+
+/* Disjoint set operations on cells. Define VERIFY to add color checks.
+
+   Define DJS_BY_SIZE to halve paths as they are walked, instead of walking
+   each path twice to compress it, and to link the smaller subset under the
+   larger one when joining. A cell has no room for a subset size, so the
+   sizes are kept in the separate 'size' array of the matrix, indexed by
+   the root cell; without DJS_BY_SIZE, the 'size' parameters are unused,
+   and the smallest root value is kept as the root. djs_single() and
+   djs_grow() keep the sizes as the cells are labelled. */
+
+#ifdef DJS_BY_SIZE
+
+static_inline cell  djs_root(cell *const djs, size_t index)
+{
+    cell  curr = djs[index], next;
+
+    while ((next = djs[CELL_INDEX(curr)]) != curr) {
+#ifdef VERIFY
+        if (CELL_COLOR(curr) != CELL_COLOR(next)) {
+            fprintf(stderr, "djs_root(): Cluster contains cells with different colors.\n");
+            exit(EXIT_FAILURE);
+        }
+#endif
+        djs[index] = next;
+        index = CELL_INDEX(next);
+        curr = djs[index];
+    }
+
+    return curr;
+}
+
+static_inline void  djs_path(cell *const djs, size_t index, const cell root)
+{
+    cell  curr = djs[index];
+
+    while (curr != root) {
+        djs[index] = root;
+        index = CELL_INDEX(curr);
+        curr = djs[index];
+    }
+}
+
+static_inline cell  djs_flatten(cell *const djs, size_t index)
+{
+    const cell  root = djs_root(djs, index);
+    djs[index] = root;
+    return root;
+}
+
+/* Cell 'index', of value 'value', starts a subset of its own. */
+static_inline cell  djs_single(cell *const size, const size_t index, const cell value)
+{
+    size[index] = 1;
+    return value;
+}
+
+/* A new cell joins the subset of 'root'. Returns 'root'. */
+static_inline cell  djs_grow(cell *const size, const cell root)
+{
+    size[CELL_INDEX(root)]++;
+    return root;
+}
+
+/* Link roots 'root' and 'other', if they differ, the smaller subset
+   under the larger one. Returns the new root. */
+static_inline cell  djs_link(cell *const djs, cell *const size, cell root, cell other)
+{
+#ifdef VERIFY
+    if (CELL_COLOR(other) != CELL_COLOR(root)) {
+        fprintf(stderr, "djs_link(): Cluster contains cells with different colors.\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (root == other)
+        return root;
+    if (size[CELL_INDEX(root)] < size[CELL_INDEX(other)]) {
+        const cell  temp = root;
+        root = other;
+        other = temp;
+    }
+    djs[CELL_INDEX(other)] = root;
+    size[CELL_INDEX(root)] += size[CELL_INDEX(other)];
+    return root;
+}
+
+static_inline cell  djs_join2(cell *const djs, cell *const size, size_t index1, size_t index2)
+{
+    return djs_link(djs, size, djs_root(djs, index1), djs_root(djs, index2));
+}
+
+static_inline cell  djs_join3(cell *const djs, cell *const size, size_t index1, size_t index2, size_t index3)
+{
+    cell  root = djs_root(djs, index1);
+    root = djs_link(djs, size, root, djs_root(djs, index2));
+    return djs_link(djs, size, root, djs_root(djs, index3));
+}
+
+static_inline cell  djs_join4(cell *const djs, cell *const size, size_t index1, size_t index2, size_t index3, size_t index4)
+{
+    cell  root = djs_root(djs, index1);
+    root = djs_link(djs, size, root, djs_root(djs, index2));
+    root = djs_link(djs, size, root, djs_root(djs, index3));
+    return djs_link(djs, size, root, djs_root(djs, index4));
+}
+
+#else /* !DJS_BY_SIZE */
+
+static_inline cell  djs_root(cell *const djs, size_t index)
+{
+    cell  prev, curr = djs[index];
+
+    do {
+        index = CELL_INDEX(curr);
+        prev = curr;
+        curr = djs[index];
+#ifdef VERIFY
+        if (CELL_COLOR(curr) != CELL_COLOR(prev)) {
+            fprintf(stderr, "djs_root(): Cluster contains cells with different colors.\n");
+            exit(EXIT_FAILURE);
+        }
+#endif
+    } while (prev != curr);
+
+    return curr;
+}
+
+static_inline void  djs_path(cell *const djs, size_t index, const cell root)
+{
+    cell  curr = djs[index];
+
+    while (curr != root) {
+#ifdef VERIFY
+        if (CELL_COLOR(curr) != CELL_COLOR(root)) {
+            fprintf(stderr, "djs_path(): Cluster contains cells with different colors.\n");
+            exit(EXIT_FAILURE);
+        }
+#endif
+        djs[index] = root;
+        index = CELL_INDEX(curr);
+        curr = djs[index];
+    }
+}
+
+static_inline cell  djs_flatten(cell *const djs, size_t index)
+{
+    cell  root;
+    root = djs_root(djs, index);
+    djs_path(djs, index, root);
+    return root;
+}
+
+static_inline cell  djs_single(cell *const size, const size_t index, const cell value)
+{
+    (void)size;
+    (void)index;
+    return value;
+}
+
+static_inline cell  djs_grow(cell *const size, const cell root)
+{
+    (void)size;
+    return root;
+}
+
+static_inline cell  djs_join2(cell *const djs, cell *const size, size_t index1, size_t index2)
+{
+    cell  root, temp;
+
+    (void)size;
+
+    root = djs_root(djs, index1);
+
+    temp = djs_root(djs, index2);
+#ifdef VERIFY
+    if (CELL_COLOR(temp) != CELL_COLOR(root)) {
+        fprintf(stderr, "djs_join2(): Cluster contains cells with different colors: index %" PRI_CELL " has color %" PRI_CELL ", but index %" PRI_CELL " color %" PRI_CELL ".\n",
+                        CELL_INDEX(temp), CELL_COLOR(temp), CELL_INDEX(root), CELL_COLOR(root));
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (root > temp)
+        root = temp;
+
+    djs_path(djs, index1, root);
+    djs_path(djs, index2, root);
+
+    return root;
+}    
+
+static_inline cell  djs_join3(cell *const djs, cell *const size, size_t index1, size_t index2, size_t index3)
+{
+    cell  root, temp;
+
+    (void)size;
+
+    root = djs_root(djs, index1);
+
+    temp = djs_root(djs, index2);
+#ifdef VERIFY
+    if (CELL_COLOR(temp) != CELL_COLOR(root)) {
+        fprintf(stderr, "djs_join3(): Cluster contains cells with different colors.\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (root > temp)
+        root = temp;
+
+    temp = djs_root(djs, index3);
+#ifdef VERIFY
+    if (CELL_COLOR(temp) != CELL_COLOR(root)) {
+        fprintf(stderr, "djs_join3(): Cluster contains cells with different colors.\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (root > temp)
+        root = temp;
+
+    djs_path(djs, index1, root);
+    djs_path(djs, index2, root);
+    djs_path(djs, index3, root);
+
+    return root;
+}    
+
+static_inline cell  djs_join4(cell *const djs, cell *const size, size_t index1, size_t index2, size_t index3, size_t index4)
+{
+    cell  root, temp;
+
+    (void)size;
+
+    root = djs_root(djs, index1);
+
+    temp = djs_root(djs, index2);
+#ifdef VERIFY
+    if (CELL_COLOR(temp) != CELL_COLOR(root)) {
+        fprintf(stderr, "djs_join4(): Cluster contains cells with different colors.\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (root > temp)
+        root = temp;
+
+    temp = djs_root(djs, index3);
+#ifdef VERIFY
+    if (CELL_COLOR(temp) != CELL_COLOR(root)) {
+        fprintf(stderr, "djs_join4(): Cluster contains cells with different colors.\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (root > temp)
+        root = temp;
+
+    temp = djs_root(djs, index4);
+#ifdef VERIFY
+    if (CELL_COLOR(temp) != CELL_COLOR(root)) {
+        fprintf(stderr, "djs_join4(): Cluster contains cells with different colors.\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+    if (root > temp)
+        root = temp;
+
+    djs_path(djs, index1, root);
+    djs_path(djs, index2, root);
+    djs_path(djs, index3, root);
+    djs_path(djs, index4, root);
+
+    return root;
+}
+
+#endif /* DJS_BY_SIZE */
+
+static void matrix_generate(matrix *const m)
+{
+    prng *const       rng = &(m->rng);
+    cell *const       map = m->map;
+    cell *const       sizes = m->sizes;
+    const size_t      size = m->size;
+    const prng_limit  p_1 = prng_set_probability(m->nonzero);
+    /* Checkerboard 2x2 blocks found while labelling, by top left cell. */
+    uint64_t *const   mark = (m->diagonal > 0.0) ? m->diagmark : NULL;
+#ifdef MATRIX_BULK_PRNG
+    /* Draw the cell colors in bulk; see prng_fill_bernoulli(). */
+    prng_bits         colors = PRNG_BITS_INITIALIZER;
+#define  MATRIX_COLOR()  ((cell)prng_next_bit(rng, p_1, &colors))
+#else
+#define  MATRIX_COLOR()  ((cell)prng_probability(rng, p_1))
+#endif
+
+    /* First row. */
+    {
+        cell    prevvalue, prevcolor, currvalue, currcolor;
+        size_t  c;
+        
+        currcolor = MATRIX_COLOR();
+        map[0] = currvalue = djs_single(sizes, 0, CELL_VALUE(0, currcolor));
+        for (c = 1; c < size; c++) {
+            prevcolor = currcolor;
+            prevvalue = currvalue;
+            currcolor = MATRIX_COLOR();
+            map[c] = currvalue = ((prevcolor == currcolor) ? djs_grow(sizes, prevvalue)
+                                                           : djs_single(sizes, c, CELL_VALUE(c, currcolor)));
+        }
+    }
+
+    /* Other rows. */
+    {
+        size_t  r, index;
+
+        for (r = 1; r < size; r++) {
+            const size_t  endindex = r * size + size;
+            const cell    first = MATRIX_COLOR();
+
+            /* First column can only join up. */
+            if (CELL_COLOR(map[r*size - size]) == first)
+                map[r*size] = djs_grow(sizes, djs_flatten(map, r*size - size));
+            else
+                map[r*size] = djs_single(sizes, r*size, CELL_VALUE(r*size, first));
+
+            for (index = r * size + 1; index < endindex; index++) {
+                const cell  color = MATRIX_COLOR();
+
+                switch ( ((CELL_COLOR(map[index-1]) == color) ? 1 : 0)
+                       + ((CELL_COLOR(map[index-size]) == color) ? 2 : 0) ) {
+                case 0: /* Different color than left or up. If the same
+                           as up and left, this is a checkerboard block; see
+                           the diagonal connection pass below. */
+                    map[index] = djs_single(sizes, index, CELL_VALUE(index, color));
+                    if (mark && CELL_COLOR(map[index-size-1]) == color)
+                        MATRIX_MARK(mark, index-size-1);
+                    break;
+                case 1: /* Join left. */
+                    map[index] = djs_grow(sizes, djs_flatten(map, index-1)); break;
+                case 2: /* Join up. */
+                    map[index] = djs_grow(sizes, djs_flatten(map, index-size)); break;
+                case 3: /* Join up and left. */
+                    map[index] = djs_grow(sizes, djs_join2(map, sizes, index-1, index-size)); break;
+                } 
+            }
+        }
+    }
+
+#undef  MATRIX_COLOR
+
+    /* With periodic boundaries, the 2x2 blocks wrap around too.
+       Find the checkerboard blocks on the right and bottom edges. */
+    if (mark && m->boundary == MATRIX_BOUNDARY_PERIODIC && m->wrap) {
+        const size_t  last = size - 1;
+        size_t        i;
+
+        for (i = 0; i < size; i++) {
+            const size_t  down = (i < last) ? i*size + size : 0;
+            if (SAME_COLOR(map[i*size + last], map[down]) &&
+                SAME_COLOR(map[i*size], map[down + last]) &&
+                !SAME_COLOR(map[i*size + last], map[i*size]))
+                MATRIX_MARK(mark, i*size + last);
+        }
+
+        for (i = 0; i < last; i++)
+            if (SAME_COLOR(map[last*size + i], map[i + 1]) &&
+                SAME_COLOR(map[last*size + i + 1], map[i]) &&
+                !SAME_COLOR(map[last*size + i], map[last*size + i + 1]))
+                MATRIX_MARK(mark, last*size + i);
+    }
+
+    /* Periodic boundaries? Every cell is now in a cluster that does not
+       wrap around; remember its root, and join the cells on opposite edges. */
+    if (m->boundary == MATRIX_BOUNDARY_PERIODIC && m->wrap) {
+        matrix_wrap *const  wrap = m->wrap;
+        const size_t        last = size - 1;
+        size_t              i;
+
+        for (i = 0; i < size * size; i++) {
+            wrap[i].home = CELL_INDEX(djs_flatten(map, i));
+            wrap[i].parent = i;
+            wrap[i].dx = 0;
+            wrap[i].dy = 0;
+            wrap[i].wraps = 0;
+        }
+
+        for (i = 0; i < size; i++) {
+            if (SAME_COLOR(map[i*size + last], map[i*size])) {
+                wrap_join(wrap, size, i*size + last, i*size, +1, 0);
+                djs_join2(map, sizes, i*size + last, i*size);
+            }
+            if (SAME_COLOR(map[last*size + i], map[i])) {
+                wrap_join(wrap, size, last*size + i, i, 0, +1);
+                djs_join2(map, sizes, last*size + i, i);
+            }
+        }
+    }
+
+    /* Diagonal connections? Whether a checkerboard block can be joined
+       depends on the final clusters, including the cells below it, so
+       the blocks marked above are only decided now; in the same order,
+       top left cell first, as a separate pass over all blocks would. */
+    if (mark) {
+        const prng_limit  p_d = prng_set_probability(m->diagonal);
+        const prng_limit  p_d_1 = prng_set_probability(m->diagonal_nonzero);
+        matrix_wrap *const wrap = (m->boundary == MATRIX_BOUNDARY_PERIODIC) ? m->wrap : NULL;
+        const size_t      words = (size * size + 63) / 64;
+        size_t            joins[3] = { 0, 0, 0 };
+        size_t            w;
+        cell              value;
+
+        for (w = 0; w < words; w++) {
+            uint64_t  bits = mark[w];
+
+            /* Leave the marks all clear. */
+            mark[w] = 0;
+
+            while (bits) {
+                const size_t  index       = w * 64 + mark_lowest(bits);
+                const size_t  r           = index / size;
+                const size_t  downrow     = (r + 1 < size) ? size : size - size*size;
+                const size_t  i_right     = (index + 1 < r*size + size) ? index + 1 : r*size;
+                const size_t  i_down      = index + downrow;
+                const size_t  i_downright = i_right + downrow;
+                const cell    target      = djs_flatten(map, index);
+                const cell    right       = djs_flatten(map, i_right);
+                const cell    down        = djs_flatten(map, i_down);
+                const cell    downright   = djs_flatten(map, i_downright);
+
+                if (target != downright &&
+                    right != down &&
+                    SAME_COLOR(target, downright) &&
+                    SAME_COLOR(right, down) &&
+                    !SAME_COLOR(target, right)) {
+                    /* Possible diagonal connection case. */
+                    if (prng_probability(rng, p_d)) {
+                        /* Connect diagonally. */
+                        if (prng_probability(rng, p_d_1) == CELL_COLOR(target)) {
+                            if (wrap)
+                                wrap_join(wrap, size, index, i_downright, +1, +1);
+                            value = djs_join2(map, sizes, index, i_downright);
+                        } else {
+                            if (wrap)
+                                wrap_join(wrap, size, i_right, i_down, -1, +1);
+                            value = djs_join2(map, sizes, i_right, i_down);
+                        }
+                        /* Update diagonal count based on color. */
+                        joins[CELL_COLOR(value)]++;
+                    } else {
+                        /* Diagonal connection was possible, but was omitted. */
+                        joins[2]++;
+                    }
+                }
+
+                bits &= bits - 1;
+            }
+        }
+
+        /* Save counters. */
+        m->djoins[0] = joins[0];
+        m->djoins[1] = joins[1];
+        m->djoins[2] = joins[2];
+    } else {
+        /* No diagonal joining; clear counters. */
+        m->djoins[0] = 0;
+        m->djoins[1] = 0;
+        m->djoins[2] = 0;
+    }
+
+    /* Flatten clusters. */
+    if (m->counts) {
+        cell *const  counts = m->counts;
+        const size_t total = 2*size*size;
+        size_t       unique[2] = { 0, 0 };
+        size_t       fill[2] = { 0, 0 };
+        size_t       index;
+
+        index = total;
+        while (index-->0)
+            counts[index] = 0;
+
+        index = size*size;
+        while (index-->0) {
+            const cell  c = djs_flatten(map, index);
+#ifdef VERIFY
+            if ((size_t)c >= total) {
+                fprintf(stderr, "matrix_generate(): Invalid cell value (%" PRI_CELL ", maximum %lu).\n", c, (unsigned long)(total-1));
+                exit(EXIT_FAILURE);
+            }
+#endif
+            unique[CELL_COLOR(c)] += !(counts[c]++);
+            fill[CELL_COLOR(c)]++;
+        }
+
+        m->unique[0] = unique[0];
+        m->unique[1] = unique[1];
+        m->fill[0] = fill[0];
+        m->fill[1] = fill[1];
+
+    } else {
+#ifdef VERIFY
+        const size_t  total = 2 * size * size;
+#endif
+        size_t        index = size * size;
+        size_t        fill[2] = { 0, 0 };
+
+        while (index-->0) {
+            const cell  c = djs_flatten(map, index);
+#ifdef VERIFY
+            if ((size_t)c >= total) {
+                fprintf(stderr, "matrix_generate(): Invalid cell value (%" PRI_CELL ", maximum %lu).\n", c, (unsigned long)(total-1));
+                exit(EXIT_FAILURE);
+            }
+#endif
+            fill[CELL_COLOR(c)]++;
+        }
+
+        m->fill[0] = fill[0];
+        m->fill[1] = fill[1];
+        m->unique[0] = 0;
+        m->unique[1] = 0;
+    }
+
+    /* Spanning test? */
+    if (m->span) {
+        cell *const span = m->span;
+        size_t spans[2] = { 0, 0 };
+        size_t n;
+
+        if (m->boundary == MATRIX_BOUNDARY_PERIODIC && m->wrap) {
+            /* A cluster spans if it wraps around vertically; such a cluster
+               has cells on the top row. Each cluster is listed only once. */
+            uint64_t *const  mark = m->spanmark;
+            size_t           i;
+            long             dx, dy;
+
+            n = 0;
+            for (i = 0; i < size; i++) {
+                const size_t    set = wrap_find(m->wrap, i, &dx, &dy);
+                const cell      c = CELL_INDEX(map[i]);
+                const uint64_t  bit = (uint64_t)1 << (c & 63);
+                if ((m->wrap[set].wraps & MATRIX_WRAPS_Y) && !(mark[c >> 6] & bit)) {
+                    mark[c >> 6] |= bit;
+                    span[n++] = map[i];
+                }
+            }
+            for (i = 0; i < n; i++) {
+                const cell  c = CELL_INDEX(span[i]);
+                mark[c >> 6] &= ~((uint64_t)1 << (c & 63));
+            }
+        } else {
+            /* Because the matrix is square, we can grab a minor speedup by
+               checking for vertical spanning. The map is flattened, so the
+               top and bottom rows contain the cluster roots. */
+            n = cell_common(span, map, map + (size-1)*size, size, m->spanmark);
+        }
+
+        /* In case of further user analysis, we append ~(cell)0 to the list. */
+        span[n] = ~(cell)0;
+
+        /* Count spanning clusters by color. */
+        while (n-->0)
+            spans[CELL_COLOR(span[n])]++;
+
+        /* Update counts. */
+        m->spans[0] = spans[0];
+        m->spans[1] = spans[1];
+    } else {
+        /* No spanning tests; clear counters. */
+        m->spans[0] = 0;
+        m->spans[1] = 0;
+    }
+
+    /* Done. */
+}
+
+#undef  matrix_generate
+#undef  djs_join4
+#undef  djs_join3
+#undef  djs_join2
+#undef  djs_grow
+#undef  djs_single
+#undef  djs_link
+#undef  djs_flatten
+#undef  djs_path
+#undef  djs_root
+#undef  cell_common
+#undef  cell
+#undef  MATRIX_NAME
+#undef  MATRIX_NAME2
+#undef  MATRIX_JOIN
+#undef  PRI_CELL
+#undef  MATRIX_CELL_BITS
+#undef  MATRIX_CELL
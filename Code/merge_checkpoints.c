@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "checkpoint.h"
+
+int usage(const char *argv0)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
+    fprintf(stderr, "       %s [ OPTIONS ] CHECKPOINT... [ > output.txt ]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "       output=FILE  Also save the merged statistics as a checkpoint in FILE.\n");
+    fprintf(stderr, "                    It can be merged further, but not continued.\n");
+    fprintf(stderr, "       bins=log2    Print the histogram in base-2 logarithmic bins of\n");
+    fprintf(stderr, "                    cluster sizes. Default is bins=exact.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "The checkpoints, from independent runs with checkpoint=FILE, must have\n");
+    fprintf(stderr, "the same size and probabilities. The merged distribution is printed in\n");
+    fprintf(stderr, "the same format as by distribution:\n");
+    fprintf(stderr, "   SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS  TOTAL_CLUSTERS\n");
+    fprintf(stderr, "or with bins=log2,\n");
+    fprintf(stderr, "   MIN_SIZE  MAX_SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS  TOTAL_CLUSTERS\n");
+    fprintf(stderr, "\n");
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    checkpoint   merged = CHECKPOINT_INITIALIZER;
+    checkpoint   cp = CHECKPOINT_INITIALIZER;
+    const char  *output = NULL;
+    int          log_bins = 0;
+    int          files = 0;
+    uint64_t    *seed;
+
+    int          arg, result;
+    int          k;
+    size_t       n;
+
+    if (argc < 2)
+        return usage(argv[0]);
+
+    seed = malloc((size_t)argc * sizeof seed[0]);
+    if (!seed) {
+        fprintf(stderr, "Not enough memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (arg = 1; arg < argc; arg++)
+        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
+            return usage(argv[0]);
+        else
+        if (!strncmp(argv[arg], "output=", 7) && argv[arg][7]) {
+            output = argv[arg] + 7;
+        } else
+        if (!strcmp(argv[arg], "bins=log2") || !strcmp(argv[arg], "bins=log")) {
+            log_bins = 1;
+        } else
+        if (!strcmp(argv[arg], "bins=exact") || !strcmp(argv[arg], "bins=1")) {
+            log_bins = 0;
+        } else {
+            result = checkpoint_load(&cp, argv[arg]);
+            if (result) {
+                fprintf(stderr, "%s: %s.\n", argv[arg], checkpoint_strerror(result));
+                return EXIT_FAILURE;
+            }
+
+            /* Runs with the same seed are not independent. */
+            if (cp.streams > 0) {
+                for (k = 0; k < files; k++)
+                    if (seed[k] == cp.seed) {
+                        fprintf(stderr, "%s: Warning: Seed %" PRIu64 " was already merged.\n",
+                                argv[arg], cp.seed);
+                        break;
+                    }
+                seed[files] = cp.seed;
+            } else
+                seed[files] = 0;
+
+            if (!files++) {
+                merged = cp;
+                memset(&cp, 0, sizeof cp);
+                merged.streams = 0;
+                merged.seed = 0;
+            } else {
+                result = checkpoint_merge(&merged, &cp);
+                free_checkpoint(&cp);
+                if (result) {
+                    fprintf(stderr, "%s: %s.\n", argv[arg], checkpoint_strerror(result));
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+
+    if (!files) {
+        fprintf(stderr, "No checkpoints specified.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (output) {
+        result = checkpoint_save(&merged, output);
+        if (result) {
+            fprintf(stderr, "%s: %s.\n", output, checkpoint_strerror(result));
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* The largest possible cluster has n cells. */
+    n = (size_t)merged.rows * (size_t)merged.cols;
+
+    printf("# checkpoints: %d\n", files);
+    printf("# size: %" PRIu64 " rows, %" PRIu64 " columns\n", merged.rows, merged.cols);
+    printf("# P(black): %.6f (%" PRIu64 "/18446744073709551615)\n",
+           (double)merged.param[0] / 18446744073709551616.0, merged.param[0]);
+    printf("# Iterations: %" PRIu64 "\n", merged.iterations);
+    printf("#\n");
+
+    checkpoint_print_histogram(stdout, merged.white_histogram, merged.black_histogram, n, log_bins);
+
+    /* Since we are exiting anyway, this is not really necessary. */
+    free_checkpoint(&merged);
+    free(seed);
+
+    /* All done. */
+    return EXIT_SUCCESS;
+}
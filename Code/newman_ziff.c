@@ -0,0 +1,247 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "newman_ziff.h"
+#include "options.h"
+
+#define  DEFAULT_ROWS     100
+#define  DEFAULT_COLS     100
+#define  DEFAULT_D_WHITE  0.0
+#define  DEFAULT_D_BLACK  0.0
+#define  DEFAULT_ITERS    1
+#define  DEFAULT_MIN      0.0
+#define  DEFAULT_MAX      1.0
+#define  DEFAULT_STEP     0.01
+
+int usage(const char *argv0)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
+    fprintf(stderr, "       %s OPTIONS [ > output.txt ]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "       rows=SIZE    Set number of rows. Default is %d.\n", DEFAULT_ROWS);
+    fprintf(stderr, "       cols=SIZE    Set number of columns. Default is %d.\n", DEFAULT_ROWS);
+    fprintf(stderr, "       L=SIZE       Set rows=SIZE and cols=SIZE.\n");
+    fprintf(stderr, "       black=MIN:MAX:STEP\n");
+    fprintf(stderr, "                    Probabilities of a cell to be black at which the curve\n");
+    fprintf(stderr, "                    is printed. Default is %g:%g:%g.\n", DEFAULT_MIN, DEFAULT_MAX, DEFAULT_STEP);
+    fprintf(stderr, "       dwhite=P     Set the probability of white cells connecting diagonally.\n");
+    fprintf(stderr, "                    Default is %g.\n", DEFAULT_D_WHITE);
+    fprintf(stderr, "       dblack=P     Set the probability of black cells connecting diagonally.\n");
+    fprintf(stderr, "                    Default is %g.\n", DEFAULT_D_BLACK);
+    fprintf(stderr, "       hist=P       Also collect the cluster size histograms at\n");
+    fprintf(stderr, "                    round(P*rows*cols) black cells. Can be repeated.\n");
+    fprintf(stderr, "       N=COUNT      Number of realizations. Default is %d.\n", DEFAULT_ITERS);
+    fprintf(stderr, "       seed=U64     Set the Xorshift64* pseudorandom number generator seed; nonzero.\n");
+    fprintf(stderr, "                    Default is to pick one randomly (based on time).\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Each realization adds black cells in random order (Newman-Ziff), and then\n");
+    fprintf(stderr, "white cells in the reverse order, so two passes give the whole curves.\n");
+    fprintf(stderr, "For each probability, the output has a line\n");
+    fprintf(stderr, "   BLACK : PERCENT%% SECOND LARGEST WPERCENT%% WSECOND WLARGEST\n");
+    fprintf(stderr, "where PERCENT is the percentage of matrices with a spanning black cluster,\n");
+    fprintf(stderr, "SECOND is the sum of squared black cluster sizes per cell, and LARGEST is the\n");
+    fprintf(stderr, "fraction of cells in the largest black cluster; the W columns are the same\n");
+    fprintf(stderr, "for the white clusters.\n");
+    fprintf(stderr, "Each histogram is printed after a comment line, with data lines\n");
+    fprintf(stderr, "   SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS\n");
+    fprintf(stderr, "\n");
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    int      rows = DEFAULT_ROWS;
+    int      cols = DEFAULT_COLS;
+    sweep    p_black = { DEFAULT_MIN, DEFAULT_MAX, DEFAULT_STEP };
+    double   d_white = DEFAULT_D_WHITE;
+    double   d_black = DEFAULT_D_BLACK;
+    double  *hist = NULL;
+    size_t   hists = 0;
+    long     iters = DEFAULT_ITERS;
+    uint64_t seed = 0;
+    nz       e = NZ_INITIALIZER;
+
+    int      arg, itemp;
+    uint64_t u64temp;
+    double   dtemp;
+    long     ltemp;
+    char     dummy;
+
+    double  *spanning[2], *second[2], *largest[2];
+    size_t   cells, n, k;
+    long     points, i;
+    int      color;
+
+    if (argc < 2)
+        return usage(argv[0]);
+
+    for (arg = 1; arg < argc; arg++)
+        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
+            return usage(argv[0]);
+        else
+        if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "l=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
+            rows = itemp;
+            cols = itemp;
+        } else
+        if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "s=%" SCNu64 " %c", &u64temp, &dummy) == 1) {
+            seed = u64temp;
+        } else
+        if (sscanf(argv[arg], "N=%ld %c", &ltemp, &dummy) == 1 ||
+            sscanf(argv[arg], "n=%ld %c", &ltemp, &dummy) == 1 ||
+            sscanf(argv[arg], "count=%ld %c", &ltemp, &dummy) == 1) {
+            iters = ltemp;
+        } else
+        if (sscanf(argv[arg], "rows=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "r=%d %c", &itemp, &dummy) == 1) {
+            rows = itemp;
+        } else
+        if (sscanf(argv[arg], "cols=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "c=%d %c", &itemp, &dummy) == 1) {
+            cols = itemp;
+        } else
+        if (!strncmp(argv[arg], "black=", 6) || !strncmp(argv[arg], "p=", 2)) {
+            if (!parse_sweep(argv[arg], "black", &p_black) &&
+                !parse_sweep(argv[arg], "p", &p_black)) {
+                fprintf(stderr, "%s: Invalid probability range.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+        } else
+        if (sscanf(argv[arg], "dwhite=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "dw=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "d0=%lf %c", &dtemp, &dummy) == 1) {
+            d_white = dtemp;
+        } else
+        if (sscanf(argv[arg], "dblack=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "db=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "d1=%lf %c", &dtemp, &dummy) == 1) {
+            d_black = dtemp;
+        } else
+        if (sscanf(argv[arg], "hist=%lf %c", &dtemp, &dummy) == 1) {
+            double *const  temp = realloc(hist, (hists + 1) * sizeof hist[0]);
+            if (!temp) {
+                fprintf(stderr, "Not enough memory.\n");
+                return EXIT_FAILURE;
+            }
+            hist = temp;
+            hist[hists++] = dtemp;
+        } else {
+            fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
+            return EXIT_FAILURE;
+        }
+
+    switch (init_nz(&e, rows, cols, d_white, d_black)) {
+    case 0: break; /* OK */
+    case ERR_INVALID:
+        fprintf(stderr, "Invalid size.\n");
+        return EXIT_FAILURE;
+    case ERR_TOOLARGE:
+        fprintf(stderr, "Size is too large.\n");
+        return EXIT_FAILURE;
+    case ERR_NOMEM:
+        fprintf(stderr, "Not enough memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    cells = (size_t)rows * (size_t)cols;
+
+    for (k = 0; k < hists; k++)
+        if (nz_add_snapshot(&e, (size_t)(hist[k] * (double)cells + 0.5)) < 0) {
+            fprintf(stderr, "hist=%g: Cannot collect a histogram.\n", hist[k]);
+            return EXIT_FAILURE;
+        }
+
+    if (!seed)
+        seed = randomize(NULL);
+
+    e.rng.state = seed;
+
+    printf("# seed: %" PRIu64 " (Xorshift 64*)\n", seed);
+    printf("# size: %d rows, %d columns\n", rows, cols);
+    printf("# P(white connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_white, e.d_white);
+    printf("# P(black connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_black, e.d_black);
+    fflush(stdout);
+
+    while (iters-->0)
+        iterate_nz(&e);
+
+    printf("# Realizations: %" PRIu64 " (Newman-Ziff)\n", e.iterations);
+    printf("#\n");
+    printf("# black : spanning%% second largest white_spanning%% white_second white_largest\n");
+
+    /* Per black cell count averages, of the white [0] and black [1] clusters. */
+    for (color = 0; color < 2; color++) {
+        spanning[color] = malloc((cells + 1) * sizeof (double));
+        second[color] = malloc((cells + 1) * sizeof (double));
+        largest[color] = malloc((cells + 1) * sizeof (double));
+        if (!spanning[color] || !second[color] || !largest[color]) {
+            fprintf(stderr, "Not enough memory.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    {
+        cluster_count  spanned = 0;
+        const double   scale = (e.iterations > 0) ? 1.0 / (double)e.iterations : 0.0;
+
+        /* A black cluster spans with at least as many black cells as it
+           first did, and a white one with at most as many. */
+        for (n = 0; n <= cells; n++) {
+            spanned += e.spans[CLUSTER_BLACK][n];
+            spanning[CLUSTER_BLACK][n] = scale * (double)spanned;
+        }
+        spanned = 0;
+        for (n = cells + 1; n-- > 0; ) {
+            spanned += e.spans[CLUSTER_WHITE][n];
+            spanning[CLUSTER_WHITE][n] = scale * (double)spanned;
+        }
+
+        for (color = 0; color < 2; color++)
+            for (n = 0; n <= cells; n++) {
+                second[color][n] = scale * e.second[color][n] / (double)cells;
+                largest[color][n] = scale * e.largest[color][n] / (double)cells;
+            }
+    }
+
+    points = sweep_points(&p_black);
+    for (i = 0; i < points; i++) {
+        const double  p = sweep_value(&p_black, i);
+        printf("%.6f : %.6f%% %.6f %.6f %.6f%% %.6f %.6f\n", p,
+               100.0 * nz_at(spanning[CLUSTER_BLACK], cells, p),
+               nz_at(second[CLUSTER_BLACK], cells, p),
+               nz_at(largest[CLUSTER_BLACK], cells, p),
+               100.0 * nz_at(spanning[CLUSTER_WHITE], cells, p),
+               nz_at(second[CLUSTER_WHITE], cells, p),
+               nz_at(largest[CLUSTER_WHITE], cells, p));
+    }
+
+    for (k = 0; k < e.snapshots; k++) {
+        const cluster_count *const  white = e.snapshot_histogram[CLUSTER_WHITE][k];
+        const cluster_count *const  black = e.snapshot_histogram[CLUSTER_BLACK][k];
+
+        printf("#\n");
+        printf("# %lu black cells (black=%.6f)\n", (unsigned long)e.snapshot_at[k],
+               (double)e.snapshot_at[k] / (double)cells);
+        printf("# size  white_clusters(size)  black_clusters(size)\n");
+        for (n = 1; n <= cells; n++)
+            if (white[n] || black[n])
+                printf("%lu %" FMT_COUNT " %" FMT_COUNT "\n", (unsigned long)n, white[n], black[n]);
+    }
+
+    /* Since we are exiting anyway, this is not really necessary. */
+    for (color = 0; color < 2; color++) {
+        free(largest[color]);
+        free(second[color]);
+        free(spanning[color]);
+    }
+    free(hist);
+    free_nz(&e);
+
+    /* All done. */
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,417 @@
+#ifndef   NEWMAN_ZIFF_H
+#define   NEWMAN_ZIFF_H
+/*
+Newman-Ziff single-pass engine for white and black clusters.
+
+Instead of generating a full matrix for every probability, each realization
+adds black cells one at a time in random order, joining them to their black
+neighbours using the disjoint set from clusters_modified.h. A diagonal
+neighbour is joined at probability d_black, decided when the second of the
+two cells is added, so each diagonal pair is tested exactly once. A second
+pass then adds the white cells to an empty matrix in the reverse order, so
+that the white cells at each step are exactly those that are not black at
+the same number of black cells, joining diagonal neighbours at d_white.
+
+For every number of black cells n, the engine records for each color the
+number of realizations that spanned the matrix (left-right or top-bottom, as
+in iterate()) with at most n black cells (black), or at least n black cells
+(white), the sum of squared cluster sizes, and the size of the largest
+cluster. The values at probability p follow from these by convolving with
+the binomial distribution; see nz_at().
+
+Cluster size histograms are collected at chosen numbers of black cells
+("snapshots"), at negligible cost, since the number of clusters of each size
+is maintained incrementally.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "clusters_modified.h"
+
+/* Cell not added yet in the disjoint set. */
+#define  NZ_EMPTY   (~(cluster_label)0)
+
+/* Boundary flags. */
+#define  NZ_TOP     1u
+#define  NZ_BOTTOM  2u
+#define  NZ_LEFT    4u
+#define  NZ_RIGHT   8u
+
+typedef struct {
+    /* Pseudo-random number generator used */
+    prng            rng;
+
+    /* Actual size of the matrix */
+    cluster_label   rows;
+    cluster_label   cols;
+
+    /* Number of realizations collected */
+    cluster_count   iterations;
+
+    /* Probabilities of white and black cells connecting diagonally */
+    uint64_t        d_white;
+    uint64_t        d_black;
+
+    /* Order in which the cells are made black, rows*cols */
+    cluster_label  *order;
+
+    /* Disjoint set of the color being added, rows*cols; NZ_EMPTY for
+       cells not added yet */
+    cluster_label  *djs;
+
+    /* Cluster size and boundary flags, valid for roots only */
+    cluster_label  *size;
+    unsigned char  *edge;
+
+    /* Number of clusters of each size, rows*cols+1 */
+    cluster_label  *sizes;
+
+    /* Per number of black cells n = 0 .. rows*cols, of the white [0] and
+       black [1] clusters: */
+    cluster_count  *spans[2];   /* Realizations that last (white) or first
+                                   (black) spanned at n */
+    double         *second[2];  /* Sum of squared cluster sizes */
+    double         *largest[2]; /* Sum of largest cluster sizes */
+
+    /* Cluster size histogram snapshots, in increasing snapshot_at order */
+    size_t          snapshots;
+    size_t         *snapshot_at;            /* Number of black cells */
+    cluster_count **snapshot_histogram[2];  /* rows*cols+1 each */
+} nz;
+#define  NZ_INITIALIZER  { {0}, 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL, NULL, \
+                           { NULL, NULL }, { NULL, NULL }, { NULL, NULL }, 0, NULL, { NULL, NULL } }
+
+/* Free all resources related to an engine. */
+STATIC_INLINE void free_nz(nz *e)
+{
+    if (e) {
+        size_t  i;
+        int     color;
+
+        for (color = 0; color < 2; color++) {
+            if (e->snapshot_histogram[color])
+                for (i = 0; i < e->snapshots; i++)
+                    free(e->snapshot_histogram[color][i]);
+            free(e->snapshot_histogram[color]);
+            free(e->largest[color]);
+            free(e->second[color]);
+            free(e->spans[color]);
+        }
+        free(e->snapshot_at);
+        free(e->sizes);
+        free(e->edge);
+        free(e->size);
+        free(e->djs);
+        free(e->order);
+        memset(e, 0, sizeof *e);
+    }
+}
+
+/* Initialize engine, for a matrix of specified size. */
+static int init_nz(nz *e, const int rows, const int cols, const double d_white, const double d_black)
+{
+    const cluster_label  label_rows = rows;
+    const cluster_label  label_cols = cols;
+    const cluster_label  cells = label_rows * label_cols;
+    size_t               i;
+    int                  color;
+
+    if (!e)
+        return ERR_INVALID;
+
+    memset(e, 0, sizeof *e);
+
+    if (rows < 1 || cols < 1)
+        return ERR_INVALID;
+
+    if ((cluster_label)(cells / label_rows) != label_cols ||
+        (cluster_label)(cells / label_cols) != label_rows ||
+        cells >= NZ_EMPTY)
+        return ERR_TOOLARGE;
+
+    e->order = malloc((size_t)cells * sizeof (cluster_label));
+    e->djs = malloc((size_t)cells * sizeof (cluster_label));
+    e->size = malloc((size_t)cells * sizeof (cluster_label));
+    e->edge = malloc((size_t)cells);
+    e->sizes = calloc((size_t)cells + 1, sizeof (cluster_label));
+    if (!e->order || !e->djs || !e->size || !e->edge || !e->sizes) {
+        free_nz(e);
+        return ERR_NOMEM;
+    }
+
+    for (color = 0; color < 2; color++) {
+        e->spans[color] = calloc((size_t)cells + 1, sizeof (cluster_count));
+        e->second[color] = calloc((size_t)cells + 1, sizeof (double));
+        e->largest[color] = calloc((size_t)cells + 1, sizeof (double));
+        if (!e->spans[color] || !e->second[color] || !e->largest[color]) {
+            free_nz(e);
+            return ERR_NOMEM;
+        }
+    }
+
+    e->rows = rows;
+    e->cols = cols;
+    e->d_white = probability_limit(d_white);
+    e->d_black = probability_limit(d_black);
+
+    for (i = 0; i < (size_t)cells; i++)
+        e->order[i] = i;
+
+    return 0;
+}
+
+/* Collect the white and black cluster size histograms whenever there are
+   'black' black cells. The snapshots are kept in increasing order of
+   black cells; returns the index of the new one, or a negative error. */
+static long nz_add_snapshot(nz *e, const size_t black)
+{
+    const size_t     cells = (size_t)e->rows * (size_t)e->cols;
+    cluster_count   *new_histogram[2];
+    size_t          *at;
+    size_t           k;
+    int              color;
+
+    if (black > cells)
+        return ERR_INVALID;
+
+    at = realloc(e->snapshot_at, (e->snapshots + 1) * sizeof at[0]);
+    if (!at)
+        return ERR_NOMEM;
+    e->snapshot_at = at;
+
+    for (color = 0; color < 2; color++) {
+        cluster_count **const  histogram = realloc(e->snapshot_histogram[color],
+                                                   (e->snapshots + 1) * sizeof histogram[0]);
+        if (!histogram)
+            return ERR_NOMEM;
+        e->snapshot_histogram[color] = histogram;
+    }
+
+    new_histogram[0] = calloc(cells + 1, sizeof (cluster_count));
+    new_histogram[1] = calloc(cells + 1, sizeof (cluster_count));
+    if (!new_histogram[0] || !new_histogram[1]) {
+        free(new_histogram[1]);
+        free(new_histogram[0]);
+        return ERR_NOMEM;
+    }
+
+    for (k = e->snapshots; k > 0 && at[k - 1] > black; k--) {
+        at[k] = at[k - 1];
+        e->snapshot_histogram[0][k] = e->snapshot_histogram[0][k - 1];
+        e->snapshot_histogram[1][k] = e->snapshot_histogram[1][k - 1];
+    }
+    at[k] = black;
+    e->snapshot_histogram[0][k] = new_histogram[0];
+    e->snapshot_histogram[1][k] = new_histogram[1];
+    e->snapshots++;
+
+    return (long)k;
+}
+
+/* Return a uniform random integer in [0, limit-1]. */
+STATIC_INLINE cluster_label  nz_below(prng *const rng, const cluster_label limit)
+{
+    const uint64_t  reject = UINT64_C(18446744073709551615)
+                           - UINT64_C(18446744073709551615) % limit;
+    uint64_t        state = rng->state;
+    uint64_t        value;
+
+    do {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        value = state * UINT64_C(2685821657736338717);
+    } while (value >= reject);
+
+    rng->state = state;
+
+    return value % limit;
+}
+
+/* Join the cluster of root 'root' with the cluster of black cell 'other'.
+   Returns the new root. */
+STATIC_INLINE cluster_label  nz_join(nz *const e, cluster_label root,
+                                     const cluster_label other,
+                                     double *const second)
+{
+    cluster_label  temp = djs_flatten(e->djs, other);
+
+    if (temp == root)
+        return root;
+
+    e->sizes[e->size[root]]--;
+    e->sizes[e->size[temp]]--;
+    *second += 2.0 * (double)e->size[root] * (double)e->size[temp];
+
+    if (djs_link(e->djs, root, temp) != root) {
+        const cluster_label  swap = temp;
+        temp = root;
+        root = swap;
+    }
+
+    e->size[root] += e->size[temp];
+    e->edge[root] |= e->edge[temp];
+    e->sizes[e->size[root]]++;
+
+    return root;
+}
+
+/* Record the cluster size histogram of 'color' in snapshot k. */
+STATIC_INLINE void nz_snapshot(nz *const e, const int color, const size_t k, const cluster_label big)
+{
+    cluster_count *const  histogram = e->snapshot_histogram[color][k];
+    cluster_label         s;
+
+    for (s = 1; s <= big; s++)
+        histogram[s] += e->sizes[s];
+}
+
+/* Add all cells of one color to an empty matrix, one at a time: the black
+   cells in 'order', or the white cells in the reverse order. The
+   statistics are recorded by the number of black cells n at each step. */
+static void nz_pass(nz *const e, const int color)
+{
+    prng          *const  rng = &(e->rng);
+    cluster_label  const  rows = e->rows;
+    cluster_label  const  cols = e->cols;
+    cluster_label  const  cells = rows * cols;
+    cluster_label *const  order = e->order;
+    cluster_label *const  djs = e->djs;
+    uint64_t       const  d = (color == CLUSTER_BLACK) ? e->d_black : e->d_white;
+    cluster_label         added, i, big = 0;
+    size_t                snapshot;
+    double                second = 0.0;
+    int                   spanned = 0;
+
+    for (i = 0; i < cells; i++)
+        djs[i] = NZ_EMPTY;
+    memset(e->sizes, 0, ((size_t)cells + 1) * sizeof e->sizes[0]);
+
+    /* Snapshots without cells of this color have no clusters. The black
+       pass goes through the snapshots upwards, the white one downwards;
+       'snapshot' is the next one in the black pass, and the one after the
+       next one in the white pass. */
+    if (color == CLUSTER_BLACK) {
+        snapshot = 0;
+        while (snapshot < e->snapshots && e->snapshot_at[snapshot] == 0)
+            snapshot++;
+    } else {
+        snapshot = e->snapshots;
+        while (snapshot > 0 && e->snapshot_at[snapshot - 1] == cells)
+            snapshot--;
+    }
+
+    for (added = 1; added <= cells; added++) {
+        const cluster_label  label = (color == CLUSTER_BLACK) ? order[added - 1] : order[cells - added];
+        const cluster_label  n = (color == CLUSTER_BLACK) ? added : cells - added;
+        const cluster_label  r = label / cols;
+        const cluster_label  c = label % cols;
+        cluster_label        root = label;
+
+        djs_init(djs, label);
+        e->size[label] = 1;
+        e->edge[label] = (r == 0        ? NZ_TOP    : 0)
+                       | (r == rows - 1 ? NZ_BOTTOM : 0)
+                       | (c == 0        ? NZ_LEFT   : 0)
+                       | (c == cols - 1 ? NZ_RIGHT  : 0);
+        e->sizes[1]++;
+        second += 1.0;
+
+        /* Left, right, up, down. */
+        if (c > 0 && djs[label - 1] != NZ_EMPTY)
+            root = nz_join(e, root, label - 1, &second);
+        if (c < cols - 1 && djs[label + 1] != NZ_EMPTY)
+            root = nz_join(e, root, label + 1, &second);
+        if (r > 0 && djs[label - cols] != NZ_EMPTY)
+            root = nz_join(e, root, label - cols, &second);
+        if (r < rows - 1 && djs[label + cols] != NZ_EMPTY)
+            root = nz_join(e, root, label + cols, &second);
+
+        /* Diagonals, each at probability d. */
+        if (r > 0 && c > 0 && djs[label - cols - 1] != NZ_EMPTY && probability(rng, d))
+            root = nz_join(e, root, label - cols - 1, &second);
+        if (r > 0 && c < cols - 1 && djs[label - cols + 1] != NZ_EMPTY && probability(rng, d))
+            root = nz_join(e, root, label - cols + 1, &second);
+        if (r < rows - 1 && c > 0 && djs[label + cols - 1] != NZ_EMPTY && probability(rng, d))
+            root = nz_join(e, root, label + cols - 1, &second);
+        if (r < rows - 1 && c < cols - 1 && djs[label + cols + 1] != NZ_EMPTY && probability(rng, d))
+            root = nz_join(e, root, label + cols + 1, &second);
+
+        if (!spanned &&
+            ((e->edge[root] & (NZ_LEFT | NZ_RIGHT)) == (NZ_LEFT | NZ_RIGHT) ||
+             (e->edge[root] & (NZ_TOP | NZ_BOTTOM)) == (NZ_TOP | NZ_BOTTOM))) {
+            e->spans[color][n]++;
+            spanned = 1;
+        }
+
+        if (big < e->size[root])
+            big = e->size[root];
+
+        e->second[color][n] += second;
+        e->largest[color][n] += (double)big;
+
+        if (color == CLUSTER_BLACK)
+            while (snapshot < e->snapshots && e->snapshot_at[snapshot] == n)
+                nz_snapshot(e, color, snapshot++, big);
+        else
+            while (snapshot > 0 && e->snapshot_at[snapshot - 1] == n)
+                nz_snapshot(e, color, --snapshot, big);
+    }
+}
+
+/* Do one realization: shuffle the order in which the cells become black,
+   then add the black cells in that order, and the white cells in the
+   reverse order. */
+static void iterate_nz(nz *const e)
+{
+    prng          *const  rng = &(e->rng);
+    cluster_label  const  cells = e->rows * e->cols;
+    cluster_label *const  order = e->order;
+    cluster_label         n;
+
+    for (n = cells - 1; n > 0; n--) {
+        const cluster_label  k = nz_below(rng, n + 1);
+        const cluster_label  temp = order[n];
+        order[n] = order[k];
+        order[k] = temp;
+    }
+
+    nz_pass(e, CLUSTER_BLACK);
+    nz_pass(e, CLUSTER_WHITE);
+
+    e->iterations++;
+}
+
+/* Probability that a matrix with probability p of black cells has
+   exactly n of its 'cells' cells black, via the log-gamma function. */
+STATIC_INLINE double  nz_binomial(const size_t cells, const size_t n, const double p)
+{
+    return exp(lgamma((double)cells + 1.0) - lgamma((double)n + 1.0) - lgamma((double)(cells - n) + 1.0)
+               + (double)n * log(p) + (double)(cells - n) * log1p(-p));
+}
+
+/* Convolve per-black-cell-count values value[0..cells] with the binomial
+   distribution, giving the value at probability p. Terms further than
+   twelve standard deviations from the mean are negligible. */
+static double nz_at(const double *const value, const size_t cells, const double p)
+{
+    double  mean, width, sum = 0.0;
+    size_t  n, nmin, nmax;
+
+    if (p <= 0.0)
+        return value[0];
+    if (p >= 1.0)
+        return value[cells];
+
+    mean = p * (double)cells;
+    width = 12.0 * sqrt(mean * (1.0 - p)) + 1.0;
+    nmin = (mean > width) ? (size_t)(mean - width) : 0;
+    nmax = (mean + width < (double)cells) ? (size_t)(mean + width) : cells;
+
+    for (n = nmin; n <= nmax; n++)
+        sum += nz_binomial(cells, n, p) * value[n];
+
+    return sum;
+}
+
+#endif /* NEWMAN_ZIFF_H */
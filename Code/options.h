@@ -0,0 +1,139 @@
+#ifndef   OPTIONS_H
+#define   OPTIONS_H
+/*
+Command-line options and output shared by distribution_modified and
+ensemble.
+
+Include after clusters_modified.h. A parameter is either a single value
+or a sweep, "NAME=P" or "NAME=MIN:MAX:STEP". parse_cluster_option()
+handles the span=, boundary= and euler= options, and print_euler() the
+Euler number columns of a point.
+*/
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "clusters_modified.h"
+
+/* Parameter that is either a single value, or swept from min to max. */
+typedef struct {
+    double  min;
+    double  max;
+    double  step;
+} sweep;
+
+/* Parse "NAME=P" or "NAME=MIN:MAX:STEP". The values must be within [0, 1].
+   Returns nonzero if successful. */
+STATIC_INLINE int parse_sweep(const char *arg, const char *name, sweep *const to)
+{
+    const size_t  namelen = strlen(name);
+    double        min, max, step;
+    char          dummy;
+
+    if (strncmp(arg, name, namelen) || arg[namelen] != '=')
+        return 0;
+    arg += namelen + 1;
+
+    if (sscanf(arg, "%lf:%lf:%lf %c", &min, &max, &step, &dummy) == 3) {
+        if (step == 0.0 || (max - min) / step < 0.0 ||
+            !(min >= 0.0 && min <= 1.0) || !(max >= 0.0 && max <= 1.0))
+            return 0;
+        to->min = min;
+        to->max = max;
+        to->step = step;
+        return 1;
+    }
+
+    if (sscanf(arg, "%lf %c", &min, &dummy) == 1) {
+        if (!(min >= 0.0 && min <= 1.0))
+            return 0;
+        to->min = min;
+        to->max = min;
+        to->step = 0.0;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Number of points in a sweep. The last point does not pass max; the
+   small tolerance keeps it when max - min is a multiple of the step. */
+STATIC_INLINE long sweep_points(const sweep *const s)
+{
+    if (s->step == 0.0)
+        return 1;
+    return 1 + (long)floor((s->max - s->min) / s->step + 1e-9);
+}
+
+/* Value of a sweep at point i. */
+STATIC_INLINE double sweep_value(const sweep *const s, const long i)
+{
+    return s->min + (double)i * s->step;
+}
+
+/* Parse a span=, boundary= or euler= option into the corresponding
+   variable. Returns 1 if successful, 0 if 'arg' is none of these, or -1
+   (after printing an error) if it is an invalid one. */
+STATIC_INLINE int parse_cluster_option(const char *const arg, int *const span_mode,
+                                       int *const boundary, int *const euler)
+{
+    if (!strncmp(arg, "span=", 5)) {
+        const char *const  mode = arg + 5;
+        if (!strcmp(mode, "horizontal") || !strcmp(mode, "h"))
+            *span_mode = CLUSTER_SPAN_HORIZONTAL;
+        else
+        if (!strcmp(mode, "vertical") || !strcmp(mode, "v"))
+            *span_mode = CLUSTER_SPAN_VERTICAL;
+        else
+        if (!strcmp(mode, "either") || !strcmp(mode, "any"))
+            *span_mode = CLUSTER_SPAN_EITHER;
+        else
+        if (!strcmp(mode, "both") || !strcmp(mode, "all"))
+            *span_mode = CLUSTER_SPAN_BOTH;
+        else {
+            fprintf(stderr, "%s: Unknown spanning criterion.\n", arg);
+            return -1;
+        }
+        return 1;
+    }
+
+    if (!strcmp(arg, "boundary=periodic") || !strcmp(arg, "boundary=torus")) {
+        *boundary = CLUSTER_BOUNDARY_PERIODIC;
+        return 1;
+    }
+    if (!strcmp(arg, "boundary=open")) {
+        *boundary = CLUSTER_BOUNDARY_OPEN;
+        return 1;
+    }
+
+    if (!strcmp(arg, "euler=yes") || !strcmp(arg, "euler=1")) {
+        *euler = 1;
+        return 1;
+    }
+    if (!strcmp(arg, "euler=no") || !strcmp(arg, "euler=0")) {
+        *euler = 0;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Print the means and sample variances of the white and black Euler
+   numbers over 'iterations' matrices, from their sums and sums of
+   squares, as four columns continuing the line of a point. */
+STATIC_INLINE void print_euler(FILE *const out, const uint64_t iterations,
+                               const int64_t white_euler, const int64_t black_euler,
+                               const double white_euler2, const double black_euler2)
+{
+    const double  count = (double)iterations;
+    const double  white = (double)white_euler / count;
+    const double  black = (double)black_euler / count;
+
+    /* Sample variances; zero for a single iteration. */
+    fprintf(out, " %.6f %.6f %.6f %.6f", white,
+            (iterations > 1) ? (white_euler2 - count * white * white) / (count - 1.0) : 0.0,
+            black,
+            (iterations > 1) ? (black_euler2 - count * black * black) / (count - 1.0) : 0.0);
+}
+
+#endif /* OPTIONS_H */
@@ -0,0 +1,173 @@
+#ifndef   PERCOLATION_H
+#define   PERCOLATION_H
+/*
+libpercolation: the cluster and matrix labelling engines as a library.
+
+The engines themselves are header-only (clusters_modified.h and matrix.h),
+and cannot be included in the same translation unit, because both define
+their own prng and disjoint set helpers. This interface hides each one
+behind an opaque handle, so drivers in C, C++ or Python can run them
+in-process, without forking a program per data point.
+
+Every handle goes through the same life cycle:
+
+    create, set_ (configure), run, query (and histogram, map), destroy
+
+Functions returning int return 0 if successful, or one of the negative
+PERC_ERR_ codes; see perc_strerror(). Build with 'make lib'.
+*/
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Incremented whenever a function or structure below changes. */
+#define  PERC_API_VERSION  2
+
+/* Error codes; the same values as the ERR_ codes in clusters_modified.h. */
+#define  PERC_ERR_INVALID   -1   /* Invalid function parameter */
+#define  PERC_ERR_TOOLARGE  -2   /* Matrix size is too large */
+#define  PERC_ERR_NOMEM     -3   /* Out of memory */
+
+/* Cell and cluster colors */
+#define  PERC_WHITE  0
+#define  PERC_BLACK  1
+
+/* Boundary conditions */
+#define  PERC_BOUNDARY_OPEN      0   /* Cells outside the matrix are empty */
+#define  PERC_BOUNDARY_PERIODIC  1   /* The matrix wraps around (a torus) */
+
+/* Spanning criteria of the cluster engine */
+#define  PERC_SPAN_HORIZONTAL  1   /* Left to right */
+#define  PERC_SPAN_VERTICAL    2   /* Top to bottom */
+#define  PERC_SPAN_EITHER      3   /* Left to right, or top to bottom */
+#define  PERC_SPAN_BOTH        4   /* Left to right and top to bottom */
+
+/* Random number generators of the cluster engine */
+#define  PERC_RNG_SEQUENTIAL  0   /* One Xorshift64* stream */
+#define  PERC_RNG_COUNTER     1   /* Counter-based, per cell of each matrix */
+
+/* Internal arrays of the cluster engine; see perc_cluster_array() */
+#define  PERC_ARRAY_WHITE_HISTOGRAM  0   /* Clusters per size, 0..rows*cols */
+#define  PERC_ARRAY_BLACK_HISTOGRAM  1
+#define  PERC_ARRAY_LABELS           2   /* Disjoint set of the last matrix */
+#define  PERC_ARRAY_COLORS           3   /* Cell colors of the last matrix */
+
+typedef struct perc_cluster  perc_cluster;
+typedef struct perc_matrix   perc_matrix;
+
+/* Statistics collected by the cluster engine since the last reset. */
+typedef struct {
+    int       rows;
+    int       cols;
+    uint64_t  iterations;       /* Matrices labelled */
+    uint64_t  white_spans;      /* Matrices with a spanning white cluster */
+    uint64_t  black_spans;      /* Matrices with a spanning black cluster */
+    int64_t   white_euler;      /* Sum of the Euler numbers of white cells */
+    int64_t   black_euler;
+    double    white_euler2;     /* Sum of their squares */
+    double    black_euler2;
+} perc_cluster_stats;
+
+/* Statistics of the last matrix generated by the matrix engine. */
+typedef struct {
+    size_t    size;             /* The matrix has size*size cells */
+    uint64_t  fill[2];          /* Cells of each color */
+    uint64_t  unique[2];        /* Clusters of each color */
+    uint64_t  spans[2];         /* Spanning clusters of each color */
+    uint64_t  djoins[3];        /* White and black diagonal joins, and omitted ones */
+} perc_matrix_stats;
+
+/* An internal array of an engine, for access without copying. Element
+   (r, c) is at element offset r*stride + c from data. The elements are
+   unsigned integers of 'size' bytes. */
+typedef struct {
+    void    *data;
+    size_t   rows;
+    size_t   cols;
+    size_t   stride;
+    size_t   size;
+} perc_array;
+
+int          perc_version(void);
+const char  *perc_strerror(const int retval);
+
+/* Cluster engine: cluster size histograms over many random matrices.
+   A new handle has all probabilities zero, open boundaries, PERC_SPAN_EITHER,
+   and a sequential generator seeded from the clock. */
+int     perc_cluster_create(perc_cluster **const handle, const int rows, const int cols);
+void    perc_cluster_destroy(perc_cluster *const handle);
+
+/* Set the probability of black cells, and of diagonal connections between
+   white and between black cells. This also resets the statistics. */
+int     perc_cluster_set_probability(perc_cluster *const handle, const double p_black,
+                                     const double d_white, const double d_black);
+int     perc_cluster_set_boundary(perc_cluster *const handle, const int boundary);
+int     perc_cluster_set_span(perc_cluster *const handle, const int span_mode);
+
+/* Select the generator; a zero seed picks one from the clock. With
+   PERC_RNG_COUNTER, 'realization' is the number of the next matrix. */
+int     perc_cluster_set_rng(perc_cluster *const handle, const int rng_mode,
+                             const uint64_t seed, const uint64_t realization);
+
+/* Label each matrix in 'tiles' threads; needs PERC_RNG_COUNTER.
+   The results are the same for any number of tiles. */
+int     perc_cluster_set_tiles(perc_cluster *const handle, const int tiles);
+
+/* Clear the statistics, keeping the configuration and generator state. */
+int     perc_cluster_reset(perc_cluster *const handle);
+
+/* Label 'iterations' more matrices. */
+int     perc_cluster_run(perc_cluster *const handle, const uint64_t iterations);
+
+int     perc_cluster_query(const perc_cluster *const handle, perc_cluster_stats *const stats);
+
+/* Copy the number of clusters of each size 0..n-1 of the given color to
+   'to'. Returns the number of sizes copied; sizes above rows*cols never
+   occur, and are not copied. */
+size_t  perc_cluster_histogram(const perc_cluster *const handle, const int color,
+                               uint64_t *const to, const size_t n);
+
+/* Describe an internal array. The array stays at the same address until the
+   handle is destroyed; its contents change during perc_cluster_run() and
+   perc_cluster_reset(). The labels are the engine's own disjoint set
+   values, not normalized to the roots. */
+int     perc_cluster_array(perc_cluster *const handle, const int which, perc_array *const array);
+
+/* Matrix engine: one random square matrix at a time, with the cluster
+   of each cell. A new handle has probability 0.5 of nonzero (black) cells,
+   no diagonal connections, open boundaries, and a seed from the clock. */
+int     perc_matrix_create(perc_matrix **const handle, const size_t size);
+void    perc_matrix_destroy(perc_matrix *const handle);
+
+int     perc_matrix_set_probability(perc_matrix *const handle, const double nonzero,
+                                    const double diagonal, const double diagonal_nonzero);
+int     perc_matrix_set_boundary(perc_matrix *const handle, const int boundary);
+
+/* Set the Xorshift64* state; a zero seed picks one from the clock. */
+int     perc_matrix_set_seed(perc_matrix *const handle, const uint64_t seed);
+
+/* Generate and label a new matrix. */
+int     perc_matrix_run(perc_matrix *const handle);
+
+int     perc_matrix_query(const perc_matrix *const handle, perc_matrix_stats *const stats);
+
+/* Copy the first n cells (at most size*size) to 'to', in row-major order.
+   Each value is the cluster index times two plus the color. Returns the
+   number of cells copied. */
+size_t  perc_matrix_map(const perc_matrix *const handle, uint64_t *const to, const size_t n);
+
+/* Describe the cell map, as perc_cluster_array() does. */
+int     perc_matrix_array(perc_matrix *const handle, perc_array *const array);
+
+/* Copy at most n of the spanning cluster values (as in perc_matrix_map())
+   to 'to'. Returns the number of spanning clusters. */
+size_t  perc_matrix_spanning(const perc_matrix *const handle, uint64_t *const to, const size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERCOLATION_H */
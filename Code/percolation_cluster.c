@@ -0,0 +1,246 @@
+/* libpercolation: the cluster engine of clusters_modified.h behind
+   the perc_cluster_ functions of percolation.h. */
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "percolation.h"
+#include "clusters_modified.h"
+#include "tiles.h"
+
+struct perc_cluster {
+    cluster    cl;
+    double     p_black;
+    double     d_white;
+    double     d_black;
+    int        tiles;
+    tile_pool  pool;            /* Threads of the tiles, if tiles > 1 */
+};
+
+int perc_version(void)
+{
+    return PERC_API_VERSION;
+}
+
+const char *perc_strerror(const int retval)
+{
+    switch (retval) {
+    case 0:                 return "OK";
+    case PERC_ERR_INVALID:  return "Invalid parameters";
+    case PERC_ERR_TOOLARGE: return "Size is too large";
+    case PERC_ERR_NOMEM:    return "Not enough memory";
+    default:                return "(Unknown error)";
+    }
+}
+
+int perc_cluster_create(perc_cluster **const handle, const int rows, const int cols)
+{
+    perc_cluster  *pc;
+    int            result;
+
+    if (!handle)
+        return PERC_ERR_INVALID;
+    *handle = NULL;
+
+    pc = malloc(sizeof *pc);
+    if (!pc)
+        return PERC_ERR_NOMEM;
+
+    result = init_cluster(&(pc->cl), rows, cols, 0.0, 0.0, 0.0);
+    if (result) {
+        free(pc);
+        return result;
+    }
+
+    randomize(&(pc->cl.rng));
+    pc->p_black = 0.0;
+    pc->d_white = 0.0;
+    pc->d_black = 0.0;
+    pc->tiles = 1;
+    memset(&(pc->pool), 0, sizeof pc->pool);
+
+    *handle = pc;
+    return 0;
+}
+
+void perc_cluster_destroy(perc_cluster *const handle)
+{
+    if (handle) {
+        free_tile_pool(&(handle->pool));
+        free_cluster(&(handle->cl));
+        free(handle);
+    }
+}
+
+int perc_cluster_set_probability(perc_cluster *const handle, const double p_black,
+                                 const double d_white, const double d_black)
+{
+    if (!handle ||
+        !(p_black >= 0.0 && p_black <= 1.0) ||
+        !(d_white >= 0.0 && d_white <= 1.0) ||
+        !(d_black >= 0.0 && d_black <= 1.0))
+        return PERC_ERR_INVALID;
+
+    handle->p_black = p_black;
+    handle->d_white = d_white;
+    handle->d_black = d_black;
+
+    return reset_cluster(&(handle->cl), p_black, d_white, d_black);
+}
+
+int perc_cluster_set_boundary(perc_cluster *const handle, const int boundary)
+{
+    if (!handle)
+        return PERC_ERR_INVALID;
+
+    return set_cluster_boundary(&(handle->cl), boundary);
+}
+
+int perc_cluster_set_span(perc_cluster *const handle, const int span_mode)
+{
+    if (!handle || span_mode < CLUSTER_SPAN_HORIZONTAL || span_mode > CLUSTER_SPAN_BOTH)
+        return PERC_ERR_INVALID;
+
+    handle->cl.span_mode = span_mode;
+    return 0;
+}
+
+int perc_cluster_set_rng(perc_cluster *const handle, const int rng_mode,
+                         const uint64_t seed, const uint64_t realization)
+{
+    if (!handle || (rng_mode != CLUSTER_RNG_SEQUENTIAL && rng_mode != CLUSTER_RNG_COUNTER))
+        return PERC_ERR_INVALID;
+
+    handle->cl.rng_mode = rng_mode;
+    handle->cl.rng_seed = (seed) ? seed : randomize(NULL);
+    handle->cl.rng.state = handle->cl.rng_seed;
+    handle->cl.realization = realization;
+    return 0;
+}
+
+int perc_cluster_set_tiles(perc_cluster *const handle, const int tiles)
+{
+    int  result;
+
+    if (!handle || tiles < 1)
+        return PERC_ERR_INVALID;
+    if (tiles > 1 && handle->cl.rng_mode != CLUSTER_RNG_COUNTER)
+        return PERC_ERR_INVALID;
+
+    /* The tile threads are started here, and reused by every run. */
+    free_tile_pool(&(handle->pool));
+    handle->tiles = 1;
+    if (tiles > 1) {
+        result = init_tile_pool(&(handle->pool), &(handle->cl), tiles);
+        if (result)
+            return result;
+    }
+
+    handle->tiles = tiles;
+    return 0;
+}
+
+int perc_cluster_reset(perc_cluster *const handle)
+{
+    if (!handle)
+        return PERC_ERR_INVALID;
+
+    return reset_cluster(&(handle->cl), handle->p_black, handle->d_white, handle->d_black);
+}
+
+int perc_cluster_run(perc_cluster *const handle, uint64_t iterations)
+{
+    if (!handle)
+        return PERC_ERR_INVALID;
+
+    while (iterations-->0)
+        if (handle->tiles > 1 && handle->cl.rng_mode == CLUSTER_RNG_COUNTER) {
+            if (iterate_tiled(&(handle->pool)))
+                return PERC_ERR_NOMEM;
+        } else
+            iterate(&(handle->cl));
+
+    return 0;
+}
+
+int perc_cluster_query(const perc_cluster *const handle, perc_cluster_stats *const stats)
+{
+    if (!handle || !stats)
+        return PERC_ERR_INVALID;
+
+    stats->rows = (int)handle->cl.rows;
+    stats->cols = (int)handle->cl.cols;
+    stats->iterations = handle->cl.iterations;
+    stats->white_spans = handle->cl.white_spans;
+    stats->black_spans = handle->cl.black_spans;
+    stats->white_euler = handle->cl.white_euler;
+    stats->black_euler = handle->cl.black_euler;
+    stats->white_euler2 = handle->cl.white_euler2;
+    stats->black_euler2 = handle->cl.black_euler2;
+    return 0;
+}
+
+size_t perc_cluster_histogram(const perc_cluster *const handle, const int color,
+                              uint64_t *const to, size_t n)
+{
+    const cluster_count  *histogram;
+    size_t                i;
+
+    if (!handle || !to)
+        return 0;
+
+    if (color == CLUSTER_WHITE)
+        histogram = handle->cl.white_histogram;
+    else
+    if (color == CLUSTER_BLACK)
+        histogram = handle->cl.black_histogram;
+    else
+        return 0;
+
+    if (n > (size_t)handle->cl.rows * (size_t)handle->cl.cols + 1)
+        n = (size_t)handle->cl.rows * (size_t)handle->cl.cols + 1;
+
+    for (i = 0; i < n; i++)
+        to[i] = histogram[i];
+
+    return n;
+}
+
+int perc_cluster_array(perc_cluster *const handle, const int which, perc_array *const array)
+{
+    cluster *const  cl = (handle) ? &(handle->cl) : NULL;
+
+    if (!cl || !array)
+        return PERC_ERR_INVALID;
+
+    switch (which) {
+    case PERC_ARRAY_WHITE_HISTOGRAM:
+    case PERC_ARRAY_BLACK_HISTOGRAM:
+        array->data = (which == PERC_ARRAY_WHITE_HISTOGRAM) ? cl->white_histogram : cl->black_histogram;
+        array->rows = 1;
+        array->cols = (size_t)cl->rows * (size_t)cl->cols + 1;
+        array->stride = array->cols;
+        array->size = sizeof (cluster_count);
+        return 0;
+
+    case PERC_ARRAY_LABELS:
+        array->data = cl->djs;
+        array->rows = cl->rows;
+        array->cols = cl->cols;
+        array->stride = cl->cols;
+        array->size = sizeof (cluster_label);
+        return 0;
+
+    case PERC_ARRAY_COLORS:
+        /* The color map has a padding row above and below, and a padding
+           column on the right. */
+        array->data = cl->map + cl->cols + 2;
+        array->rows = cl->rows;
+        array->cols = cl->cols;
+        array->stride = (size_t)cl->cols + 1;
+        array->size = sizeof (cluster_color);
+        return 0;
+
+    default:
+        return PERC_ERR_INVALID;
+    }
+}
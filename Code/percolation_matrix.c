@@ -0,0 +1,167 @@
+/* libpercolation: the matrix engine of matrix.h behind
+   the perc_matrix_ functions of percolation.h. */
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "percolation.h"
+#include "matrix.h"
+
+struct perc_matrix {
+    matrix  m;
+    int     generated;
+};
+
+/* Map a matrix_strerror() code to a PERC_ERR_ code. */
+static int matrix_error(const int retval)
+{
+    switch (retval) {
+    case 0:  return 0;
+    case 3:  return PERC_ERR_TOOLARGE;
+    case 4:  return PERC_ERR_NOMEM;
+    default: return PERC_ERR_INVALID;
+    }
+}
+
+int perc_matrix_create(perc_matrix **const handle, const size_t size)
+{
+    perc_matrix  *pm;
+    int           result;
+
+    if (!handle)
+        return PERC_ERR_INVALID;
+    *handle = NULL;
+
+    pm = malloc(sizeof *pm);
+    if (!pm)
+        return PERC_ERR_NOMEM;
+
+    result = matrix_init(&(pm->m), size, STATS_ALL);
+    if (result) {
+        free(pm);
+        return matrix_error(result);
+    }
+    pm->generated = 0;
+
+    *handle = pm;
+    return 0;
+}
+
+void perc_matrix_destroy(perc_matrix *const handle)
+{
+    if (handle) {
+        matrix_free(&(handle->m));
+        free(handle);
+    }
+}
+
+int perc_matrix_set_probability(perc_matrix *const handle, const double nonzero,
+                                const double diagonal, const double diagonal_nonzero)
+{
+    if (!handle ||
+        !(nonzero >= 0.0 && nonzero <= 1.0) ||
+        !(diagonal >= 0.0 && diagonal <= 1.0) ||
+        !(diagonal_nonzero >= 0.0 && diagonal_nonzero <= 1.0))
+        return PERC_ERR_INVALID;
+
+    handle->m.nonzero = nonzero;
+    handle->m.diagonal = diagonal;
+    handle->m.diagonal_nonzero = diagonal_nonzero;
+    return 0;
+}
+
+int perc_matrix_set_boundary(perc_matrix *const handle, const int boundary)
+{
+    if (!handle)
+        return PERC_ERR_INVALID;
+
+    return matrix_error(matrix_set_boundary(&(handle->m), boundary));
+}
+
+int perc_matrix_set_seed(perc_matrix *const handle, const uint64_t seed)
+{
+    if (!handle)
+        return PERC_ERR_INVALID;
+
+    if (seed)
+        handle->m.rng.state = seed;
+    else
+        prng_init(&(handle->m.rng));
+    return 0;
+}
+
+int perc_matrix_run(perc_matrix *const handle)
+{
+    if (!handle)
+        return PERC_ERR_INVALID;
+
+    matrix_generate(&(handle->m));
+    handle->generated = 1;
+    return 0;
+}
+
+int perc_matrix_query(const perc_matrix *const handle, perc_matrix_stats *const stats)
+{
+    if (!handle || !stats)
+        return PERC_ERR_INVALID;
+
+    memset(stats, 0, sizeof *stats);
+    stats->size = handle->m.size;
+    if (!handle->generated)
+        return 0;
+
+    stats->fill[0] = handle->m.fill[0];
+    stats->fill[1] = handle->m.fill[1];
+    stats->unique[0] = handle->m.unique[0];
+    stats->unique[1] = handle->m.unique[1];
+    stats->spans[0] = handle->m.spans[0];
+    stats->spans[1] = handle->m.spans[1];
+    if (handle->m.diagonal > 0.0) {
+        stats->djoins[0] = handle->m.djoins[0];
+        stats->djoins[1] = handle->m.djoins[1];
+        stats->djoins[2] = handle->m.djoins[2];
+    }
+    return 0;
+}
+
+size_t perc_matrix_map(const perc_matrix *const handle, uint64_t *const to, size_t n)
+{
+    size_t  i;
+
+    if (!handle || !to || !handle->generated)
+        return 0;
+
+    if (n > handle->m.size * handle->m.size)
+        n = handle->m.size * handle->m.size;
+
+    for (i = 0; i < n; i++)
+        to[i] = matrix_cell(&(handle->m), i);
+
+    return n;
+}
+
+size_t perc_matrix_spanning(const perc_matrix *const handle, uint64_t *const to, const size_t n)
+{
+    size_t  spans, i;
+
+    if (!handle || !handle->generated || !handle->m.span)
+        return 0;
+
+    spans = (size_t)handle->m.spans[0] + (size_t)handle->m.spans[1];
+    for (i = 0; i < spans && i < n && to; i++)
+        to[i] = matrix_span(&(handle->m), i);
+
+    return spans;
+}
+
+int perc_matrix_array(perc_matrix *const handle, perc_array *const array)
+{
+    if (!handle || !array)
+        return PERC_ERR_INVALID;
+
+    array->data = handle->m.map;
+    array->rows = handle->m.size;
+    array->cols = handle->m.size;
+    array->stride = handle->m.size;
+    array->size = (size_t)handle->m.cell_bits / 8;
+    return 0;
+}
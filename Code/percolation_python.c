@@ -0,0 +1,577 @@
+/* Python module 'percolation' over libpercolation; see percolation.h.
+
+   Build with 'make python', which needs the Python headers and NumPy.
+
+       import percolation, threading
+       c = percolation.Cluster(64, 64, p_black=0.59, rng="counter", seed=1)
+       c.run(1000)
+       c.black_histogram       # NumPy view of the engine's own array
+
+   The histograms, the labels (djs) and the cell colors (map) of the last
+   matrix are NumPy arrays sharing the engine's memory, so reading them
+   copies nothing. They are read-only, and keep the engine alive. run()
+   releases the GIL, so replicas in different Python threads run in
+   parallel; each object can only run in one thread at a time.
+*/
+#define  PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define  NPY_NO_DEPRECATED_API  NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+#include "percolation.h"
+
+typedef struct {
+    PyObject_HEAD
+    perc_cluster  *handle;
+    int            busy;        /* run() in progress, without the GIL */
+} ClusterObject;
+
+typedef struct {
+    PyObject_HEAD
+    perc_matrix   *handle;
+    int            busy;
+} MatrixObject;
+
+/* Set a Python exception for a PERC_ERR_ code, and return NULL. */
+static PyObject *perc_error(const int retval)
+{
+    PyErr_SetString((retval == PERC_ERR_NOMEM) ? PyExc_MemoryError : PyExc_ValueError,
+                    perc_strerror(retval));
+    return NULL;
+}
+
+/* Raise RuntimeError if the object is running in another thread. */
+static int check_busy(const int busy)
+{
+    if (busy) {
+        PyErr_SetString(PyExc_RuntimeError, "run() is in progress in another thread");
+        return -1;
+    }
+    return 0;
+}
+
+/* Raise RuntimeError if __init__() is called again on an initialized
+   object: the NumPy views of its arrays point into the engine, so it
+   cannot be replaced. */
+static int check_fresh(const void *const handle)
+{
+    if (handle) {
+        PyErr_SetString(PyExc_RuntimeError, "Object is already initialized");
+        return -1;
+    }
+    return 0;
+}
+
+/* Wrap an engine array in a read-only NumPy array owned by 'owner'. */
+static PyObject *array_view(PyObject *const owner, const perc_array *const array, const int vector)
+{
+    npy_intp   dims[2], strides[2];
+    PyObject  *result;
+    int        type;
+
+    switch (array->size) {
+    case 1:  type = NPY_UINT8;  break;
+    case 2:  type = NPY_UINT16; break;
+    case 4:  type = NPY_UINT32; break;
+    case 8:  type = NPY_UINT64; break;
+    default:
+        PyErr_SetString(PyExc_SystemError, "Unsupported engine array element size");
+        return NULL;
+    }
+
+    dims[0] = (npy_intp)array->rows;
+    dims[1] = (npy_intp)array->cols;
+    strides[0] = (npy_intp)(array->stride * array->size);
+    strides[1] = (npy_intp)array->size;
+
+    if (vector)
+        result = PyArray_New(&PyArray_Type, 1, dims + 1, type, strides + 1, array->data,
+                             (int)array->size, NPY_ARRAY_ALIGNED, NULL);
+    else
+        result = PyArray_New(&PyArray_Type, 2, dims, type, strides, array->data,
+                             (int)array->size, NPY_ARRAY_ALIGNED, NULL);
+    if (!result)
+        return NULL;
+
+    Py_INCREF(owner);
+    if (PyArray_SetBaseObject((PyArrayObject *)result, owner)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+/* Look up 'name' in a NULL-terminated list of names; 'value' is unchanged
+   if name is NULL. */
+static int parse_choice(const char *const what, const char *const name,
+                        const char *const names[], const int values[], int *const value)
+{
+    int  i;
+
+    if (!name)
+        return 0;
+
+    for (i = 0; names[i]; i++)
+        if (!strcmp(name, names[i])) {
+            *value = values[i];
+            return 0;
+        }
+
+    PyErr_Format(PyExc_ValueError, "Unknown %s '%s'", what, name);
+    return -1;
+}
+
+static const char *const  boundary_names[] = { "open", "periodic", NULL };
+static const int          boundary_values[] = { PERC_BOUNDARY_OPEN, PERC_BOUNDARY_PERIODIC };
+
+static const char *const  span_names[] = { "horizontal", "vertical", "either", "both", NULL };
+static const int          span_values[] = { PERC_SPAN_HORIZONTAL, PERC_SPAN_VERTICAL,
+                                             PERC_SPAN_EITHER, PERC_SPAN_BOTH };
+
+static const char *const  rng_names[] = { "xorshift", "sequential", "counter", NULL };
+static const int          rng_values[] = { PERC_RNG_SEQUENTIAL, PERC_RNG_SEQUENTIAL, PERC_RNG_COUNTER };
+
+/*
+ * Cluster
+*/
+
+static void Cluster_dealloc(ClusterObject *self)
+{
+    perc_cluster_destroy(self->handle);
+    self->handle = NULL;
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int Cluster_init(ClusterObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "rows", "cols", "p_black", "d_white", "d_black",
+                                "boundary", "span", "rng", "seed", "realization", "tiles", NULL };
+    int                 rows, cols = -1;
+    double              p_black = 0.0, d_white = 0.0, d_black = 0.0;
+    const char         *boundary_name = NULL, *span_name = NULL, *rng_name = NULL;
+    unsigned long long  seed = 0, realization = 0;
+    int                 tiles = 1;
+    int                 boundary = PERC_BOUNDARY_OPEN, span = PERC_SPAN_EITHER, rng = PERC_RNG_SEQUENTIAL;
+    perc_cluster       *handle;
+    int                 result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|idddzzzKKi", keywords,
+                                     &rows, &cols, &p_black, &d_white, &d_black,
+                                     &boundary_name, &span_name, &rng_name,
+                                     &seed, &realization, &tiles))
+        return -1;
+    if (cols < 0)
+        cols = rows;
+
+    if (parse_choice("boundary", boundary_name, boundary_names, boundary_values, &boundary) ||
+        parse_choice("span", span_name, span_names, span_values, &span) ||
+        parse_choice("rng", rng_name, rng_names, rng_values, &rng))
+        return -1;
+
+    if (check_fresh(self->handle))
+        return -1;
+
+    result = perc_cluster_create(&handle, rows, cols);
+    if (!result)
+        result = perc_cluster_set_probability(handle, p_black, d_white, d_black);
+    if (!result)
+        result = perc_cluster_set_boundary(handle, boundary);
+    if (!result)
+        result = perc_cluster_set_span(handle, span);
+    if (!result)
+        result = perc_cluster_set_rng(handle, rng, seed, realization);
+    if (!result)
+        result = perc_cluster_set_tiles(handle, tiles);
+    if (result) {
+        perc_cluster_destroy(handle);
+        perc_error(result);
+        return -1;
+    }
+
+    self->handle = handle;
+    return 0;
+}
+
+static PyObject *Cluster_set_probability(ClusterObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "p_black", "d_white", "d_black", NULL };
+    double  p_black, d_white = 0.0, d_black = 0.0;
+    int     result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "d|dd", keywords, &p_black, &d_white, &d_black))
+        return NULL;
+    if (check_busy(self->busy))
+        return NULL;
+
+    result = perc_cluster_set_probability(self->handle, p_black, d_white, d_black);
+    if (result)
+        return perc_error(result);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Cluster_set_rng(ClusterObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "rng", "seed", "realization", NULL };
+    const char         *rng_name;
+    unsigned long long  seed = 0, realization = 0;
+    int                 rng = PERC_RNG_SEQUENTIAL;
+    int                 result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|KK", keywords, &rng_name, &seed, &realization))
+        return NULL;
+    if (parse_choice("rng", rng_name, rng_names, rng_values, &rng) || check_busy(self->busy))
+        return NULL;
+
+    result = perc_cluster_set_rng(self->handle, rng, seed, realization);
+    if (result)
+        return perc_error(result);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Cluster_reset(ClusterObject *self, PyObject *unused)
+{
+    int  result;
+
+    if (check_busy(self->busy))
+        return NULL;
+
+    result = perc_cluster_reset(self->handle);
+    if (result)
+        return perc_error(result);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Cluster_run(ClusterObject *self, PyObject *args)
+{
+    unsigned long long  iterations = 1;
+    int                 result;
+
+    if (!PyArg_ParseTuple(args, "|K", &iterations))
+        return NULL;
+    if (check_busy(self->busy))
+        return NULL;
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    result = perc_cluster_run(self->handle, iterations);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    if (result)
+        return perc_error(result);
+
+    Py_RETURN_NONE;
+}
+
+/* The statistics are read through a perc_cluster_stats snapshot. */
+#define  CLUSTER_STAT(field, convert) \
+    static PyObject *Cluster_get_##field(ClusterObject *self, void *closure) \
+    { \
+        perc_cluster_stats  stats; \
+        const int           result = perc_cluster_query(self->handle, &stats); \
+        if (result) \
+            return perc_error(result); \
+        return convert(stats.field); \
+    }
+
+CLUSTER_STAT(rows, PyLong_FromLong)
+CLUSTER_STAT(cols, PyLong_FromLong)
+CLUSTER_STAT(iterations, PyLong_FromUnsignedLongLong)
+CLUSTER_STAT(white_spans, PyLong_FromUnsignedLongLong)
+CLUSTER_STAT(black_spans, PyLong_FromUnsignedLongLong)
+CLUSTER_STAT(white_euler, PyLong_FromLongLong)
+CLUSTER_STAT(black_euler, PyLong_FromLongLong)
+CLUSTER_STAT(white_euler2, PyFloat_FromDouble)
+CLUSTER_STAT(black_euler2, PyFloat_FromDouble)
+
+static PyObject *Cluster_get_array(ClusterObject *self, void *closure)
+{
+    const int   which = (int)(intptr_t)closure;
+    perc_array  array;
+    int         result;
+
+    result = perc_cluster_array(self->handle, which, &array);
+    if (result)
+        return perc_error(result);
+
+    return array_view((PyObject *)self, &array,
+                      which == PERC_ARRAY_WHITE_HISTOGRAM || which == PERC_ARRAY_BLACK_HISTOGRAM);
+}
+
+static PyMethodDef Cluster_methods[] = {
+    { "set_probability", (PyCFunction)(void (*)(void))Cluster_set_probability, METH_VARARGS | METH_KEYWORDS,
+      "set_probability(p_black, d_white=0.0, d_black=0.0)\n\n"
+      "Set the probabilities of black cells and of diagonal connections,\n"
+      "and reset the statistics." },
+    { "set_rng", (PyCFunction)(void (*)(void))Cluster_set_rng, METH_VARARGS | METH_KEYWORDS,
+      "set_rng(rng, seed=0, realization=0)\n\n"
+      "Select the 'xorshift' or 'counter' generator; seed 0 picks one from the clock." },
+    { "reset", (PyCFunction)Cluster_reset, METH_NOARGS,
+      "reset()\n\nClear the statistics." },
+    { "run", (PyCFunction)Cluster_run, METH_VARARGS,
+      "run(iterations=1)\n\nLabel more matrices, without holding the GIL." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef Cluster_getset[] = {
+    { "rows", (getter)Cluster_get_rows, NULL, "Rows in each matrix", NULL },
+    { "cols", (getter)Cluster_get_cols, NULL, "Columns in each matrix", NULL },
+    { "iterations", (getter)Cluster_get_iterations, NULL, "Matrices labelled since the last reset", NULL },
+    { "white_spans", (getter)Cluster_get_white_spans, NULL, "Matrices with a spanning white cluster", NULL },
+    { "black_spans", (getter)Cluster_get_black_spans, NULL, "Matrices with a spanning black cluster", NULL },
+    { "white_euler", (getter)Cluster_get_white_euler, NULL, "Sum of the Euler numbers of the white cells", NULL },
+    { "black_euler", (getter)Cluster_get_black_euler, NULL, "Sum of the Euler numbers of the black cells", NULL },
+    { "white_euler2", (getter)Cluster_get_white_euler2, NULL, "Sum of the squared white Euler numbers", NULL },
+    { "black_euler2", (getter)Cluster_get_black_euler2, NULL, "Sum of the squared black Euler numbers", NULL },
+    { "white_histogram", (getter)Cluster_get_array, NULL, "White clusters per size (view)",
+      (void *)(intptr_t)PERC_ARRAY_WHITE_HISTOGRAM },
+    { "black_histogram", (getter)Cluster_get_array, NULL, "Black clusters per size (view)",
+      (void *)(intptr_t)PERC_ARRAY_BLACK_HISTOGRAM },
+    { "djs", (getter)Cluster_get_array, NULL, "Disjoint set labels of the last matrix (view)",
+      (void *)(intptr_t)PERC_ARRAY_LABELS },
+    { "map", (getter)Cluster_get_array, NULL, "Cell colors of the last matrix (view)",
+      (void *)(intptr_t)PERC_ARRAY_COLORS },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject ClusterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "percolation.Cluster",
+    .tp_doc = "Cluster(rows, cols=rows, p_black=0.0, d_white=0.0, d_black=0.0, boundary='open',\n"
+              "        span='either', rng='xorshift', seed=0, realization=0, tiles=1)\n\n"
+              "Cluster size histograms over many random matrices.",
+    .tp_basicsize = sizeof (ClusterObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Cluster_init,
+    .tp_dealloc = (destructor)Cluster_dealloc,
+    .tp_methods = Cluster_methods,
+    .tp_getset = Cluster_getset,
+};
+
+/*
+ * Matrix
+*/
+
+static void Matrix_dealloc(MatrixObject *self)
+{
+    perc_matrix_destroy(self->handle);
+    self->handle = NULL;
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int Matrix_init(MatrixObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "size", "nonzero", "diagonal", "diagonal_nonzero",
+                                "boundary", "seed", NULL };
+    Py_ssize_t          size;
+    double              nonzero = 0.5, diagonal = 0.0, diagonal_nonzero = 0.0;
+    const char         *boundary_name = NULL;
+    unsigned long long  seed = 0;
+    int                 boundary = PERC_BOUNDARY_OPEN;
+    perc_matrix        *handle;
+    int                 result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n|dddzK", keywords,
+                                     &size, &nonzero, &diagonal, &diagonal_nonzero,
+                                     &boundary_name, &seed))
+        return -1;
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "Invalid matrix size");
+        return -1;
+    }
+    if (parse_choice("boundary", boundary_name, boundary_names, boundary_values, &boundary) ||
+        check_fresh(self->handle))
+        return -1;
+
+    result = perc_matrix_create(&handle, (size_t)size);
+    if (!result)
+        result = perc_matrix_set_probability(handle, nonzero, diagonal, diagonal_nonzero);
+    if (!result)
+        result = perc_matrix_set_boundary(handle, boundary);
+    if (!result)
+        result = perc_matrix_set_seed(handle, seed);
+    if (result) {
+        perc_matrix_destroy(handle);
+        perc_error(result);
+        return -1;
+    }
+
+    self->handle = handle;
+    return 0;
+}
+
+static PyObject *Matrix_set_probability(MatrixObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "nonzero", "diagonal", "diagonal_nonzero", NULL };
+    double  nonzero, diagonal = 0.0, diagonal_nonzero = 0.0;
+    int     result;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "d|dd", keywords, &nonzero, &diagonal, &diagonal_nonzero))
+        return NULL;
+    if (check_busy(self->busy))
+        return NULL;
+
+    result = perc_matrix_set_probability(self->handle, nonzero, diagonal, diagonal_nonzero);
+    if (result)
+        return perc_error(result);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Matrix_run(MatrixObject *self, PyObject *unused)
+{
+    int  result;
+
+    if (check_busy(self->busy))
+        return NULL;
+
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS
+    result = perc_matrix_run(self->handle);
+    Py_END_ALLOW_THREADS
+    self->busy = 0;
+
+    if (result)
+        return perc_error(result);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *Matrix_get_stats(MatrixObject *self, void *closure)
+{
+    perc_matrix_stats  stats;
+    const char        *which = closure;
+    const int          result = perc_matrix_query(self->handle, &stats);
+
+    if (result)
+        return perc_error(result);
+
+    if (!strcmp(which, "fill"))
+        return Py_BuildValue("(KK)", (unsigned long long)stats.fill[0], (unsigned long long)stats.fill[1]);
+    if (!strcmp(which, "unique"))
+        return Py_BuildValue("(KK)", (unsigned long long)stats.unique[0], (unsigned long long)stats.unique[1]);
+    if (!strcmp(which, "spans"))
+        return Py_BuildValue("(KK)", (unsigned long long)stats.spans[0], (unsigned long long)stats.spans[1]);
+    if (!strcmp(which, "djoins"))
+        return Py_BuildValue("(KKK)", (unsigned long long)stats.djoins[0], (unsigned long long)stats.djoins[1],
+                                      (unsigned long long)stats.djoins[2]);
+    return PyLong_FromSize_t(stats.size);
+}
+
+static PyObject *Matrix_get_spanning(MatrixObject *self, void *closure)
+{
+    const size_t  n = perc_matrix_spanning(self->handle, NULL, 0);
+    uint64_t     *span;
+    PyObject     *result;
+    size_t        i;
+
+    if (!self->handle)
+        return perc_error(PERC_ERR_INVALID);
+
+    span = PyMem_Malloc((n + 1) * sizeof span[0]);
+    if (!span)
+        return PyErr_NoMemory();
+
+    perc_matrix_spanning(self->handle, span, n);
+
+    result = PyList_New((Py_ssize_t)n);
+    for (i = 0; result && i < n; i++) {
+        PyObject *const  item = PyLong_FromUnsignedLongLong(span[i]);
+        if (!item) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, (Py_ssize_t)i, item);
+    }
+
+    PyMem_Free(span);
+    return result;
+}
+
+static PyObject *Matrix_get_map(MatrixObject *self, void *closure)
+{
+    perc_array  array;
+    int         result;
+
+    result = perc_matrix_array(self->handle, &array);
+    if (result)
+        return perc_error(result);
+
+    return array_view((PyObject *)self, &array, 0);
+}
+
+static PyMethodDef Matrix_methods[] = {
+    { "set_probability", (PyCFunction)(void (*)(void))Matrix_set_probability, METH_VARARGS | METH_KEYWORDS,
+      "set_probability(nonzero, diagonal=0.0, diagonal_nonzero=0.0)\n\n"
+      "Set the probabilities of nonzero cells and of diagonal connections." },
+    { "run", (PyCFunction)Matrix_run, METH_NOARGS,
+      "run()\n\nGenerate and label a new matrix, without holding the GIL." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef Matrix_getset[] = {
+    { "size", (getter)Matrix_get_stats, NULL, "The matrix has size*size cells", "size" },
+    { "fill", (getter)Matrix_get_stats, NULL, "Cells of each color", "fill" },
+    { "unique", (getter)Matrix_get_stats, NULL, "Clusters of each color", "unique" },
+    { "spans", (getter)Matrix_get_stats, NULL, "Spanning clusters of each color", "spans" },
+    { "djoins", (getter)Matrix_get_stats, NULL, "White, black and omitted diagonal joins", "djoins" },
+    { "spanning", (getter)Matrix_get_spanning, NULL, "Values of the spanning clusters", NULL },
+    { "map", (getter)Matrix_get_map, NULL, "Cluster index times two plus color, per cell (view)", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject MatrixType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "percolation.Matrix",
+    .tp_doc = "Matrix(size, nonzero=0.5, diagonal=0.0, diagonal_nonzero=0.0, boundary='open', seed=0)\n\n"
+              "One random square matrix at a time, with the cluster of each cell.",
+    .tp_basicsize = sizeof (MatrixObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Matrix_init,
+    .tp_dealloc = (destructor)Matrix_dealloc,
+    .tp_methods = Matrix_methods,
+    .tp_getset = Matrix_getset,
+};
+
+/*
+ * Module
+*/
+
+static struct PyModuleDef percolation_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "percolation",
+    .m_doc = "Cluster and matrix percolation engines, with NumPy views of their arrays.",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_percolation(void)
+{
+    PyObject  *module;
+
+    import_array();
+
+    if (PyType_Ready(&ClusterType) < 0 || PyType_Ready(&MatrixType) < 0)
+        return NULL;
+
+    module = PyModule_Create(&percolation_module);
+    if (!module)
+        return NULL;
+
+    Py_INCREF(&ClusterType);
+    Py_INCREF(&MatrixType);
+    if (PyModule_AddObject(module, "Cluster", (PyObject *)&ClusterType) ||
+        PyModule_AddObject(module, "Matrix", (PyObject *)&MatrixType) ||
+        PyModule_AddIntConstant(module, "API_VERSION", perc_version())) {
+        Py_DECREF(&ClusterType);
+        Py_DECREF(&MatrixType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
+}
@@ -0,0 +1,195 @@
+#ifndef   REPLICAS_H
+#define   REPLICAS_H
+/*
+Multi-threaded replica engine.
+
+Include after clusters.h or clusters_modified.h. Each replica is a complete
+cluster structure with its own color map, disjoint set, root counts and a
+separate Xorshift64* stream split from the base seed, so the replicas share
+no mutable state. The statistics are merged in replica order afterwards,
+so the results only depend on the seed and the number of replicas.
+
+With the counter-based generator of clusters_modified.h, all replicas use
+the same seed, and iterate_replicas() gives each one the next realizations
+in turn, so the results do not depend on the number of replicas either.
+*/
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef struct {
+    cluster        *cl;
+    cluster_count   iters;
+} replica_work;
+
+static void *replica_worker(void *payload)
+{
+    replica_work *const  work = payload;
+    cluster_count        iters = work->iters;
+
+    while (iters-->0)
+        iterate(work->cl);
+
+    return NULL;
+}
+
+/* Free all replicas. */
+STATIC_INLINE void free_replicas(cluster *const replicas, const int count)
+{
+    int  i;
+
+    if (replicas)
+        for (i = 0; i < count; i++)
+            free_cluster(replicas + i);
+}
+
+/* Initialize 'count' replicas, each with its own generator stream.
+   The parameters are as for init_cluster(). */
+STATIC_INLINE int init_replicas(cluster *const replicas, const int count,
+                                const int rows, const int cols,
+                                const double p_black,
+                                const double p_diag1, const double p_diag2,
+                                const uint64_t seed)
+{
+    int  i, result;
+
+    if (!replicas || count < 1)
+        return ERR_INVALID;
+
+    for (i = 0; i < count; i++) {
+        result = init_cluster(replicas + i, rows, cols, p_black, p_diag1, p_diag2);
+        if (result) {
+            free_replicas(replicas, i);
+            return result;
+        }
+        replicas[i].rng.state = split_seed(seed, i);
+    }
+
+    return 0;
+}
+
+/* Reset the statistics and probabilities of all replicas,
+   keeping their generator streams. */
+STATIC_INLINE int reset_replicas(cluster *const replicas, const int count,
+                                 const double p_black,
+                                 const double p_diag1, const double p_diag2)
+{
+    int  i, result;
+
+    if (!replicas || count < 1)
+        return ERR_INVALID;
+
+    for (i = 0; i < count; i++) {
+        result = reset_cluster(replicas + i, p_black, p_diag1, p_diag2);
+        if (result)
+            return result;
+    }
+
+    return 0;
+}
+
+/* Do iters[i] iterations on replica i, using one thread per replica. */
+STATIC_INLINE int run_replicas(cluster *const replicas, const int count,
+                               const cluster_count *const iters)
+{
+    replica_work  *work;
+    pthread_t     *thread;
+    int            i, started;
+
+    if (!replicas || !iters || count < 1)
+        return ERR_INVALID;
+
+    work = malloc((size_t)count * sizeof work[0]);
+    thread = malloc((size_t)count * sizeof thread[0]);
+    if (!work || !thread) {
+        free(thread);
+        free(work);
+        return ERR_NOMEM;
+    }
+
+    for (i = 0; i < count; i++) {
+        work[i].cl = replicas + i;
+        work[i].iters = iters[i];
+    }
+
+    /* The calling thread does the work of the first replica. */
+    for (started = 1; started < count; started++)
+        if (pthread_create(thread + started, NULL, replica_worker, work + started))
+            break;
+
+    replica_worker(work);
+
+    /* If we could not create all threads, do the rest ourselves. */
+    for (i = started; i < count; i++)
+        replica_worker(work + i);
+
+    for (i = 1; i < started; i++)
+        pthread_join(thread[i], NULL);
+
+    free(thread);
+    free(work);
+    return 0;
+}
+
+/* Number of the 'iters' iterations done by replica 'i' of 'count',
+   when they are split evenly among the replicas. */
+STATIC_INLINE cluster_count replica_share(const cluster_count iters, const int count, const int i)
+{
+    return iters / count + ((cluster_count)i < iters % count);
+}
+
+/* Do 'iters' iterations in total, split evenly among the replicas,
+   using one thread per replica. */
+STATIC_INLINE int iterate_replicas(cluster *const replicas, const int count,
+                                   const cluster_count iters)
+{
+    cluster_count  *share;
+    int             i, result;
+
+    if (!replicas || count < 1)
+        return ERR_INVALID;
+
+    share = malloc((size_t)count * sizeof share[0]);
+    if (!share)
+        return ERR_NOMEM;
+
+    for (i = 0; i < count; i++)
+        share[i] = replica_share(iters, count, i);
+
+#ifdef CLUSTER_ENGINE_MODIFIED
+    /* Consecutive realizations, starting where the first replica is. */
+    for (i = 1; i < count; i++)
+        if (replicas[i].rng_mode == CLUSTER_RNG_COUNTER)
+            replicas[i].realization = replicas[i - 1].realization + share[i - 1];
+#endif
+
+    result = run_replicas(replicas, count, share);
+
+#ifdef CLUSTER_ENGINE_MODIFIED
+    /* All replicas continue after the last realization done. */
+    for (i = 0; i < count - 1; i++)
+        if (replicas[i].rng_mode == CLUSTER_RNG_COUNTER)
+            replicas[i].realization = replicas[count - 1].realization;
+#endif
+
+    free(share);
+    return result;
+}
+
+/* Merge the statistics of all replicas into the first one. */
+STATIC_INLINE int merge_replicas(cluster *const replicas, const int count)
+{
+    int  i, result;
+
+    if (!replicas || count < 1)
+        return ERR_INVALID;
+
+    for (i = 1; i < count; i++) {
+        result = merge_cluster(replicas, replicas + i);
+        if (result)
+            return result;
+    }
+
+    return 0;
+}
+
+#endif /* REPLICAS_H */
@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "strip.h"
+
+#define  DEFAULT_ROWS     100
+#define  DEFAULT_COLS     100
+#define  DEFAULT_P_BLACK  0.0
+#define  DEFAULT_D_WHITE  0.0
+#define  DEFAULT_D_BLACK  0.0
+#define  DEFAULT_ITERS    1
+#define  DEFAULT_DENSE    4194304
+
+int usage(const char *argv0)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage: %s [ -h | --help ]\n", argv0);
+    fprintf(stderr, "       %s OPTIONS [ > output.txt ]\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "       rows=SIZE    Set number of rows. Default is %d.\n", DEFAULT_ROWS);
+    fprintf(stderr, "       cols=SIZE    Set number of columns. Default is %d.\n", DEFAULT_COLS);
+    fprintf(stderr, "       L=SIZE       Set rows=SIZE and cols=SIZE.\n");
+    fprintf(stderr, "       black=P      Set the probability of a cell to be black. Default is %g.\n", DEFAULT_P_BLACK);
+    fprintf(stderr, "       dwhite=P     Set the probability of white cells connecting diagonally.\n");
+    fprintf(stderr, "                    Default is %g.\n", DEFAULT_D_WHITE);
+    fprintf(stderr, "       dblack=P     Set the probability of black cells connecting diagonally.\n");
+    fprintf(stderr, "                    Default is %g.\n", DEFAULT_D_BLACK);
+    fprintf(stderr, "       dense=SIZE   Count cluster sizes below SIZE exactly, and larger ones\n");
+    fprintf(stderr, "                    in base-2 logarithmic bins. Default is %d, or\n", DEFAULT_DENSE);
+    fprintf(stderr, "                    rows*cols+1 if smaller.\n");
+    fprintf(stderr, "       N=COUNT      Number of iterations for gathering statistics. Default is %d.\n", DEFAULT_ITERS);
+    fprintf(stderr, "       seed=U64     Set the Xorshift64* pseudorandom number generator seed; nonzero.\n");
+    fprintf(stderr, "                    Default is to pick one randomly (based on time).\n");
+    fprintf(stderr, "       rng=counter  Use the counter-based generator, as distribution_modified\n");
+    fprintf(stderr, "                    does with rng=counter. Default is rng=xorshift.\n");
+    fprintf(stderr, "       realization=K\n");
+    fprintf(stderr, "                    Number of the first strip with rng=counter. Default is 0.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "The strip is generated and labelled one row at a time, keeping only two rows\n");
+    fprintf(stderr, "in memory, so rows can be arbitrarily large.\n");
+    fprintf(stderr, "\n");
+    fprintf(stderr, "The output consists of comment lines and data lines, as for distribution:\n");
+    fprintf(stderr, "   SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS  TOTAL_CLUSTERS\n");
+    fprintf(stderr, "followed by the logarithmic bins of larger clusters:\n");
+    fprintf(stderr, "   MIN_SIZE  MAX_SIZE  WHITE_CLUSTERS  BLACK_CLUSTERS  TOTAL_CLUSTERS\n");
+    fprintf(stderr, "\n");
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t rows = DEFAULT_ROWS;
+    int      cols = DEFAULT_COLS;
+    double   p_black = DEFAULT_P_BLACK;
+    double   d_white = DEFAULT_D_WHITE;
+    double   d_black = DEFAULT_D_BLACK;
+    size_t   dense = 0;
+    long     iters = DEFAULT_ITERS;
+    uint64_t seed = 0;
+    uint64_t realization = 0;
+    int      rng_mode = CLUSTER_RNG_SEQUENTIAL;
+    strip    s = STRIP_INITIALIZER;
+
+    int      arg, itemp;
+    uint64_t u64temp;
+    double   dtemp;
+    long     ltemp;
+    char     dummy;
+
+    size_t   i;
+    int      bin;
+
+    if (argc < 2)
+        return usage(argv[0]);
+
+    for (arg = 1; arg < argc; arg++)
+        if (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "/?") || !strcmp(argv[arg], "--help"))
+            return usage(argv[0]);
+        else
+        if (sscanf(argv[arg], "L=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "l=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "size=%d %c", &itemp, &dummy) == 1) {
+            rows = (itemp > 0) ? (uint64_t)itemp : 0;
+            cols = itemp;
+        } else
+        if (sscanf(argv[arg], "seed=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "s=%" SCNu64 " %c", &u64temp, &dummy) == 1) {
+            seed = u64temp;
+        } else
+        if (sscanf(argv[arg], "realization=%" SCNu64 " %c", &u64temp, &dummy) == 1) {
+            realization = u64temp;
+        } else
+        if (!strcmp(argv[arg], "rng=counter")) {
+            rng_mode = CLUSTER_RNG_COUNTER;
+        } else
+        if (!strcmp(argv[arg], "rng=xorshift") || !strcmp(argv[arg], "rng=sequential")) {
+            rng_mode = CLUSTER_RNG_SEQUENTIAL;
+        } else
+        if (sscanf(argv[arg], "N=%ld %c", &ltemp, &dummy) == 1 ||
+            sscanf(argv[arg], "n=%ld %c", &ltemp, &dummy) == 1 ||
+            sscanf(argv[arg], "count=%ld %c", &ltemp, &dummy) == 1) {
+            iters = ltemp;
+        } else
+        if (sscanf(argv[arg], "rows=%" SCNu64 " %c", &u64temp, &dummy) == 1 ||
+            sscanf(argv[arg], "r=%" SCNu64 " %c", &u64temp, &dummy) == 1) {
+            rows = u64temp;
+        } else
+        if (sscanf(argv[arg], "cols=%d %c", &itemp, &dummy) == 1 ||
+            sscanf(argv[arg], "c=%d %c", &itemp, &dummy) == 1) {
+            cols = itemp;
+        } else
+        if (sscanf(argv[arg], "black=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "b=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "p=%lf %c", &dtemp, &dummy) == 1) {
+            p_black = dtemp;
+        } else
+        if (sscanf(argv[arg], "dwhite=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "dw=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "d0=%lf %c", &dtemp, &dummy) == 1) {
+            d_white = dtemp;
+        } else
+        if (sscanf(argv[arg], "dblack=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "db=%lf %c", &dtemp, &dummy) == 1 ||
+            sscanf(argv[arg], "d1=%lf %c", &dtemp, &dummy) == 1) {
+            d_black = dtemp;
+        } else
+        if (sscanf(argv[arg], "dense=%d %c", &itemp, &dummy) == 1) {
+            if (itemp < 2) {
+                fprintf(stderr, "%s: Invalid size.\n", argv[arg]);
+                return EXIT_FAILURE;
+            }
+            dense = itemp;
+        } else {
+            fprintf(stderr, "%s: Unknown option.\n", argv[arg]);
+            return EXIT_FAILURE;
+        }
+
+    if (!dense) {
+        dense = DEFAULT_DENSE;
+        if (cols > 0 && rows < (uint64_t)dense / (uint64_t)cols)
+            dense = (size_t)(rows * (uint64_t)cols) + 1;
+    }
+
+    switch (init_strip(&s, rows, cols, p_black, d_white, d_black, dense)) {
+    case 0: break; /* OK */
+    case ERR_INVALID:
+        fprintf(stderr, "Invalid size.\n");
+        return EXIT_FAILURE;
+    case ERR_TOOLARGE:
+        fprintf(stderr, "Size is too large.\n");
+        return EXIT_FAILURE;
+    case ERR_NOMEM:
+        fprintf(stderr, "Not enough memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!seed)
+        seed = randomize(NULL);
+
+    s.rng.state = seed;
+    s.rng_mode = rng_mode;
+    s.rng_seed = seed;
+    s.realization = realization;
+
+    /* Print the comments describing the initial parameters. */
+    if (rng_mode == CLUSTER_RNG_COUNTER)
+        printf("# seed: %" PRIu64 " (counter-based, realizations %" PRIu64 " to %" PRIu64 ")\n",
+               seed, realization, realization + (uint64_t)((iters > 0) ? iters : 0) - 1);
+    else
+        printf("# seed: %" PRIu64 " (Xorshift 64*)\n", seed);
+    printf("# size: %" PRIu64 " rows, %d columns (row-streaming)\n", rows, cols);
+    printf("# P(black): %.6f (%" PRIu64 "/18446744073709551615)\n", p_black, s.p_black);
+    printf("# P(black connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_black, s.d_black);
+    printf("# P(white connected diagonally): %.6f (%" PRIu64 "/18446744073709551615)\n", d_white, s.d_white);
+    fflush(stdout);
+
+    while (iters-->0)
+        iterate_strip(&s);
+
+    printf("# Iterations: %" PRIu64 "\n", s.iterations);
+    printf("# %" FMT_COUNT " times at least one white cluster spanned the strip\n", s.white_spans);
+    printf("# %" FMT_COUNT " times at least one black cluster spanned the strip\n", s.black_spans);
+    printf("#\n");
+    printf("# size  white_clusters(size) black_clusters(size) clusters(size)\n");
+
+    for (i = 1; i < dense; i++)
+        if (s.white.count[i] || s.black.count[i])
+            printf("%lu %" FMT_COUNT " %" FMT_COUNT " %" FMT_COUNT "\n",
+                   (unsigned long)i,
+                   s.white.count[i],
+                   s.black.count[i],
+                   s.white.count[i] + s.black.count[i]);
+
+    printf("#\n");
+    printf("# Clusters of %lu cells or more, in logarithmic bins:\n", (unsigned long)dense);
+    printf("# min_size max_size  white_clusters black_clusters clusters\n");
+    for (bin = 0; bin < 64; bin++)
+        if (s.white.log2[bin] || s.black.log2[bin]) {
+            const uint64_t  min = (uint64_t)1 << bin;
+            const uint64_t  max = (bin < 63) ? ((uint64_t)2 << bin) - 1 : UINT64_C(18446744073709551615);
+            printf("%" PRIu64 " %" PRIu64 " %" FMT_COUNT " %" FMT_COUNT " %" FMT_COUNT "\n",
+                   (min < (uint64_t)dense) ? (uint64_t)dense : min, max,
+                   s.white.log2[bin],
+                   s.black.log2[bin],
+                   s.white.log2[bin] + s.black.log2[bin]);
+        }
+
+    /* Since we are exiting anyway, this is not really necessary. */
+    free_strip(&s);
+
+    /* All done. */
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,363 @@
+#ifndef   STRIP_H
+#define   STRIP_H
+/*
+Row-streaming Hoshen-Kopelman labelling, for strips too large to keep in memory.
+
+Only two rows of colors and labels are kept, plus a label equivalence table
+of at most 2*cols entries, so memory use is O(cols) regardless of the number
+of rows. The table is compacted after every row: labels still present in the
+current row are renumbered from zero, and every cluster not present in it is
+finished, and its size is added to the histogram.
+
+The connectivity and the use of the generator are exactly those of iterate()
+in clusters_modified.h, so a square strip gives the same statistics as
+iterate() for the same seed. Spanning is "left-right or top-bottom" as there.
+With the counter-based generator (rng_mode CLUSTER_RNG_COUNTER), the rows
+are the same as those of iterate() for the same seed and realization.
+
+Cluster sizes below 'dense' are counted exactly; larger ones by the base-2
+logarithm of their size.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "clusters_modified.h"
+
+/* Boundary flags. */
+#define  STRIP_TOP     1u
+#define  STRIP_BOTTOM  2u
+#define  STRIP_LEFT    4u
+#define  STRIP_RIGHT   8u
+
+/* Unused entry in the compaction map. */
+#define  STRIP_UNUSED  (~(cluster_label)0)
+
+typedef struct {
+    size_t          dense;      /* Sizes 1..dense-1 are counted exactly */
+    cluster_count  *count;      /* count[size], dense entries */
+    cluster_count   log2[64];   /* Sizes >= dense, by floor(log2(size)) */
+} strip_histogram;
+
+typedef struct {
+    /* Pseudo-random number generator used */
+    prng             rng;
+
+    /* Size of the strip */
+    uint64_t         rows;
+    cluster_label    cols;
+
+    /* Number of strips the histograms have been collected from */
+    cluster_count    iterations;
+
+    /* Number of times when at least one cluster spanned the strip */
+    cluster_count    white_spans;
+    cluster_count    black_spans;
+
+    /* Probability of each cell being black */
+    uint64_t         p_black;
+
+    /* Probability of diagonal connections */
+    uint64_t         d_white;
+    uint64_t         d_black;
+
+    /* Previous and current row colors, cols+2 with CLUSTER_NONE at both ends */
+    cluster_color   *color[2];
+
+    /* Previous and current row labels, cols */
+    cluster_label   *label[2];
+
+    /* Label equivalence table, 2*cols */
+    cluster_label   *djs;
+
+    /* Per-label cluster size, boundary flags and color; valid for roots.
+       The second set is used while compacting. */
+    uint64_t        *size[2];
+    unsigned char   *edge[2];
+    cluster_color   *tone[2];
+
+    /* Compaction map, 2*cols, all STRIP_UNUSED between rows */
+    cluster_label   *renumber;
+
+    /* Histograms of white and black clusters */
+    strip_histogram  white;
+    strip_histogram  black;
+
+    /* Random number generator, as in clusters_modified.h */
+    int              rng_mode;
+    uint64_t         rng_seed;
+    cluster_count    realization;
+} strip;
+#define  STRIP_INITIALIZER  { {0}, 0, 0, 0, 0, 0, 0, 0, 0, { NULL, NULL }, { NULL, NULL }, NULL, \
+                              { NULL, NULL }, { NULL, NULL }, { NULL, NULL }, NULL, \
+                              { 0, NULL, {0} }, { 0, NULL, {0} }, CLUSTER_RNG_SEQUENTIAL, 0, 0 }
+
+/* Free all resources related to a strip. */
+STATIC_INLINE void free_strip(strip *s)
+{
+    if (s) {
+        int  i;
+        for (i = 0; i < 2; i++) {
+            free(s->color[i]);
+            free(s->label[i]);
+            free(s->size[i]);
+            free(s->edge[i]);
+            free(s->tone[i]);
+        }
+        free(s->djs);
+        free(s->renumber);
+        free(s->white.count);
+        free(s->black.count);
+        memset(s, 0, sizeof *s);
+    }
+}
+
+/* Initialize a strip of 'rows' rows and 'cols' columns. Cluster sizes
+   below 'dense' are counted exactly, larger ones in base-2 logarithmic bins. */
+static int init_strip(strip *s, const uint64_t rows, const int cols,
+                      const double p_black,
+                      const double d_white, const double d_black,
+                      const size_t dense)
+{
+    const size_t  labels = 2 * (size_t)cols;
+    int           i;
+
+    if (!s)
+        return ERR_INVALID;
+
+    memset(s, 0, sizeof *s);
+
+    if (rows < 1 || cols < 1 || dense < 2)
+        return ERR_INVALID;
+
+    if (labels / 2 != (size_t)cols || (cluster_label)labels >= STRIP_UNUSED ||
+        (size_t)(cluster_label)labels != labels)
+        return ERR_TOOLARGE;
+
+    for (i = 0; i < 2; i++) {
+        s->color[i] = malloc(((size_t)cols + 2) * sizeof (cluster_color));
+        s->label[i] = malloc((size_t)cols * sizeof (cluster_label));
+        s->size[i] = malloc(labels * sizeof (uint64_t));
+        s->edge[i] = malloc(labels);
+        s->tone[i] = malloc(labels * sizeof (cluster_color));
+        if (!s->color[i] || !s->label[i] || !s->size[i] || !s->edge[i] || !s->tone[i]) {
+            free_strip(s);
+            return ERR_NOMEM;
+        }
+    }
+    s->djs = malloc(labels * sizeof (cluster_label));
+    s->renumber = malloc(labels * sizeof (cluster_label));
+    s->white.count = calloc(dense, sizeof (cluster_count));
+    s->black.count = calloc(dense, sizeof (cluster_count));
+    if (!s->djs || !s->renumber || !s->white.count || !s->black.count) {
+        free_strip(s);
+        return ERR_NOMEM;
+    }
+
+    for (i = 0; i < (int)labels; i++)
+        s->renumber[i] = STRIP_UNUSED;
+
+    s->white.dense = dense;
+    s->black.dense = dense;
+
+    s->rows = rows;
+    s->cols = cols;
+
+    s->p_black = probability_limit(p_black);
+    s->d_white = probability_limit(d_white);
+    s->d_black = probability_limit(d_black);
+
+    return 0;
+}
+
+/* Add a cluster of 'size' cells to a histogram. */
+STATIC_INLINE void  strip_count(strip_histogram *const h, uint64_t size)
+{
+    if (size < h->dense)
+        h->count[size]++;
+    else {
+        int  bin = 0;
+        while (size >>= 1)
+            bin++;
+        h->log2[bin]++;
+    }
+}
+
+/* Finish the cluster of root 'root'. Returns the color of a spanning
+   cluster, or CLUSTER_NONE. */
+STATIC_INLINE int  strip_finish(strip *const s, const cluster_label root)
+{
+    const unsigned int   edge = s->edge[0][root];
+    const cluster_color  color = s->tone[0][root];
+
+    strip_count((color == CLUSTER_BLACK) ? &(s->black) : &(s->white), s->size[0][root]);
+
+    if ((edge & (STRIP_LEFT | STRIP_RIGHT)) == (STRIP_LEFT | STRIP_RIGHT) ||
+        (edge & (STRIP_TOP | STRIP_BOTTOM)) == (STRIP_TOP | STRIP_BOTTOM))
+        return color;
+    else
+        return CLUSTER_NONE;
+}
+
+/* Join label 'other' to the cluster of root 'root'. Returns the new root. */
+STATIC_INLINE cluster_label  strip_join(strip *const s, const cluster_label root,
+                                        const cluster_label other)
+{
+    const cluster_label  temp = djs_flatten(s->djs, other);
+    cluster_label        result;
+
+    if (temp == root)
+        return root;
+
+    result = djs_link(s->djs, root, temp);
+    if (result == root) {
+        s->size[0][root] += s->size[0][temp];
+        s->edge[0][root] |= s->edge[0][temp];
+    } else {
+        s->size[0][temp] += s->size[0][root];
+        s->edge[0][temp] |= s->edge[0][root];
+    }
+
+    return result;
+}
+
+/* Generate and label one strip, collecting the statistics. */
+static void iterate_strip(strip *const s)
+{
+    prng          *const  rng = &(s->rng);
+    cluster_label  const  cols = s->cols;
+    uint64_t       const  rows = s->rows;
+    uint64_t              d_color[2];
+    cluster_label        *djs = s->djs;
+    cluster_label         labels = 0;
+    int                   spanned[2] = { 0, 0 };
+    uint64_t              key[CLUSTER_DRAWS];
+    uint64_t              row_key[CLUSTER_DRAWS];
+    int            const  counter = (s->rng_mode == CLUSTER_RNG_COUNTER);
+    uint64_t              r;
+    cluster_label         i;
+    int                   c;
+
+    d_color[CLUSTER_WHITE] = s->d_white;
+    d_color[CLUSTER_BLACK] = s->d_black;
+
+    if (counter)
+        for (c = 0; c < CLUSTER_DRAWS; c++)
+            key[c] = counter_key(s->rng_seed, s->realization, c);
+    s->realization++;
+
+    /* The row above the first row is empty. */
+    memset(s->color[0], CLUSTER_NONE, (size_t)cols + 2);
+    s->color[1][0] = CLUSTER_NONE;
+    s->color[1][cols + 1] = CLUSTER_NONE;
+
+    for (r = 0; r < rows; r++) {
+        cluster_color *const  prev_color = s->color[0] + 1;
+        cluster_color *const  curr_color = s->color[1] + 1;
+        cluster_label *const  prev_label = s->label[0];
+        cluster_label *const  curr_label = s->label[1];
+        cluster_label         compact = 0;
+
+        if (counter)
+            for (c = 0; c < CLUSTER_DRAWS; c++)
+                row_key[c] = counter_row(key[c], r);
+
+        for (c = 0; c < (int)cols; c++) {
+            const cluster_color  color = (counter) ? counter_probability(row_key[CLUSTER_DRAW_COLOR], c, s->p_black)
+                                                   : probability(rng, s->p_black);
+            const uint64_t       diag = d_color[color];
+            const cluster_label  label = labels++;
+            cluster_label        root = label;
+
+            curr_color[c] = color;
+            curr_label[c] = label;
+
+            djs_init(djs, label);
+            s->size[0][label] = 1;
+            s->edge[0][label] = ((r == 0) ? STRIP_TOP : 0)
+                              | ((c == 0) ? STRIP_LEFT : 0)
+                              | ((c == (int)cols - 1) ? STRIP_RIGHT : 0);
+            s->tone[0][label] = color;
+
+            /* Left, up, up left, and up right, in the same order as iterate(). */
+            if (curr_color[c - 1] == color)
+                root = strip_join(s, root, curr_label[c - 1]);
+            if (prev_color[c] == color)
+                root = strip_join(s, root, prev_label[c]);
+            if (prev_color[c - 1] == color &&
+                ((counter) ? counter_probability(row_key[CLUSTER_DRAW_UPLEFT], c, diag) : probability(rng, diag)))
+                root = strip_join(s, root, prev_label[c - 1]);
+            if (prev_color[c + 1] == color &&
+                ((counter) ? counter_probability(row_key[CLUSTER_DRAW_UPRIGHT], c, diag) : probability(rng, diag)))
+                root = strip_join(s, root, prev_label[c + 1]);
+        }
+
+        /* Last row: the clusters of its cells touch the bottom edge. */
+        if (r == rows - 1)
+            for (c = 0; c < (int)cols; c++)
+                s->edge[0][djs_flatten(djs, curr_label[c])] |= STRIP_BOTTOM;
+
+        /* Renumber the roots of the labels in the current row. */
+        for (c = 0; c < (int)cols; c++) {
+            const cluster_label  root = djs_flatten(djs, curr_label[c]);
+
+            if (s->renumber[root] == STRIP_UNUSED) {
+                s->renumber[root] = compact;
+                s->size[1][compact] = s->size[0][root];
+                s->edge[1][compact] = s->edge[0][root];
+                s->tone[1][compact] = s->tone[0][root];
+                compact++;
+            }
+
+            curr_label[c] = s->renumber[root];
+        }
+
+        /* Finish the clusters that did not reach the current row. */
+        for (i = 0; i < labels; i++)
+            if (djs_is_root(djs, i)) {
+                if (s->renumber[i] == STRIP_UNUSED) {
+                    const int  color = strip_finish(s, i);
+                    if (color != CLUSTER_NONE)
+                        spanned[color] = 1;
+                } else
+                    s->renumber[i] = STRIP_UNUSED;
+            }
+
+        /* Switch to the compacted table. */
+        {
+            uint64_t      *size = s->size[0];
+            unsigned char *edge = s->edge[0];
+            cluster_color *tone = s->tone[0];
+            s->size[0] = s->size[1];
+            s->edge[0] = s->edge[1];
+            s->tone[0] = s->tone[1];
+            s->size[1] = size;
+            s->edge[1] = edge;
+            s->tone[1] = tone;
+        }
+        for (i = 0; i < compact; i++)
+            djs_init(djs, i);
+        labels = compact;
+
+        /* The current row becomes the previous row. */
+        {
+            cluster_color *color = s->color[0];
+            cluster_label *label = s->label[0];
+            s->color[0] = s->color[1];
+            s->label[0] = s->label[1];
+            s->color[1] = color;
+            s->label[1] = label;
+        }
+    }
+
+    /* Finish the clusters on the last row. */
+    for (i = 0; i < labels; i++) {
+        const int  color = strip_finish(s, i);
+        if (color != CLUSTER_NONE)
+            spanned[color] = 1;
+    }
+
+    s->white_spans += spanned[CLUSTER_WHITE];
+    s->black_spans += spanned[CLUSTER_BLACK];
+    s->iterations++;
+}
+
+#endif /* STRIP_H */
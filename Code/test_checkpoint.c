@@ -0,0 +1,140 @@
+/* Check that a run continued from a checkpoint gives the same histograms
+   as an uninterrupted run, for one and more replicas, restoring the state
+   the same way as distribution does. The clusters.h engine only has open
+   boundaries. Run with 'make check'. */
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "clusters.h"
+#include "replicas.h"
+#include "checkpoint.h"
+
+#define  ITERATIONS  300
+#define  CHECKPOINT  "test_checkpoint.tmp"
+
+static int compare(const int rows, const int cols, const int count, const double p_black,
+                   const double p_diag, const double p_diag_black, const uint64_t seed,
+                   const cluster_count first)
+{
+    cluster        whole[4], part[4];
+    cluster_count  share[4];
+    checkpoint     cp = CHECKPOINT_INITIALIZER;
+    size_t         i;
+    int            r, result, failed = 0;
+
+    if (init_replicas(whole, count, rows, cols, p_black, p_diag, p_diag_black, seed) ||
+        init_replicas(part, count, rows, cols, p_black, p_diag, p_diag_black, seed) ||
+        init_checkpoint(&cp, rows, cols, count)) {
+        fprintf(stderr, "Not enough memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    cp.seed = seed;
+
+    /* Uninterrupted run. */
+    if (iterate_replicas(whole, count, ITERATIONS) || merge_replicas(whole, count)) {
+        fprintf(stderr, "Cannot run replicas.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Run the first part, and save the checkpoint. */
+    for (r = 0; r < count; r++) {
+        const cluster_count  target = replica_share(ITERATIONS, count, r);
+        share[r] = (first < target) ? first : target;
+    }
+    if (run_replicas(part, count, share)) {
+        fprintf(stderr, "Cannot run replicas.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (r = 0; r < count; r++) {
+        cp.done[r] = share[r];
+        cp.state[r] = part[r].rng.state;
+        for (i = 0; i < cp.size; i++) {
+            cp.white_histogram[i] += part[r].white_histogram[i];
+            cp.black_histogram[i] += part[r].black_histogram[i];
+        }
+        cp.iterations += part[r].iterations;
+    }
+    cp.param[0] = part->p_black;
+    cp.param[1] = part->p_diag;
+    cp.param[2] = part->p_diag_black;
+
+    result = checkpoint_save(&cp, CHECKPOINT);
+    free_checkpoint(&cp);
+    free_replicas(part, count);
+    if (!result)
+        result = checkpoint_load(&cp, CHECKPOINT);
+    remove(CHECKPOINT);
+    if (result) {
+        fprintf(stderr, "%s: %s.\n", CHECKPOINT, checkpoint_strerror(result));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Continue from the checkpoint with fresh replicas, as distribution does. */
+    if (cp.streams != (size_t)count || cp.seed != seed ||
+        init_replicas(part, count, (int)cp.rows, (int)cp.cols,
+                      (double)cp.param[0] / 18446744073709551616.0,
+                      (double)cp.param[1] / 18446744073709551616.0,
+                      (double)cp.param[2] / 18446744073709551616.0, cp.seed)) {
+        fprintf(stderr, "%s: This checkpoint cannot be continued.\n", CHECKPOINT);
+        exit(EXIT_FAILURE);
+    }
+    for (r = 0; r < count; r++) {
+        part[r].rng.state = cp.state[r];
+        part[r].p_black = cp.param[0];
+        part[r].p_diag = cp.param[1];
+        part[r].p_diag_black = cp.param[2];
+        share[r] = replica_share(ITERATIONS, count, r) - cp.done[r];
+    }
+    for (i = 0; i < cp.size; i++) {
+        part->white_histogram[i] += cp.white_histogram[i];
+        part->black_histogram[i] += cp.black_histogram[i];
+    }
+    part->iterations += cp.iterations;
+
+    if (run_replicas(part, count, share) || merge_replicas(part, count)) {
+        fprintf(stderr, "Cannot run replicas.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (whole->iterations != part->iterations)
+        failed = 1;
+    for (i = 0; i < cp.size; i++)
+        if (whole->white_histogram[i] != part->white_histogram[i] ||
+            whole->black_histogram[i] != part->black_histogram[i])
+            failed = 1;
+
+    if (failed)
+        printf("FAIL: %dx%d replicas=%d black=%g diag=%g diagblack=%g first=%" PRIu64
+               ": %" PRIu64 " iterations (uninterrupted), %" PRIu64 " (resumed)\n",
+               rows, cols, count, p_black, p_diag, p_diag_black, (uint64_t)first,
+               (uint64_t)whole->iterations, (uint64_t)part->iterations);
+
+    free_checkpoint(&cp);
+    free_replicas(part, count);
+    free_replicas(whole, count);
+    return failed;
+}
+
+int main(void)
+{
+    static const int            size[][2] = { { 1, 1 }, { 3, 8 }, { 10, 10 }, { 31, 17 } };
+    static const int            count[] = { 1, 2, 4 };
+    static const double         p[][3] = { { 0.3, 0.0, 0.0 }, { 0.5, 0.5, 0.5 }, { 0.6, 1.0, 0.2 } };
+    static const cluster_count  first[] = { 0, 1, 37, ITERATIONS };
+    int                         failures = 0, tests = 0;
+    size_t                      s, k, i, j;
+
+    for (s = 0; s < sizeof size / sizeof size[0]; s++)
+        for (k = 0; k < sizeof count / sizeof count[0]; k++)
+            for (i = 0; i < sizeof p / sizeof p[0]; i++)
+                for (j = 0; j < sizeof first / sizeof first[0]; j++) {
+                    failures += compare(size[s][0], size[s][1], count[k], p[i][0], p[i][1], p[i][2],
+                                        UINT64_C(0x9E3779B97F4A7C15) + (uint64_t)(s * 1000 + k * 100 + i * 10 + j),
+                                        first[j]);
+                    tests++;
+                }
+
+    printf("%d of %d tests failed.\n", failures, tests);
+    return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
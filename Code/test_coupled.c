@@ -0,0 +1,91 @@
+/* Check that a coupled sweep over black gives the same spanning counts
+   and Euler number sums at each point as iterate() does with the same
+   seed and realizations. Coupled sweeps only support open boundaries.
+   Run with 'make check'. */
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "clusters_modified.h"
+#include "coupled.h"
+
+#define  ITERATIONS  200
+
+/* Points of the sweep, in increasing order. */
+static const double  p[] = { 0.0, 0.2, 0.45, 0.5, 0.5, 0.55, 0.8, 1.0 };
+#define  POINTS  (sizeof p / sizeof p[0])
+
+static int compare(const int rows, const int cols, const int span_mode,
+                   const double d_white, const double d_black, const uint64_t seed)
+{
+    coupled  cs = COUPLED_INITIALIZER;
+    cluster  sweep = CLUSTER_INITIALIZER;
+    size_t   k;
+    long     i;
+    int      failed = 0;
+
+    if (init_coupled(&cs, rows, cols, POINTS) ||
+        reset_coupled(&cs, p, d_white, d_black)) {
+        fprintf(stderr, "Not enough memory.\n");
+        exit(EXIT_FAILURE);
+    }
+    cs.span_mode = span_mode;
+    cs.rng_seed = seed;
+
+    for (i = 0; i < ITERATIONS; i++)
+        iterate_coupled(&cs);
+
+    for (k = 0; k < POINTS; k++) {
+        cluster  c = CLUSTER_INITIALIZER;
+
+        if (init_cluster(&c, rows, cols, p[k], d_white, d_black)) {
+            fprintf(stderr, "Not enough memory.\n");
+            exit(EXIT_FAILURE);
+        }
+        c.span_mode = span_mode;
+        c.rng_mode = CLUSTER_RNG_COUNTER;
+        c.rng_seed = seed;
+
+        for (i = 0; i < ITERATIONS; i++)
+            iterate(&c);
+
+        coupled_stats(&cs, k, &sweep);
+        if (c.iterations != sweep.iterations ||
+            c.white_spans != sweep.white_spans || c.black_spans != sweep.black_spans ||
+            c.white_euler != sweep.white_euler || c.black_euler != sweep.black_euler ||
+            c.white_euler2 != sweep.white_euler2 || c.black_euler2 != sweep.black_euler2) {
+            printf("FAIL: %dx%d span=%d black=%g dwhite=%g dblack=%g: spans %" PRIu64 "/%" PRIu64
+                   " (iterate), %" PRIu64 "/%" PRIu64 " (coupled), Euler %" PRId64 "/%" PRId64
+                   " (iterate), %" PRId64 "/%" PRId64 " (coupled)\n",
+                   rows, cols, span_mode, p[k], d_white, d_black,
+                   c.white_spans, c.black_spans, sweep.white_spans, sweep.black_spans,
+                   c.white_euler, c.black_euler, sweep.white_euler, sweep.black_euler);
+            failed = 1;
+        }
+
+        free_cluster(&c);
+    }
+
+    free_coupled(&cs);
+    return failed;
+}
+
+int main(void)
+{
+    static const int     size[][2] = { { 1, 1 }, { 1, 6 }, { 4, 2 }, { 9, 9 }, { 24, 17 } };
+    static const int     span[] = { CLUSTER_SPAN_EITHER, CLUSTER_SPAN_BOTH, CLUSTER_SPAN_VERTICAL };
+    static const double  d[][2] = { { 0.0, 0.0 }, { 0.5, 0.5 }, { 1.0, 0.2 } };
+    int                  failures = 0, tests = 0;
+    size_t               s, m, j;
+
+    for (s = 0; s < sizeof size / sizeof size[0]; s++)
+        for (m = 0; m < sizeof span / sizeof span[0]; m++)
+            for (j = 0; j < sizeof d / sizeof d[0]; j++) {
+                failures += compare(size[s][0], size[s][1], span[m], d[j][0], d[j][1],
+                                    UINT64_C(0x9E3779B97F4A7C15) + (uint64_t)(s * 100 + m * 10 + j));
+                tests++;
+            }
+
+    printf("%d of %d tests failed.\n", failures, tests);
+    return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
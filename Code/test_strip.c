@@ -0,0 +1,84 @@
+/* Check that iterate_strip() gives the same statistics as iterate()
+   on small square matrices, with both generators. Run with 'make check'.
+   CLUSTER_BITPACK builds use the sequential generator in a different
+   order in iterate(), so only the counter-based one is compared. */
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "strip.h"
+
+#define  ITERATIONS  2000
+
+#ifdef CLUSTER_BITPACK
+#define  FIRST_RNG  CLUSTER_RNG_COUNTER
+#else
+#define  FIRST_RNG  CLUSTER_RNG_SEQUENTIAL
+#endif
+
+static int compare(const int size, const int rng_mode, const double p_black,
+                   const double d_white, const double d_black, const uint64_t seed)
+{
+    const size_t  n = (size_t)size * (size_t)size;
+    cluster       c = CLUSTER_INITIALIZER;
+    strip         s = STRIP_INITIALIZER;
+    size_t        i;
+    int           failed = 0;
+    long          k;
+
+    if (init_cluster(&c, size, size, p_black, d_white, d_black) ||
+        init_strip(&s, size, size, p_black, d_white, d_black, n + 1)) {
+        fprintf(stderr, "Not enough memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    c.rng.state = seed;
+    c.rng_mode = rng_mode;
+    c.rng_seed = seed;
+    s.rng.state = seed;
+    s.rng_mode = rng_mode;
+    s.rng_seed = seed;
+
+    for (k = 0; k < ITERATIONS; k++) {
+        iterate(&c);
+        iterate_strip(&s);
+    }
+
+    if (c.white_spans != s.white_spans || c.black_spans != s.black_spans)
+        failed = 1;
+    for (i = 1; i <= n; i++)
+        if (c.white_histogram[i] != s.white.count[i] ||
+            c.black_histogram[i] != s.black.count[i])
+            failed = 1;
+
+    if (failed)
+        printf("FAIL: L=%d rng=%s black=%g dwhite=%g dblack=%g: spans %" PRIu64 "/%" PRIu64
+               " (iterate), %" PRIu64 "/%" PRIu64 " (strip)\n",
+               size, (rng_mode == CLUSTER_RNG_COUNTER) ? "counter" : "xorshift",
+               p_black, d_white, d_black,
+               c.white_spans, c.black_spans, s.white_spans, s.black_spans);
+
+    free_strip(&s);
+    free_cluster(&c);
+    return failed;
+}
+
+int main(void)
+{
+    static const double  p[] = { 0.0, 0.3, 0.5, 0.6, 1.0 };
+    static const double  d[][2] = { { 0.0, 0.0 }, { 0.5, 0.5 }, { 1.0, 0.2 } };
+    int                  size, rng_mode, failures = 0, tests = 0;
+    size_t               i, j;
+
+    for (size = 1; size <= 20; size += (size < 8) ? 1 : 4)
+        for (rng_mode = FIRST_RNG; rng_mode <= CLUSTER_RNG_COUNTER; rng_mode++)
+            for (i = 0; i < sizeof p / sizeof p[0]; i++)
+                for (j = 0; j < sizeof d / sizeof d[0]; j++) {
+                    failures += compare(size, rng_mode, p[i], d[j][0], d[j][1],
+                                        UINT64_C(0x9E3779B97F4A7C15) + (uint64_t)(size * 100 + i * 10 + j));
+                    tests++;
+                }
+
+    printf("%d of %d tests failed.\n", failures, tests);
+    return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/* Check that iterate_tiled() gives the same histograms, spanning counts
+   and Euler number sums as iterate(), with the counter-based generator,
+   on small matrices with open and periodic boundaries. Run with
+   'make check'. */
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include "clusters_modified.h"
+#include "tiles.h"
+
+#define  ITERATIONS  500
+
+static int compare(const int rows, const int cols, const int tiles, const int boundary,
+                   const double p_black, const double d_white, const double d_black,
+                   const uint64_t seed)
+{
+    const size_t  n = (size_t)rows * (size_t)cols;
+    cluster       c = CLUSTER_INITIALIZER;
+    cluster       t = CLUSTER_INITIALIZER;
+    tile_pool     pool = TILE_POOL_INITIALIZER;
+    size_t        i;
+    int           failed = 0;
+    long          k;
+
+    if (init_cluster(&c, rows, cols, p_black, d_white, d_black) ||
+        init_cluster(&t, rows, cols, p_black, d_white, d_black) ||
+        set_cluster_boundary(&c, boundary) ||
+        set_cluster_boundary(&t, boundary)) {
+        fprintf(stderr, "Not enough memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    c.rng_mode = CLUSTER_RNG_COUNTER;
+    c.rng_seed = seed;
+    t.rng_mode = CLUSTER_RNG_COUNTER;
+    t.rng_seed = seed;
+
+    if (init_tile_pool(&pool, &t, tiles)) {
+        fprintf(stderr, "Cannot start the tile threads.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (k = 0; k < ITERATIONS; k++) {
+        iterate(&c);
+        iterate_tiled(&pool);
+    }
+
+    if (c.white_spans != t.white_spans || c.black_spans != t.black_spans ||
+        c.white_euler != t.white_euler || c.black_euler != t.black_euler ||
+        c.white_euler2 != t.white_euler2 || c.black_euler2 != t.black_euler2)
+        failed = 1;
+    for (i = 1; i <= n; i++)
+        if (c.white_histogram[i] != t.white_histogram[i] ||
+            c.black_histogram[i] != t.black_histogram[i])
+            failed = 1;
+
+    if (failed)
+        printf("FAIL: %dx%d tiles=%d boundary=%s black=%g dwhite=%g dblack=%g: spans %" PRIu64 "/%" PRIu64
+               " (iterate), %" PRIu64 "/%" PRIu64 " (tiled), Euler %" PRId64 "/%" PRId64
+               " (iterate), %" PRId64 "/%" PRId64 " (tiled)\n",
+               rows, cols, tiles, (boundary == CLUSTER_BOUNDARY_PERIODIC) ? "periodic" : "open",
+               p_black, d_white, d_black,
+               c.white_spans, c.black_spans, t.white_spans, t.black_spans,
+               c.white_euler, c.black_euler, t.white_euler, t.black_euler);
+
+    free_tile_pool(&pool);
+    free_cluster(&t);
+    free_cluster(&c);
+    return failed;
+}
+
+int main(void)
+{
+    static const int     size[][2] = { { 1, 1 }, { 2, 5 }, { 7, 3 }, { 16, 16 }, { 33, 20 } };
+    static const int     tiles[] = { 2, 3, 8 };
+    static const double  p[] = { 0.3, 0.5, 0.6 };
+    static const double  d[][2] = { { 0.0, 0.0 }, { 1.0, 0.2 } };
+    int                  boundary, failures = 0, tests = 0;
+    size_t               s, t, i, j;
+
+    for (s = 0; s < sizeof size / sizeof size[0]; s++)
+        for (t = 0; t < sizeof tiles / sizeof tiles[0]; t++)
+            for (boundary = CLUSTER_BOUNDARY_OPEN; boundary <= CLUSTER_BOUNDARY_PERIODIC; boundary++)
+                for (i = 0; i < sizeof p / sizeof p[0]; i++)
+                    for (j = 0; j < sizeof d / sizeof d[0]; j++) {
+                        failures += compare(size[s][0], size[s][1], tiles[t], boundary, p[i], d[j][0], d[j][1],
+                                            UINT64_C(0x9E3779B97F4A7C15) + (uint64_t)(s * 1000 + t * 100 + i * 10 + j));
+                        tests++;
+                    }
+
+    printf("%d of %d tests failed.\n", failures, tests);
+    return (failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,533 @@
+#ifndef   TILES_H
+#define   TILES_H
+/*
+Tiled labelling of a single matrix.
+
+Include after clusters_modified.h. iterate_tiled() does the same as
+iterate(), but splits the matrix into horizontal tiles of consecutive
+rows, each labelled by its own thread with label_rows(). The cells of a
+tile are only joined within the tile, so the disjoint set and the root
+counts of each tile are local to it. The tiles are then joined across
+the seams between them, including the diagonal joins, and the root
+counts of the clusters spanning several tiles are moved to their final
+roots. Finally, each thread collects the cluster sizes of its tile.
+
+The threads and work areas are kept in a tile_pool, set up once for a
+cluster with init_tile_pool(), reused by every iterate_tiled() call, and
+released with free_tile_pool(). Between the passes the threads wait on
+a condition variable.
+
+The counter-based generator gives each cell the same numbers regardless
+of the order the cells are generated in, so the matrix and all statistics
+are identical to iterate() with the same seed and realization. With the
+sequential generator, iterate_tiled() just calls iterate().
+
+In CLUSTER_BITPACK builds, the tiles use the byte map labelling, which
+gives the same matrix with the counter-based generator. The profiling
+counters of CLUSTER_PROFILE builds are not updated.
+*/
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Cluster sizes below this are collected into a histogram of each tile,
+   and larger ones into a list, merged afterwards. */
+#define  TILE_SMALL  256
+
+typedef struct tile_pool  tile_pool;
+
+typedef struct {
+    cluster         *cl;
+    tile_pool       *pool;
+    const uint64_t  *key;
+    cluster_label    first;         /* First row of the tile */
+    cluster_label    end;           /* Row after the tile */
+    int64_t          euler[2];
+    cluster_label   *white;         /* End of the white roots listed */
+    cluster_label   *black;         /* Start of the black roots listed */
+    cluster_label   *large[2];      /* End of the large sizes listed */
+    cluster_count    histogram[2][TILE_SMALL];
+} tile_work;
+
+struct tile_pool {
+    cluster          *cl;
+    int               count;        /* Number of tiles */
+    int               started;      /* Tiles with a thread, including the first */
+    tile_work        *work;
+    pthread_t        *thread;
+    cluster_label    *local;        /* Local roots saved by join_tiles() */
+    cluster_label    *list;         /* Root and size lists, rows*cols; see tile_size() */
+    pthread_mutex_t   lock;
+    pthread_cond_t    wake;         /* A new pass, or quit, was posted */
+    pthread_cond_t    idle;         /* The last thread finished its pass */
+    void           *(*worker)(void *);
+    unsigned long     pass;
+    int               pending;      /* Threads still running this pass */
+    int               quit;
+};
+
+#define  TILE_POOL_INITIALIZER  { NULL, 0, 0, NULL, NULL, NULL }
+
+/* Label the rows of a tile, and count the cells of each local root,
+   listing the roots as in iterate(). The white roots are listed from
+   the start of the tile in the root list, and the black ones backwards
+   from its end. */
+static void *tile_label(void *payload)
+{
+    tile_work *const      work = payload;
+    cluster *const        cl = work->cl;
+    cluster_label *const  djs = cl->djs;
+    cluster_label  const  cols = cl->cols;
+    cluster_label         r, c;
+
+    work->euler[CLUSTER_WHITE] = 0;
+    work->euler[CLUSTER_BLACK] = 0;
+    label_rows(cl, work->first, work->end, work->key, work->euler);
+
+#ifndef DJS_BY_SIZE
+    work->white = work->pool->list + work->first * cols;
+    work->black = work->pool->list + work->end * cols;
+
+    {
+        const cluster_color *const  map = cl->map + cols + 2;
+        cluster_label        *white = work->white;
+        cluster_label        *black = work->black;
+
+        for (r = work->first; r < work->end; r++) {
+            const cluster_color *const  curr_row = map + r * (cols + 1);
+            const cluster_label         curr_i = r * cols;
+            for (c = 0; c < cols; c++) {
+                const cluster_label  root = djs_flatten(djs, curr_i + c);
+                if (curr_row[c] == CLUSTER_BLACK) {
+                    if (!cl->black_roots[root]++)
+                        *(--black) = root;
+                } else {
+                    if (!cl->white_roots[root]++)
+                        *(white++) = root;
+                }
+            }
+        }
+
+        work->white = white;
+        work->black = black;
+    }
+#else
+    (void)djs;
+    (void)cols;
+    (void)r;
+    (void)c;
+#endif
+
+    return NULL;
+}
+
+/* Add the size of a cluster to the histogram of the tile, or to its list
+   of large sizes. The list reuses the root list of the tile, so it never
+   overtakes the roots still to be read. With DJS_BY_SIZE, the cluster has
+   no root list, and the pool has a list of its own for the sizes. */
+STATIC_INLINE void tile_size(tile_work *const work, const int color, const cluster_label size)
+{
+    if (size < TILE_SMALL)
+        work->histogram[color][size]++;
+    else
+    if (color == CLUSTER_WHITE)
+        *(work->large[CLUSTER_WHITE]++) = size;
+    else
+        *(--work->large[CLUSTER_BLACK]) = size;
+}
+
+/* Collect the cluster sizes of a tile, after the seams are joined,
+   clearing the root counts for the next iteration. */
+static void *tile_sizes(void *payload)
+{
+    tile_work *const  work = payload;
+    cluster *const    cl = work->cl;
+    cluster_label     r, c;
+
+    memset(work->histogram, 0, sizeof work->histogram);
+
+#ifdef DJS_BY_SIZE
+    /* Each root knows the size of its cluster. */
+    {
+        const cluster_color *const  map = cl->map + cl->cols + 2;
+        const cluster_label *const  djs = cl->djs;
+
+        work->large[CLUSTER_WHITE] = work->pool->list + work->first * cl->cols;
+        work->large[CLUSTER_BLACK] = work->pool->list + work->end * cl->cols;
+
+        for (r = work->first; r < work->end; r++) {
+            const cluster_color *const  curr_row = map + r * (cl->cols + 1);
+            const cluster_label         curr_i = r * cl->cols;
+            for (c = 0; c < cl->cols; c++)
+                if (djs_is_root(djs, curr_i + c))
+                    tile_size(work, curr_row[c], djs_size(djs, curr_i + c));
+        }
+    }
+#else
+    /* Roots joined to another tile have no cells left. */
+    {
+        cluster_label *const  list_begin = work->pool->list + work->first * cl->cols;
+        cluster_label *const  list_end = work->pool->list + work->end * cl->cols;
+        cluster_label        *root;
+
+        work->large[CLUSTER_WHITE] = list_begin;
+        for (root = list_begin; root < work->white; root++) {
+            const cluster_label  size = cl->white_roots[*root];
+            cl->white_roots[*root] = 0;
+            if (size)
+                tile_size(work, CLUSTER_WHITE, size);
+        }
+
+        work->large[CLUSTER_BLACK] = list_end;
+        for (root = list_end; root-- > work->black; ) {
+            const cluster_label  size = cl->black_roots[*root];
+            cl->black_roots[*root] = 0;
+            if (size)
+                tile_size(work, CLUSTER_BLACK, size);
+        }
+    }
+    (void)r;
+    (void)c;
+#endif
+
+    return NULL;
+}
+
+/* Thread of each tile but the first: run the worker of each pass posted
+   by run_tiles() on the tile, until free_tile_pool() posts quit. */
+static void *tile_thread(void *payload)
+{
+    tile_work *const  work = payload;
+    tile_pool *const  pool = work->pool;
+    unsigned long     pass = 0;
+
+    pthread_mutex_lock(&(pool->lock));
+    while (1) {
+        void *(*worker)(void *);
+
+        while (pool->pass == pass && !pool->quit)
+            pthread_cond_wait(&(pool->wake), &(pool->lock));
+        if (pool->quit)
+            break;
+        pass = pool->pass;
+        worker = pool->worker;
+        pthread_mutex_unlock(&(pool->lock));
+
+        worker(work);
+
+        pthread_mutex_lock(&(pool->lock));
+        if (!--pool->pending)
+            pthread_cond_signal(&(pool->idle));
+    }
+    pthread_mutex_unlock(&(pool->lock));
+
+    return NULL;
+}
+
+/* Run 'worker' on each tile, using the thread of each tile, and wait
+   for all of them to finish. */
+STATIC_INLINE void run_tiles(tile_pool *const pool, void *(*worker)(void *))
+{
+    int  i;
+
+    pthread_mutex_lock(&(pool->lock));
+    pool->worker = worker;
+    pool->pending = pool->started - 1;
+    pool->pass++;
+    pthread_cond_broadcast(&(pool->wake));
+    pthread_mutex_unlock(&(pool->lock));
+
+    /* The calling thread does the first tile. */
+    worker(pool->work);
+
+    /* If we could not create all threads, do the rest ourselves. */
+    for (i = pool->started; i < pool->count; i++)
+        worker(pool->work + i);
+
+    pthread_mutex_lock(&(pool->lock));
+    while (pool->pending)
+        pthread_cond_wait(&(pool->idle), &(pool->lock));
+    pthread_mutex_unlock(&(pool->lock));
+}
+
+/* Stop the threads of a tile pool, and free its work areas. */
+STATIC_INLINE void free_tile_pool(tile_pool *const pool)
+{
+    int  i;
+
+    if (!pool)
+        return;
+
+    if (pool->work) {
+        pthread_mutex_lock(&(pool->lock));
+        pool->quit = 1;
+        pthread_cond_broadcast(&(pool->wake));
+        pthread_mutex_unlock(&(pool->lock));
+
+        for (i = 1; i < pool->started; i++)
+            pthread_join(pool->thread[i], NULL);
+
+        pthread_cond_destroy(&(pool->idle));
+        pthread_cond_destroy(&(pool->wake));
+        pthread_mutex_destroy(&(pool->lock));
+    }
+
+#ifdef DJS_BY_SIZE
+    free(pool->list);
+#endif
+    free(pool->local);
+    free(pool->thread);
+    free(pool->work);
+    memset(pool, 0, sizeof *pool);
+}
+
+/* Set up a pool labelling the matrix of 'cl' in 'tiles' tiles; at most
+   one tile per row. The cluster must be initialized, and keep its size,
+   while the pool is in use. With a single tile, no threads are started,
+   and iterate_tiled() just calls iterate(). */
+STATIC_INLINE int init_tile_pool(tile_pool *const pool, cluster *const cl, int tiles)
+{
+    cluster_label  rows, cols;
+    int            t, result;
+
+    if (!pool)
+        return ERR_INVALID;
+    memset(pool, 0, sizeof *pool);
+    if (!cl || !cl->map || tiles < 1)
+        return ERR_INVALID;
+
+    rows = cl->rows;
+    cols = cl->cols;
+    if ((cluster_label)tiles > rows)
+        tiles = (int)rows;
+
+    pool->cl = cl;
+    pool->count = tiles;
+    if (tiles < 2)
+        return 0;
+
+    pool->work = malloc((size_t)tiles * sizeof pool->work[0]);
+    pool->thread = malloc((size_t)tiles * sizeof pool->thread[0]);
+    pool->local = malloc((2 * (size_t)cols * (size_t)(tiles - 1) + 2 * ((size_t)rows + cols)) * sizeof pool->local[0]);
+#ifdef DJS_BY_SIZE
+    pool->list = malloc((size_t)rows * (size_t)cols * sizeof pool->list[0]);
+#else
+    pool->list = cl->root_list;
+#endif
+    result = (!pool->work || !pool->thread || !pool->local || !pool->list);
+    if (!result)
+        result = pthread_mutex_init(&(pool->lock), NULL);
+    if (!result && (result = pthread_cond_init(&(pool->wake), NULL)))
+        pthread_mutex_destroy(&(pool->lock));
+    if (!result && (result = pthread_cond_init(&(pool->idle), NULL))) {
+        pthread_cond_destroy(&(pool->wake));
+        pthread_mutex_destroy(&(pool->lock));
+    }
+    if (result) {
+#ifdef DJS_BY_SIZE
+        free(pool->list);
+#endif
+        free(pool->local);
+        free(pool->thread);
+        free(pool->work);
+        memset(pool, 0, sizeof *pool);
+        return ERR_NOMEM;
+    }
+
+    for (t = 0; t < tiles; t++) {
+        pool->work[t].cl = cl;
+        pool->work[t].pool = pool;
+        pool->work[t].key = NULL;
+        pool->work[t].first = (cluster_label)(((uint64_t)rows * (uint64_t)t) / (uint64_t)tiles);
+        pool->work[t].end = (cluster_label)(((uint64_t)rows * (uint64_t)(t + 1)) / (uint64_t)tiles);
+    }
+
+    /* The calling thread does the first tile, and the tiles whose
+       thread could not be created. */
+    for (pool->started = 1; pool->started < tiles; pool->started++)
+        if (pthread_create(pool->thread + pool->started, NULL, tile_thread, pool->work + pool->started))
+            break;
+
+    return 0;
+}
+
+/* Join the first row of each tile to the last row of the tile above it,
+   as label_rows() would have, adding the joins and blocks across the seam
+   to euler[]. The local roots of the cells on both sides of each seam, and
+   on the edges of a periodic matrix, are saved to 'local' first; the count
+   of each local root that is no longer a root afterwards is moved to the
+   final root in move_tile_roots(). Returns the end of 'local'. */
+static cluster_label *join_tiles(cluster *const cl, const tile_work *const work, const int count,
+                                 const uint64_t *const key, cluster_label *local,
+                                 int64_t euler[2])
+{
+    const cluster_color *const  map = cl->map + cl->cols + 2;
+    cluster_label        *const djs = cl->djs;
+    cluster_label         const cols = cl->cols;
+    cluster_label         const map_stride = cols + 1;
+    uint64_t                    d_color[2];
+    int                         t, c;
+
+    d_color[CLUSTER_WHITE] = cl->d_white;
+    d_color[CLUSTER_BLACK] = cl->d_black;
+
+#ifndef DJS_BY_SIZE
+    for (t = 1; t < count; t++)
+        for (c = 0; c < 2 * (int)cols; c++)
+            *(local++) = djs_root(djs, (work[t].first - 1) * cols + c);
+
+    if (cl->boundary == CLUSTER_BOUNDARY_PERIODIC && cl->wrap && cl->seam) {
+        const cluster_label  last = (cl->rows - 1) * cols;
+        cluster_label        r;
+
+        for (c = 0; c < (int)cols; c++) {
+            *(local++) = djs_root(djs, c);
+            *(local++) = djs_root(djs, last + c);
+        }
+        for (r = 0; r < cl->rows; r++) {
+            *(local++) = djs_root(djs, r * cols);
+            *(local++) = djs_root(djs, r * cols + cols - 1);
+        }
+    }
+#endif
+
+    for (t = 1; t < count; t++) {
+        const cluster_label         r = work[t].first;
+        const cluster_color *const  curr_row = map + r * map_stride;
+        const cluster_color *const  prev_row = curr_row - map_stride;
+        const uint64_t              upleft = counter_row(key[CLUSTER_DRAW_UPLEFT], r);
+        const uint64_t              upright = counter_row(key[CLUSTER_DRAW_UPRIGHT], r);
+        unsigned int                left_joins = 0;
+
+        for (c = 0; c < (int)cols; c++) {
+            const cluster_color  color = curr_row[c];
+            const uint64_t       diag = d_color[color];
+            unsigned int         joins = 0;
+
+            /* The neighbours outside the matrix have no color. */
+            joins |= (prev_row[c] == color) << 1;
+            joins |= (prev_row[c - 1] == color && counter_probability(upleft, c, diag)) << 2;
+            joins |= (prev_row[c + 1] == color && counter_probability(upright, c, diag)) << 3;
+
+            djs_joins(djs, r * cols + c, cols, joins);
+
+            euler[color] -= (int)(((joins >> 1) & 1) + ((joins >> 2) & 1) + (joins >> 3));
+            if (c > 0)
+                euler_block(euler, prev_row[c - 1], prev_row[c], curr_row[c - 1], color,
+                            (int)(((joins >> 2) & 1) + (left_joins >> 3)));
+            left_joins = joins;
+        }
+    }
+
+    return local;
+}
+
+/* Move the cell counts of the saved local roots that are no longer
+   roots to their final roots. */
+STATIC_INLINE void move_tile_roots(cluster *const cl, const cluster_label *local,
+                                   const cluster_label *const end)
+{
+    const cluster_color *const  map = cl->map + cl->cols + 2;
+    const cluster_label  *const djs = cl->djs;
+    cluster_label         const cols = cl->cols;
+
+    while (local < end) {
+        const cluster_label  root = *(local++);
+        if (!djs_is_root(djs, root)) {
+            cluster_label *const  roots = (map[(root / cols) * (cols + 1) + root % cols] == CLUSTER_BLACK)
+                                        ? cl->black_roots : cl->white_roots;
+            roots[djs_root(djs, root)] += roots[root];
+            roots[root] = 0;
+        }
+    }
+}
+
+/* Label one matrix of the cluster of a tile pool, using the threads of
+   the pool; see the comment at the start of this file. */
+STATIC_INLINE int iterate_tiled(tile_pool *const pool)
+{
+    cluster              *cl;
+    cluster_color        *map;
+    cluster_label         map_stride, cols;
+    int                   periodic;
+    uint64_t              key[CLUSTER_DRAWS];
+    uint64_t              d_color[2];
+    int64_t               euler[2] = { 0, 0 };
+    int                   wrapped[2] = { 0, 0 };
+    tile_work            *work;
+    cluster_label        *local_end;
+    int                   t, tiles;
+    size_t                i;
+
+    if (!pool || !pool->cl)
+        return ERR_INVALID;
+
+    cl = pool->cl;
+    work = pool->work;
+    tiles = pool->count;
+
+    map = cl->map + cl->cols + 2;
+    map_stride = cl->cols + 1;
+    cols = cl->cols;
+    periodic = (cl->boundary == CLUSTER_BOUNDARY_PERIODIC && cl->wrap && cl->seam);
+
+    if (tiles < 2 || cl->rng_mode != CLUSTER_RNG_COUNTER) {
+        iterate(cl);
+        return 0;
+    }
+
+    for (t = 0; t < CLUSTER_DRAWS; t++)
+        key[t] = counter_key(cl->rng_seed, cl->realization, t);
+    cl->realization++;
+
+    d_color[CLUSTER_WHITE] = cl->d_white;
+    d_color[CLUSTER_BLACK] = cl->d_black;
+
+    for (t = 0; t < tiles; t++)
+        work[t].key = key;
+
+    run_tiles(pool, tile_label);
+
+    for (t = 0; t < tiles; t++) {
+        euler[CLUSTER_WHITE] += work[t].euler[CLUSTER_WHITE];
+        euler[CLUSTER_BLACK] += work[t].euler[CLUSTER_BLACK];
+    }
+
+    local_end = join_tiles(cl, work, tiles, key, pool->local, euler);
+
+    /* Join the clusters across the edges of a periodic matrix. */
+    if (periodic)
+        cluster_seams(cl, map, map_stride, d_color, key, wrapped, euler);
+
+    /* Nothing was saved if the roots know the sizes. */
+    move_tile_roots(cl, pool->local, local_end);
+
+    run_tiles(pool, tile_sizes);
+
+    if (cl->white_histogram && cl->black_histogram)
+        for (t = 0; t < tiles; t++) {
+            const cluster_label  *size;
+
+            for (i = 1; i < TILE_SMALL; i++) {
+                cl->white_histogram[i] += work[t].histogram[CLUSTER_WHITE][i];
+                cl->black_histogram[i] += work[t].histogram[CLUSTER_BLACK][i];
+            }
+            for (size = pool->list + work[t].first * cols; size < work[t].large[CLUSTER_WHITE]; size++)
+                cl->white_histogram[*size]++;
+            for (size = work[t].large[CLUSTER_BLACK]; size < pool->list + work[t].end * cols; size++)
+                cl->black_histogram[*size]++;
+        }
+
+    cl->white_euler += euler[CLUSTER_WHITE];
+    cl->black_euler += euler[CLUSTER_BLACK];
+    cl->white_euler2 += (double)euler[CLUSTER_WHITE] * (double)euler[CLUSTER_WHITE];
+    cl->black_euler2 += (double)euler[CLUSTER_BLACK] * (double)euler[CLUSTER_BLACK];
+
+    /* Check for spanning clusters. */
+    cluster_spans(cl, map, map_stride, (periodic) ? wrapped : NULL);
+
+    cl->iterations++;
+
+    return 0;
+}
+
+#endif /* TILES_H */